@@ -0,0 +1,2029 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <cmath>
+#include <array>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../src/Region.hpp"
+#include "../src/WorldFile.hpp"
+#include "../src/RegionContainer.hpp"
+#include "../src/Dictionaries.hpp"
+#include "../src/Codec.hpp"
+#include "../src/ChunkIO.hpp"
+#include "../src/ChunkWriter.hpp"
+#include "../src/worldgen.hpp"
+#include "../src/Math.hpp"
+#include "../src/PackedChunk.hpp"
+#include "../src/mesher.hpp"
+#include "../src/VoxelContainer.hpp"
+#include "../src/VoxelIterator.hpp"
+
+// region storage benchmarks, run from any directory (works in a fresh temporary directory)
+// usage: bench [benchmark_name]
+
+// counts every heap allocation of the process for bench allocations (codec libraries are counted by codec::Context)
+namespace {
+    std::atomic<size_t> heap_allocations{ 0 };
+}
+
+void * operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void * address = std::malloc(size == 0 ? 1 : size))
+        return address;
+    throw std::bad_alloc{};
+}
+
+void * operator new[](size_t size) { return operator new(size); }
+
+namespace {
+    // not inlined, gcc would see free() on memory from operator new (-Wmismatched-new-delete)
+    __attribute__((noinline)) void heapFree(void * address) noexcept { std::free(address); }
+}
+
+void operator delete(void * address) noexcept { heapFree(address); }
+void operator delete(void * address, size_t) noexcept { heapFree(address); }
+void operator delete[](void * address) noexcept { heapFree(address); }
+void operator delete[](void * address, size_t) noexcept { heapFree(address); }
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+double seconds(Clock::time_point start, Clock::time_point stop) {
+    return std::chrono::duration_cast<std::chrono::duration<double>>(stop - start).count();
+}
+
+std::string fileName(const glm::tvec3<cfg::Coord> & region_position) {
+    return "world/" + std::to_string(region_position.x) + "|" +
+        std::to_string(region_position.y) + "|" + std::to_string(region_position.z);
+}
+
+size_t fileSize(const glm::tvec3<cfg::Coord> & region_position) {
+    struct stat file_info;
+    if (stat(fileName(region_position).c_str(), &file_info) != 0)
+        return 0;
+    return file_info.st_size;
+}
+
+// benchmarks run on the main thread, ChunkIO and ChunkWriter threads bring their own
+Region::Scratch & scratch() {
+    static Region::Scratch main_thread_scratch;
+    return main_thread_scratch;
+}
+
+// like ChunkIO does it
+bool loadChunk(Region & region, const glm::tvec3<cfg::Coord> & chunk_position, cfg::Block * chunk) {
+    cfg::Block uniform_block;
+    switch (region.loadChunk(Math::position_to_index(chunk_position, cfg::REGION_SIZE), chunk, uniform_block, scratch())) {
+    case Region::LoadResult::MISSING:
+    case Region::LoadResult::CORRUPT:
+        return false;
+    case Region::LoadResult::UNIFORM:
+        std::fill(chunk, chunk + cfg::CHUNK_VOLUME, uniform_block);
+        return true;
+    case Region::LoadResult::LOADED:
+        return true;
+    }
+    return false;
+}
+
+// all chunks of one region layer where the SINE terrain surface is
+std::vector<glm::tvec3<cfg::Coord>> surfaceChunks() {
+    std::vector<glm::tvec3<cfg::Coord>> positions;
+    glm::tvec3<cfg::Coord> i{ 0, -1, 0 };
+    for (i.z = 0; i.z < cfg::REGION_SIZE.z; ++i.z)
+        for (i.x = 0; i.x < cfg::REGION_SIZE.x; ++i.x)
+            positions.push_back(i);
+    return positions;
+}
+
+// saves edited chunks over and over, edits mostly place blocks so chunks grow by a few bytes
+// checks the region content and size afterwards
+int benchSlots() {
+    static constexpr size_t SAVES{ 20000 };
+    static constexpr size_t EDITS_PER_SAVE{ 4 };
+    const glm::tvec3<cfg::Coord> region_position{ 0, -1, 0 };
+    const auto positions = surfaceChunks();
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    for (size_t i = 0; i < positions.size(); ++i)
+        worldgen::generate<worldgen::WorldGenType::SINE>(chunks[i].data(), positions[i]);
+
+    size_t saves, appends, grown, garbage_bytes, live_bytes;
+    double save_time;
+    {
+        Region region{ region_position };
+        for (size_t i = 0; i < positions.size(); ++i)
+            region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+
+        const auto start = Clock::now();
+        for (size_t s = 0; s < SAVES; ++s) {
+            const size_t i = std::rand() % positions.size();
+            for (size_t e = 0; e < EDITS_PER_SAVE; ++e)
+                chunks[i][std::rand() % cfg::CHUNK_VOLUME] = std::rand() % 8 == 0 ? 0 : (std::rand() % 250) + 1;
+            region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+        }
+        save_time = seconds(start, Clock::now());
+
+        const auto & stats = region.statistics();
+        saves = stats.saves.load() - positions.size();
+        appends = stats.appends.load() - positions.size();
+        grown = stats.grown.load();
+        garbage_bytes = stats.garbage_bytes.load();
+        live_bytes = region.liveBytes();
+    }
+    const size_t file_size = fileSize(region_position);
+
+    // check content after reopening
+    Region region{ region_position };
+    std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        const auto found = loadChunk(region, positions[i], loaded.data());
+        if (!found || loaded != chunks[i]) {
+            std::cout << "FAILED: chunk " << i << " does not match after reopening" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "saves:                      " << saves << std::endl;
+    std::cout << "appends per save:           " << double(appends) / saves << std::endl;
+    // saves with more data than the previous version of the chunk, slack keeps them from being appends
+    std::cout << "grown per save:             " << double(grown) / saves << std::endl;
+    std::cout << "garbage bytes per save:     " << double(garbage_bytes) / saves << std::endl;
+    std::cout << "save time per chunk [us]:   " << save_time / saves * 1e6 << std::endl;
+    std::cout << "live bytes:                 " << live_bytes << std::endl;
+    std::cout << "file size:                  " << file_size << std::endl;
+
+    // file must stay bounded by live data with slack in both halves of its slots, the header and the defragment
+    // threshold (chunks grow in their slots, nothing is appended after a commit)
+    const size_t allocated{
+        2 * (live_bytes + live_bytes / cfg::REGION_SLOT_SLACK_DIVISOR + positions.size() * cfg::REGION_SLOT_GRANULARITY)
+    };
+    const size_t bound{
+        Region::HEADER_SIZE + allocated + cfg::DEFRAGMENT_GARBAGE_THRESHOLD + cfg::COMPRESS_BUFFER_SIZE_IN_BYTES * 2
+    };
+    if (file_size > bound) {
+        std::cout << "FAILED: file size exceeds bound " << bound << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// churns chunks that keep outgrowing their slots (more random blocks every round), the garbage they leave behind
+// has to cross cfg::DEFRAGMENT_GARBAGE_THRESHOLD and cfg::DEFRAGMENT_GARBAGE_PERCENT, right after defragmenting
+// the file has to be back at the live data with slack, checks the region content afterwards
+int benchDefragment() {
+    static constexpr size_t ROUNDS{ 8 };
+    const glm::tvec3<cfg::Coord> region_position{ 0, -1, 400 };
+    auto positions = surfaceChunks();
+    for (auto & position : positions)
+        position += region_position * cfg::REGION_SIZE;
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+
+    size_t defragments{ 0 }, saves{ 0 };
+    size_t defragmented_size{ 0 }, defragmented_live{ 0 }, largest_size{ 0 };
+    {
+        Region region{ region_position };
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            // twice as many random blocks as the round before, every save outgrows its half
+            const cfg::Coord random_blocks{ cfg::CHUNK_VOLUME >> (ROUNDS - 1 - round) };
+            for (size_t i = 0; i < positions.size(); ++i) {
+                for (cfg::Coord b = 0; b < random_blocks; ++b)
+                    chunks[i][std::rand() % cfg::CHUNK_VOLUME] = (std::rand() % 250) + 1;
+                region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+                ++saves;
+                largest_size = std::max(largest_size, fileSize(region_position));
+                if (region.statistics().defragments.load() != defragments) {
+                    defragments = region.statistics().defragments.load();
+                    defragmented_size = fileSize(region_position);
+                    defragmented_live = region.liveBytes();
+                }
+            }
+        }
+        if (defragments == 0) {
+            std::cout << "FAILED: churning " << saves << " saves never defragmented" << std::endl;
+            return 1;
+        }
+    }
+
+    Region region{ region_position };
+    std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+    for (size_t i = 0; i < positions.size(); ++i)
+        if (!loadChunk(region, positions[i], loaded.data()) || loaded != chunks[i]) {
+            std::cout << "FAILED: chunk " << i << " does not match after defragmenting" << std::endl;
+            return 1;
+        }
+
+    std::cout << "saves:                      " << saves << std::endl;
+    std::cout << "defragments:                " << defragments << std::endl;
+    std::cout << "largest file size:          " << largest_size << std::endl;
+    std::cout << "live bytes (defragmented):  " << defragmented_live << std::endl;
+    std::cout << "file size (defragmented):   " << defragmented_size << std::endl;
+
+    // every chunk was just saved into a slot of its size, so both halves with slack and the header are all there is
+    const size_t bound{
+        Region::HEADER_SIZE + 2 * (defragmented_live + defragmented_live / cfg::REGION_SLOT_SLACK_DIVISOR +
+        positions.size() * cfg::REGION_SLOT_GRANULARITY)
+    };
+    if (defragmented_size > bound) {
+        std::cout << "FAILED: defragmented file size exceeds bound " << bound << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// save and load throughput and compression ratio of all available codecs over generated chunks
+int benchCodecs() {
+    using codec::CodecType;
+    std::vector<codec::Codec> codecs{
+        { CodecType::RAW, 0 }, { CodecType::ZLIB, 1 }, { CodecType::ZLIB, 6 }, { CodecType::ZLIB, 9 },
+        { CodecType::LZ4, 0 }, { CodecType::ZSTD, 1 }, { CodecType::ZSTD, 3 }, { CodecType::ZSTD, 9 }, { CodecType::ZSTD, 19 }
+    };
+    struct Generator {
+        const char * name;
+        void (*generate)(cfg::Block *, const glm::tvec3<cfg::Coord> &);
+    };
+    const Generator generators[]{
+        { "SINE", worldgen::generate<worldgen::WorldGenType::SINE> },
+        { "STANDARD", worldgen::generate<worldgen::WorldGenType::STANDARD> }
+    };
+
+    const auto positions = surfaceChunks();
+    const double raw_bytes = double(positions.size()) * cfg::CHUNK_VOLUME * sizeof(cfg::Block);
+    const auto previous_codec = codec::getDefault();
+    std::cout << "world\tcodec\tsave [MB/s]\tload [MB/s]\tratio" << std::endl;
+    for (cfg::Coord g = 0; g < 2; ++g) {
+        std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+        for (size_t i = 0; i < positions.size(); ++i)
+            generators[g].generate(chunks[i].data(), positions[i]);
+
+        for (cfg::Coord c = 0; c < static_cast<cfg::Coord>(codecs.size()); ++c) {
+            if (!codec::available(codecs[c].type))
+                continue;
+            codec::setDefault(codecs[c]);
+            Region region{ { c, 100 + g, 0 } };
+
+            const auto save_start = Clock::now();
+            for (size_t i = 0; i < positions.size(); ++i)
+                region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+            const auto save_time = seconds(save_start, Clock::now());
+
+            std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+            const auto load_start = Clock::now();
+            for (size_t i = 0; i < positions.size(); ++i)
+                loadChunk(region, positions[i], loaded.data());
+            const auto load_time = seconds(load_start, Clock::now());
+
+            for (size_t i = 0; i < positions.size(); ++i) {
+                loadChunk(region, positions[i], loaded.data());
+                if (loaded != chunks[i]) {
+                    std::cout << "FAILED: " << codec::name(codecs[c].type) << " chunk " << i << " does not match" << std::endl;
+                    codec::setDefault(previous_codec);
+                    return 1;
+                }
+            }
+
+            std::cout << generators[g].name << "\t" << codec::name(codecs[c].type) << ":" << codecs[c].level << "\t"
+                << raw_bytes / save_time / 1e6 << "\t" << raw_bytes / load_time / 1e6 << "\t"
+                << raw_bytes / region.liveBytes() << std::endl;
+        }
+    }
+    codec::setDefault(previous_codec);
+    return 0;
+}
+
+// file accesses per chunk load and save, half of the chunks are uniform (air)
+int benchSyscalls() {
+    const glm::tvec3<cfg::Coord> region_position{ 0, 200, 0 };
+    auto positions = surfaceChunks();
+    const size_t surface_count = positions.size();
+    for (size_t i = 0; i < surface_count; ++i)
+        positions.push_back(positions[i] + glm::tvec3<cfg::Coord>{ 0, 2, 0 });
+    std::vector<cfg::Block> chunk(cfg::CHUNK_VOLUME);
+
+    size_t save_syscalls;
+    {
+        Region region{ region_position };
+        for (const auto & position : positions) {
+            worldgen::generate<worldgen::WorldGenType::SINE>(chunk.data(), position);
+            region.saveChunk(Math::position_to_index(position, cfg::REGION_SIZE), chunk.data(), scratch());
+        }
+        save_syscalls = region.statistics().syscalls.load();
+    }
+
+    Region region{ region_position };
+    for (const auto & position : positions)
+        loadChunk(region, position, chunk.data());
+    const size_t load_syscalls = region.statistics().syscalls.load();
+
+    std::cout << "chunks:              " << positions.size() << " (" << positions.size() - surface_count << " uniform)" << std::endl;
+    std::cout << "syscalls per save:   " << double(save_syscalls) / positions.size() << std::endl;
+    std::cout << "syscalls per load:   " << double(load_syscalls) / positions.size() << std::endl;
+    return 0;
+}
+
+// loads slabs of chunks while walking along x with both region backends, first with cold then with warm page cache
+int benchBackends() {
+    static constexpr cfg::Coord WALK_LENGTH{ 64 };
+    static constexpr glm::tvec3<cfg::Coord> WALK_START{ 0, -1, 1000 };
+    std::vector<glm::tvec3<cfg::Coord>> slab;
+    glm::tvec3<cfg::Coord> i{ 0, 0, 0 };
+    for (i.z = -2; i.z <= 2; ++i.z)
+        for (i.y = 0; i.y <= 1; ++i.y)
+            slab.push_back(i);
+
+    using RegionMap = std::vector<std::pair<glm::tvec3<cfg::Coord>, std::unique_ptr<Region>>>;
+    auto getRegion = [](RegionMap & regions, const glm::tvec3<cfg::Coord> & chunk_position) -> Region & {
+        const auto region_position = Math::floor_div(chunk_position, cfg::REGION_SIZE);
+        for (auto & region : regions)
+            if (glm::all(glm::equal(region.first, region_position)))
+                return *region.second;
+        regions.emplace_back(region_position, std::make_unique<Region>(region_position));
+        return *regions.back().second;
+    };
+
+    std::vector<glm::tvec3<cfg::Coord>> region_positions;
+    {
+        RegionMap regions;
+        std::vector<cfg::Block> chunk(cfg::CHUNK_VOLUME);
+        for (cfg::Coord x = 0; x < WALK_LENGTH; ++x)
+            for (const auto & offset : slab) {
+                const auto position = WALK_START + offset + glm::tvec3<cfg::Coord>{ x, 0, 0 };
+                worldgen::generate<worldgen::WorldGenType::SINE>(chunk.data(), position);
+                getRegion(regions, position).saveChunk(Math::position_to_index(position, cfg::REGION_SIZE), chunk.data(), scratch());
+            }
+        for (const auto & region : regions)
+            region_positions.push_back(region.first);
+    }
+
+    auto dropPageCache = [&region_positions]() {
+        for (const auto & region_position : region_positions) {
+            const std::string name{
+                "world/" + std::to_string(region_position.x) + "|" +
+                std::to_string(region_position.y) + "|" + std::to_string(region_position.z)
+            };
+            const int file = open(name.c_str(), O_RDONLY);
+            fdatasync(file);
+            posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+            close(file);
+        }
+    };
+
+    auto walk = [&](uint64_t & checksum) {
+        RegionMap regions;
+        std::vector<cfg::Block> chunk(cfg::CHUNK_VOLUME);
+        const auto start = Clock::now();
+        for (cfg::Coord x = 0; x < WALK_LENGTH; ++x)
+            for (const auto & offset : slab) {
+                const auto position = WALK_START + offset + glm::tvec3<cfg::Coord>{ x, 0, 0 };
+                loadChunk(getRegion(regions, position), position, chunk.data());
+                for (const auto block : chunk)
+                    checksum += block;
+            }
+        return seconds(start, Clock::now());
+    };
+
+    const auto previous_backend = Region::getDefaultBackend();
+    const double chunk_count = double(WALK_LENGTH) * slab.size();
+    uint64_t expected_checksum = 0;
+    std::cout << "backend\tcold [chunks/s]\twarm [chunks/s]" << std::endl;
+    for (const auto backend : { Region::Backend::PREAD, Region::Backend::MMAP }) {
+        Region::setDefaultBackend(backend);
+        uint64_t cold_checksum = 0, warm_checksum = 0;
+        dropPageCache();
+        const auto cold_time = walk(cold_checksum);
+        const auto warm_time = walk(warm_checksum);
+        if (expected_checksum == 0)
+            expected_checksum = cold_checksum;
+        if (cold_checksum != expected_checksum || warm_checksum != expected_checksum) {
+            std::cout << "FAILED: loaded chunks differ" << std::endl;
+            Region::setDefaultBackend(previous_backend);
+            return 1;
+        }
+        std::cout << (backend == Region::Backend::PREAD ? "pread" : "mmap") << "\t"
+            << chunk_count / cold_time << "\t" << chunk_count / warm_time << std::endl;
+    }
+    Region::setDefaultBackend(previous_backend);
+    return 0;
+}
+
+// loads a region worth of chunks one after another and through ChunkIO (all submitted at once)
+// cold runs drop the page cache first
+int benchChunkIO() {
+    // two layers around the terrain surface
+    std::vector<glm::tvec3<cfg::Coord>> positions;
+    glm::tvec3<cfg::Coord> i;
+    for (i.z = 0; i.z < cfg::REGION_SIZE.z; ++i.z)
+        for (i.y = -2; i.y < 0; ++i.y)
+            for (i.x = 2000; i.x < 2000 + cfg::REGION_SIZE.x; ++i.x)
+                positions.push_back(i);
+    const auto region_position = Math::floor_div(positions.front(), cfg::REGION_SIZE);
+    std::vector<cfg::Block> chunks(positions.size() * cfg::CHUNK_VOLUME);
+    {
+        Region region{ region_position };
+        for (size_t j = 0; j < positions.size(); ++j) {
+            worldgen::generate<worldgen::WorldGenType::SINE>(chunks.data() + j * cfg::CHUNK_VOLUME, positions[j]);
+            region.saveChunk(Math::position_to_index(positions[j], cfg::REGION_SIZE), chunks.data() + j * cfg::CHUNK_VOLUME, scratch());
+        }
+    }
+
+    auto dropPageCache = [&region_position]() {
+        const std::string name{
+            "world/" + std::to_string(region_position.x) + "|" +
+            std::to_string(region_position.y) + "|" + std::to_string(region_position.z)
+        };
+        const int file = open(name.c_str(), O_RDONLY);
+        fdatasync(file);
+        posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+        close(file);
+    };
+    auto checksum = [&chunks]() {
+        uint64_t result = 0;
+        for (const auto block : chunks)
+            result += block;
+        return result;
+    };
+
+    const auto expected_checksum = checksum();
+    const double chunk_count = positions.size();
+    std::cout << "engine\tcold [chunks/s]\twarm [chunks/s]\trequests" << std::endl;
+    const auto previous_backend = ChunkIO::getDefaultBackend();
+    for (const char * engine : { "sync", "threads", "uring" }) {
+        const bool sync = std::strcmp(engine, "sync") == 0;
+        ChunkIO::setDefaultBackend(std::strcmp(engine, "uring") == 0 ? ChunkIO::Backend::URING : ChunkIO::Backend::THREADS);
+        std::unique_ptr<ChunkIO> chunk_io{ sync ? nullptr : std::make_unique<ChunkIO>(1) };
+        if (chunk_io != nullptr && std::strcmp(engine, "uring") == 0 && chunk_io->backend() != ChunkIO::Backend::URING) {
+            std::cout << engine << "\tnot available" << std::endl;
+            continue;
+        }
+        // cold, warm
+        double times[2];
+        for (int run = 0; run < 2; ++run) {
+            if (run == 0)
+                dropPageCache();
+            std::fill(std::begin(chunks), std::end(chunks), cfg::Block{ 0 });
+            Region region{ region_position };
+            const auto start = Clock::now();
+            if (sync) {
+                for (size_t j = 0; j < positions.size(); ++j)
+                    loadChunk(region, positions[j], chunks.data() + j * cfg::CHUNK_VOLUME);
+            } else {
+                for (size_t j = 0; j < positions.size(); ++j) {
+                    ChunkIO::Request request;
+                    request.region = &region;
+                    request.chunk_position = positions[j];
+                    request.chunk = chunks.data() + j * cfg::CHUNK_VOLUME;
+                    chunk_io->submit(0, request);
+                }
+                ChunkIO::Request completed;
+                while (chunk_io->wait(0, completed));
+            }
+            times[run] = seconds(start, Clock::now());
+            if (checksum() != expected_checksum) {
+                std::cout << "FAILED: loaded chunks differ" << std::endl;
+                ChunkIO::setDefaultBackend(previous_backend);
+                return 1;
+            }
+        }
+        std::cout << engine << "\t" << chunk_count / times[0] << "\t" << chunk_count / times[1];
+        if (chunk_io != nullptr) {
+            const auto & stats = chunk_io->statistics();
+            std::cout << "\t" << stats.uring_reads.load() << " uring reads, " << stats.thread_requests.load()
+                << " thread requests, " << stats.batches.load() << " batches";
+        }
+        std::cout << std::endl;
+    }
+    ChunkIO::setDefaultBackend(previous_backend);
+    return 0;
+}
+
+// time a worker spends evicting dirty chunks, saving them itself vs handing them to ChunkWriter (with a writer
+// thread, and without one like VoxelContainer where SAVE tasks write them after each round), a round evicts a
+// region's worth of chunks like a step of the center chunk does, then checks what ended up in the regions
+int benchWriter() {
+    static constexpr size_t ROUNDS{ 4 };
+    auto positions = surfaceChunks();
+    for (auto & position : positions)
+        position.x += 200 * cfg::REGION_SIZE.x;
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    for (size_t i = 0; i < positions.size(); ++i)
+        worldgen::generate<worldgen::WorldGenType::SINE>(chunks[i].data(), positions[i]);
+    const auto region_position = Math::floor_div(positions.front(), cfg::REGION_SIZE);
+    const double save_count = ROUNDS * positions.size();
+
+    // a round is evicted, then written while the worker would be loading the chunks of the step
+    auto measureWriter = [&](const char * name, ChunkWriter & writer, auto && write, size_t edit) {
+        double worker_time = 0;
+        const auto start = Clock::now();
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            const auto round_start = Clock::now();
+            for (size_t i = 0; i < positions.size(); ++i) {
+                chunks[i][round + edit * ROUNDS] = cfg::Block{ 1 };
+                writer.save(positions[i], chunks[i].data());
+            }
+            worker_time += seconds(round_start, Clock::now());
+            write();
+        }
+        const auto total_time = seconds(start, Clock::now()) / save_count * 1e6;
+        const auto & stats = writer.statistics();
+        std::cout << name << "\t" << worker_time / save_count * 1e6 << "\t" << total_time << "\t"
+            << stats.written.load() << " written, " << stats.coalesced.load() << " coalesced, "
+            << stats.stalls.load() << " stalls" << std::endl;
+        if (stats.stalls.load() > 0) {
+            std::cout << "FAILED: eviction stalled" << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    std::cout << "eviction\tworker [us/chunk]\ttotal [us/chunk]" << std::endl;
+    {
+        Region region{ region_position };
+        const auto start = Clock::now();
+        for (size_t round = 0; round < ROUNDS; ++round)
+            for (size_t i = 0; i < positions.size(); ++i) {
+                chunks[i][round] = cfg::Block{ 1 };
+                region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+            }
+        const auto time = seconds(start, Clock::now()) / save_count * 1e6;
+        std::cout << "inline\t" << time << "\t" << time << std::endl;
+    }
+    {
+        RegionContainer region_container;
+        ChunkWriter writer{ region_container };
+        if (!measureWriter("writer", writer, [&writer]() { writer.drain(); }, 1))
+            return 1;
+    }
+    {
+        RegionContainer region_container;
+        ChunkWriter writer{ region_container, false };
+        if (!measureWriter("tasks", writer, [&writer]() { writer.write(scratch()); }, 2))
+            return 1;
+    }
+
+    Region region{ region_position };
+    std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+    for (size_t i = 0; i < positions.size(); ++i)
+        if (!loadChunk(region, positions[i], loaded.data()) || loaded != chunks[i]) {
+            std::cout << "FAILED: chunk " << i << " differs" << std::endl;
+            return 1;
+        }
+    return 0;
+}
+
+// heap allocations per chunk load and save once everything is warmed up, must be 0
+int benchAllocations() {
+    static constexpr size_t ROUNDS{ 8 };
+    auto positions = surfaceChunks();
+    for (auto & position : positions)
+        position.x += 400 * cfg::REGION_SIZE.x;
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    for (size_t i = 0; i < positions.size(); ++i)
+        worldgen::generate<worldgen::WorldGenType::SINE>(chunks[i].data(), positions[i]);
+    std::vector<cfg::Block> loaded(positions.size() * cfg::CHUNK_VOLUME);
+    const auto region_position = Math::floor_div(positions.front(), cfg::REGION_SIZE);
+
+    auto allocations = []() { return heap_allocations.load() + codec::allocationCount(); };
+    // edits make chunks grow now and then, so appends and defragmenting are part of it
+    auto edit = [&chunks](size_t round) {
+        for (auto & chunk : chunks)
+            chunk[(round * 997) % cfg::CHUNK_VOLUME] = cfg::Block{ 1 };
+    };
+    // second pass is measured, first one warms up (zlib deflate state, queue capacities)
+    auto measure = [&](const char * name, auto && round) {
+        size_t counted = 0;
+        for (size_t pass = 0; pass < 2; ++pass) {
+            const auto before = allocations();
+            for (size_t r = 0; r < ROUNDS; ++r)
+                round(r);
+            counted = allocations() - before;
+        }
+        const double per_chunk = double(counted) / (ROUNDS * positions.size());
+        std::cout << name << "\t" << per_chunk << std::endl;
+        return counted == 0;
+    };
+
+    bool zero = true;
+    std::cout << "path\tallocations per chunk" << std::endl;
+    for (const auto backend : { Region::Backend::PREAD, Region::Backend::MMAP }) {
+        const auto previous_backend = Region::getDefaultBackend();
+        Region::setDefaultBackend(backend);
+        Region region{ region_position };
+        Region::setDefaultBackend(previous_backend);
+        const bool pread = backend == Region::Backend::PREAD;
+        zero &= measure(pread ? "save (pread)" : "save (mmap)", [&](size_t r) {
+            edit(r);
+            for (size_t i = 0; i < positions.size(); ++i)
+                region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+        });
+        zero &= measure(pread ? "load (pread)" : "load (mmap)", [&](size_t) {
+            for (size_t i = 0; i < positions.size(); ++i)
+                loadChunk(region, positions[i], loaded.data() + i * cfg::CHUNK_VOLUME);
+        });
+    }
+
+    const auto previous_backend = ChunkIO::getDefaultBackend();
+    for (const auto backend : { ChunkIO::Backend::THREADS, ChunkIO::Backend::URING }) {
+        ChunkIO::setDefaultBackend(backend);
+        ChunkIO chunk_io{ 1 };
+        ChunkIO::setDefaultBackend(previous_backend);
+        if (chunk_io.backend() != backend)
+            continue;
+        Region region{ region_position };
+        zero &= measure(backend == ChunkIO::Backend::URING ? "ChunkIO (uring)" : "ChunkIO (threads)", [&](size_t) {
+            ChunkIO::Request request;
+            request.region = &region;
+            for (size_t i = 0; i < positions.size(); ++i) {
+                request.chunk_position = positions[i];
+                request.chunk = loaded.data() + i * cfg::CHUNK_VOLUME;
+                chunk_io.submit(0, request);
+                ChunkIO::Request completed;
+                while (chunk_io.poll(0, completed));
+            }
+            ChunkIO::Request completed;
+            while (chunk_io.wait(0, completed));
+        });
+    }
+
+    {
+        RegionContainer region_container;
+        ChunkWriter writer{ region_container };
+        zero &= measure("ChunkWriter", [&](size_t r) {
+            edit(r);
+            for (size_t i = 0; i < positions.size(); ++i)
+                writer.save(positions[i], chunks[i].data());
+            writer.drain();
+        });
+    }
+
+    if (!zero)
+        std::cout << "FAILED: steady state allocates" << std::endl;
+    return zero ? 0 : 1;
+}
+
+// saves, commits, saves some chunks again and closes, then breaks the newest header copy like a crash while
+// writing it would, reopening must find the chunks of the first commit, also times commits and opening
+int benchRecovery() {
+    static constexpr size_t CHUNK_COUNT{ 16 };
+    // few enough to stay below the defragment limits, defragmenting commits too
+    static constexpr size_t RESAVED_COUNT{ 4 };
+    auto positions = surfaceChunks();
+    positions.resize(CHUNK_COUNT);
+    for (auto & position : positions)
+        position.z += 600 * cfg::REGION_SIZE.z;
+    const auto region_position = Math::floor_div(positions.front(), cfg::REGION_SIZE);
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    for (size_t i = 0; i < positions.size(); ++i)
+        worldgen::generate<worldgen::WorldGenType::SINE>(chunks[i].data(), positions[i]);
+
+    double commit_time;
+    {
+        Region region{ region_position };
+        for (size_t i = 0; i < positions.size(); ++i)
+            region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+        const auto start = Clock::now();
+        region.checkpoint();
+        commit_time = seconds(start, Clock::now());
+        // saved again, but only committed on close
+        std::vector<cfg::Block> edited(cfg::CHUNK_VOLUME);
+        for (size_t i = 0; i < RESAVED_COUNT; ++i) {
+            edited = chunks[i];
+            edited[i] = cfg::Block{ 1 };
+            region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), edited.data(), scratch());
+        }
+        if (region.statistics().commits.load() != 1) {
+            std::cout << "FAILED: region was defragmented, resave fewer chunks" << std::endl;
+            return 1;
+        }
+    }
+
+    const int fd = open(fileName(region_position).c_str(), O_RDWR);
+    Region::HeaderInfo infos[2];
+    for (cfg::RegUint copy = 0; copy < 2; ++copy)
+        pread(fd, &infos[copy], sizeof(Region::HeaderInfo), copy * Region::HEADER_COPY_SIZE);
+    const cfg::RegUint newest{ infos[1].sequence > infos[0].sequence ? 1u : 0u };
+    const cfg::RegUint torn{ 0xdeadbeef };
+    pwrite(fd, &torn, sizeof(torn), newest * Region::HEADER_COPY_SIZE + Region::HEADER_INFO_SIZE + 64);
+    close(fd);
+
+    const auto start = Clock::now();
+    Region region{ region_position };
+    const double open_time = seconds(start, Clock::now());
+    std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+    for (size_t i = 0; i < positions.size(); ++i)
+        if (!loadChunk(region, positions[i], loaded.data()) || loaded != chunks[i]) {
+            std::cout << "FAILED: chunk " << i << " is not the committed version" << std::endl;
+            return 1;
+        }
+
+    std::cout << "commit time [ms]:        " << commit_time * 1e3 << std::endl;
+    std::cout << "open after crash [ms]:   " << open_time * 1e3 << std::endl;
+    std::cout << "recovered sequence:      " << infos[1 - newest].sequence << std::endl;
+    return 0;
+}
+
+// breaks the data of one chunk on disk, loading it must report it as corrupt and scanning must find it
+// also shows how much of a load verifying the checksum takes
+int benchChecksums() {
+    auto positions = surfaceChunks();
+    for (auto & position : positions)
+        position.z += 800 * cfg::REGION_SIZE.z;
+    const auto region_position = Math::floor_div(positions.front(), cfg::REGION_SIZE);
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    {
+        Region region{ region_position };
+        for (size_t i = 0; i < positions.size(); ++i) {
+            worldgen::generate<worldgen::WorldGenType::SINE>(chunks[i].data(), positions[i]);
+            region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+        }
+    }
+
+    std::vector<cfg::RegByte> data(cfg::COMPRESS_BUFFER_SIZE_IN_BYTES);
+    double checksum_time{ 0 };
+    size_t data_bytes{ 0 };
+    const size_t broken{ positions.size() / 2 };
+    const cfg::RegUint broken_index{ static_cast<cfg::RegUint>(Math::position_to_index(positions[broken], cfg::REGION_SIZE)) };
+    {
+        const int fd = open(fileName(region_position).c_str(), O_RDWR);
+        Region::HeaderInfo infos[2];
+        for (cfg::RegUint copy = 0; copy < 2; ++copy)
+            pread(fd, &infos[copy], sizeof(Region::HeaderInfo), copy * Region::HEADER_COPY_SIZE);
+        const cfg::RegUint newest{ infos[1].sequence > infos[0].sequence ? 1u : 0u };
+        std::vector<Region::Slot> slots(cfg::REGION_VOLUME);
+        pread(fd, slots.data(), slots.size() * sizeof(Region::Slot), newest * Region::HEADER_COPY_SIZE + Region::HEADER_INFO_SIZE);
+        for (const auto & slot : slots) {
+            if (!slot.hasData())
+                continue;
+            pread(fd, data.data(), slot.size, slot.dataPosition());
+            const auto start = Clock::now();
+            if (codec::checksum(data.data(), slot.size) != slot.checksum) {
+                std::cout << "FAILED: checksum mismatch before breaking anything" << std::endl;
+                return 1;
+            }
+            checksum_time += seconds(start, Clock::now());
+            data_bytes += slot.size;
+        }
+        // flip a bit in the middle of one chunk
+        const Region::Slot & slot = slots[broken_index];
+        cfg::RegByte byte;
+        pread(fd, &byte, 1, slot.dataPosition() + slot.size / 2);
+        byte ^= 0x10;
+        pwrite(fd, &byte, 1, slot.dataPosition() + slot.size / 2);
+        close(fd);
+    }
+
+    std::vector<cfg::RegByte> scan_buffer(cfg::COMPRESS_BUFFER_SIZE_IN_BYTES * 16);
+    const auto scan_result = Region::scan(fileName(region_position).c_str(), scan_buffer.data(), scan_buffer.size());
+    if (!scan_result.valid_header || scan_result.corrupt_chunks != std::vector<cfg::RegUint>{ broken_index }) {
+        std::cout << "FAILED: scan did not find exactly the broken chunk" << std::endl;
+        return 1;
+    }
+
+    Region region{ region_position };
+    std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+    const auto start = Clock::now();
+    for (size_t i = 0; i < positions.size(); ++i) {
+        const bool found = loadChunk(region, positions[i], loaded.data());
+        if (found != (i != broken) || (found && loaded != chunks[i])) {
+            std::cout << "FAILED: chunk " << i << (i == broken ? " not reported as corrupt" : " differs") << std::endl;
+            return 1;
+        }
+    }
+    const double load_time = seconds(start, Clock::now());
+
+    std::cout << "checksum [MB/s]:             " << data_bytes / checksum_time / 1e6 << std::endl;
+    std::cout << "checksum share of load time: " << checksum_time / load_time * 100 << " %" << std::endl;
+    std::cout << "corrupt loads:               " << region.statistics().corrupt.load() << std::endl;
+    return 0;
+}
+
+// the same regions (few chunks each, like the edge of an explored world) with a file per region and in
+// world files, times creating them and opening them again (the lookup, plus loading one chunk)
+int benchStorage() {
+    static constexpr cfg::Coord REGIONS_PER_SIDE{ 16 };
+    static constexpr size_t CHUNKS_PER_REGION{ 4 };
+    auto positions = surfaceChunks();
+    positions.resize(CHUNKS_PER_REGION);
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    for (size_t i = 0; i < positions.size(); ++i)
+        worldgen::generate<worldgen::WorldGenType::SINE>(chunks[i].data(), positions[i]);
+    // every region gets its own content
+    auto regionChunk = [&chunks](size_t region, size_t i) {
+        std::vector<cfg::Block> chunk{ chunks[i] };
+        chunk[region % cfg::CHUNK_VOLUME] ^= cfg::Block{ 1 };
+        return chunk;
+    };
+
+    struct Result {
+        double create_time;
+        double reopen_time;
+        size_t bytes;
+    };
+    auto run = [&](Region::Storage storage, cfg::Coord region_y) -> Result {
+        Region::setDefaultStorage(storage);
+        std::vector<glm::tvec3<cfg::Coord>> region_positions;
+        for (cfg::Coord z = 0; z < REGIONS_PER_SIDE; ++z)
+            for (cfg::Coord x = 0; x < REGIONS_PER_SIDE; ++x)
+                region_positions.push_back({ x, region_y, z });
+
+        Result result{ 0, 0, 0 };
+        auto start = Clock::now();
+        for (size_t r = 0; r < region_positions.size(); ++r) {
+            Region region{ region_positions[r] };
+            for (size_t i = 0; i < positions.size(); ++i)
+                region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), regionChunk(r, i).data(), scratch());
+        }
+        result.create_time = seconds(start, Clock::now());
+
+        std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+        start = Clock::now();
+        for (size_t r = 0; r < region_positions.size(); ++r) {
+            Region region{ region_positions[r] };
+            if (!loadChunk(region, positions[0], loaded.data()))
+                throw std::runtime_error("chunk missing after reopening");
+        }
+        result.reopen_time = seconds(start, Clock::now());
+
+        for (size_t r = 0; r < region_positions.size(); ++r) {
+            Region region{ region_positions[r] };
+            for (size_t i = 0; i < positions.size(); ++i)
+                if (!loadChunk(region, positions[i], loaded.data()) || loaded != regionChunk(r, i))
+                    throw std::runtime_error("chunk differs after reopening");
+            if (storage == Region::Storage::FILES)
+                result.bytes += fileSize(region_positions[r]);
+        }
+        return result;
+    };
+
+    const Result files = run(Region::Storage::FILES, 1000);
+    Result world = run(Region::Storage::WORLD_FILES, 1001);
+    Region::setDefaultStorage(Region::Storage::FILES);
+    // opening a world file reads its whole index
+    size_t lookups{ 0 }, allocations{ 0 }, reused{ 0 }, commits{ 0 };
+    double index_time{ 0 };
+    for (size_t f = 0; f < cfg::WORLD_FILE_COUNT; ++f) {
+        const std::string world_file_name{ "world/world." + std::to_string(f) };
+        struct stat file_info;
+        if (stat(world_file_name.c_str(), &file_info) != 0)
+            continue;
+        world.bytes += file_info.st_size;
+        const auto start = Clock::now();
+        WorldFile file{ world_file_name.c_str() };
+        index_time += seconds(start, Clock::now());
+    }
+    // statistics of the shared instances the regions used
+    std::vector<const WorldFile *> counted;
+    for (cfg::Coord z = 0; z < REGIONS_PER_SIDE; ++z)
+        for (cfg::Coord x = 0; x < REGIONS_PER_SIDE; ++x) {
+            const WorldFile & file = WorldFile::get({ x, 1001, z });
+            if (std::find(std::begin(counted), std::end(counted), &file) != std::end(counted))
+                continue;
+            counted.push_back(&file);
+            lookups += file.statistics().lookups.load();
+            allocations += file.statistics().allocations.load();
+            reused += file.statistics().reused.load();
+            commits += file.statistics().commits.load();
+        }
+    const size_t region_count{ size_t(REGIONS_PER_SIDE) * REGIONS_PER_SIDE };
+    std::cout << "regions:                     " << region_count << " with " << CHUNKS_PER_REGION << " chunks" << std::endl;
+    std::cout << "files create [ms/region]:    " << files.create_time / region_count * 1e3 << std::endl;
+    std::cout << "files reopen [us/region]:    " << files.reopen_time / region_count * 1e6 << std::endl;
+    std::cout << "files disk [MB]:             " << files.bytes / 1e6 << std::endl;
+    std::cout << "world create [ms/region]:    " << world.create_time / region_count * 1e3 << std::endl;
+    std::cout << "world reopen [us/region]:    " << world.reopen_time / region_count * 1e6 << std::endl;
+    std::cout << "world disk [MB]:             " << world.bytes / 1e6 << std::endl;
+    std::cout << "world index load [ms/all]:   " << index_time * 1e3 << std::endl;
+    std::cout << "world lookups:               " << lookups << std::endl;
+    std::cout << "world allocations:           " << allocations << " (" << reused << " reused)" << std::endl;
+    std::cout << "world commits:               " << commits << std::endl;
+    return 0;
+}
+
+// threads getting and releasing regions of the same neighbourhood from one RegionContainer, like workers
+// loading and saving chunks around the player, the regions are open already so only the lookup is timed
+int benchRegions() {
+    static constexpr cfg::Coord SIDE{ 4 };
+    static constexpr size_t OPERATIONS_PER_THREAD{ 1000000 };
+    static_assert(SIDE * SIDE * SIDE <= cfg::REGION_CACHE_SIZE, "Regions must not be closed while timing.");
+    std::vector<glm::tvec3<cfg::Coord>> region_positions;
+    for (cfg::Coord z = 0; z < SIDE; ++z)
+        for (cfg::Coord y = 0; y < SIDE; ++y)
+            for (cfg::Coord x = 0; x < SIDE; ++x)
+                region_positions.push_back({ x, 1100 + y, z });
+
+    RegionContainer region_container;
+    for (const auto & region_position : region_positions) {
+        region_container.get(region_position);
+        region_container.release(region_position);
+    }
+
+    std::cout << "threads	get+release [Mops/s]" << std::endl;
+    for (size_t thread_count = 1; thread_count <= 16; thread_count *= 2) {
+        std::vector<std::thread> threads;
+        const auto start = Clock::now();
+        for (size_t t = 0; t < thread_count; ++t)
+            threads.emplace_back([&region_container, &region_positions, t]() {
+                // neighbouring threads mostly use different regions, sometimes the same
+                for (size_t i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                    const auto & region_position = region_positions[(t * 7 + i) % region_positions.size()];
+                    region_container.get(region_position);
+                    region_container.release(region_position);
+                }
+            });
+        for (auto & thread : threads)
+            thread.join();
+        const double time = seconds(start, Clock::now());
+        std::cout << thread_count << "\t" << thread_count * OPERATIONS_PER_THREAD / time / 1e6 << std::endl;
+    }
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    return 0;
+}
+
+// terrain made of layers (grass, dirt, stone) with sparse ores, what real worlds look like more than the
+// random blocks of worldgen
+void generateLayers(cfg::Block * chunk, const glm::tvec3<cfg::Coord> & chunk_position) {
+    glm::tvec3<cfg::Coord> i;
+    const glm::tvec3<cfg::Coord> fr{ chunk_position * cfg::CHUNK_SIZE };
+    const glm::tvec3<cfg::Coord> to{ fr + cfg::CHUNK_SIZE };
+    for (i.z = fr.z; i.z < to.z; ++i.z)
+        for (i.y = fr.y; i.y < to.y; ++i.y)
+            for (i.x = fr.x; i.x < to.x; ++i.x) {
+                const auto height = static_cast<cfg::Coord>(std::sin(i.x * 0.05) * std::sin(i.z * 0.05) * 12.0) - 16;
+                const auto hash = static_cast<uint32_t>(i.x * 73856093 ^ i.y * 19349663 ^ i.z * 83492791);
+                cfg::Block block{ 0 };
+                if (i.y <= height - 4)
+                    block = hash % 64 == 0 ? cfg::Block(4 + hash / 64 % 3) : cfg::Block{ 1 };
+                else if (i.y < height)
+                    block = 3;
+                else if (i.y == height)
+                    block = 2;
+                chunk[Math::position_to_index(i, cfg::CHUNK_SIZE)] = block;
+            }
+}
+
+// quads as bytes in order, to compare meshes with the quads in another order
+std::vector<std::string> sortedQuads(const std::vector<cfg::Vertex> & mesh) {
+    std::vector<std::string> quads;
+    for (size_t q = 0; q + 3 < mesh.size(); q += 4) {
+        std::string quad;
+        for (size_t k = 0; k < 4; ++k) {
+            quad.append(reinterpret_cast<const char *>(mesh[q + k].vals), sizeof(mesh[q + k].vals));
+            quad.append(reinterpret_cast<const char *>(&mesh[q + k].block), sizeof(mesh[q + k].block));
+        }
+        quads.push_back(std::move(quad));
+    }
+    std::sort(std::begin(quads), std::end(quads));
+    return quads;
+}
+
+// merged quads of MesherType::GREEDY and the bit mask rows of MesherType::BITMASK against a quad per face (the
+// mesher VoxelContainer used before), meshes of a region layer on the surface, time and vertices per mesh, the
+// merged quads have to cover the same faces, the bit mask quads have to be the very same ones
+int benchGreedy() {
+    using mesher::MesherType;
+    static constexpr cfg::Coord MESHES{ 8 };
+    struct Generator {
+        const char * name;
+        void (*generate)(cfg::Block *, const glm::tvec3<cfg::Coord> &);
+    };
+    // SINE picks a random block for every position, nothing merges but faces of the same shading, SINE-1 is
+    // the same terrain of one block
+    const Generator generators[]{
+        { "SINE", worldgen::generate<worldgen::WorldGenType::SINE> },
+        { "SINE-1", [](cfg::Block * chunk, const glm::tvec3<cfg::Coord> & chunk_position) {
+            worldgen::generate<worldgen::WorldGenType::SINE>(chunk, chunk_position);
+            std::replace_if(chunk, chunk + cfg::CHUNK_VOLUME, [](cfg::Block block) { return block != 0; }, cfg::Block{ 1 });
+        } },
+        { "STANDARD", worldgen::generate<worldgen::WorldGenType::STANDARD> },
+        { "LAYERS", generateLayers }
+    };
+    struct Mesher {
+        const char * name;
+        void (*mesh)(std::vector<cfg::Vertex> &, const std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> &);
+    };
+    const Mesher meshers[]{
+        { "faces", mesher::mesh<MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_BETTER_COPY> },
+        { "greedy", mesher::mesh<MesherType::GREEDY> },
+        { "bitmask", mesher::mesh<MesherType::BITMASK> }
+    };
+    // faces covered, weighted by block and by ambient occlusion, the same for both meshers
+    struct Coverage {
+        size_t faces{ 0 }, blocks{ 0 }, aos{ 0 };
+        bool operator == (const Coverage & other) const { return faces == other.faces && blocks == other.blocks && aos == other.aos; }
+    };
+    auto coverage = [](const std::vector<cfg::Vertex> & mesh) {
+        Coverage result;
+        for (size_t q = 0; q + 3 < mesh.size(); q += 4) {
+            // extent from the first corner to the third, one axis is 0
+            size_t area{ 1 };
+            for (size_t a = 0; a < 3; ++a) {
+                const size_t extent = std::abs((mesh[q + 2].vals[a] & 63) - (mesh[q].vals[a] & 63));
+                area *= std::max<size_t>(extent, 1);
+            }
+            result.faces += area;
+            result.blocks += area * mesh[q].block;
+            result.aos += area * (mesh[q].vals[3] + mesh[q].vals[4] * 3 + mesh[q].vals[5] * 5 + mesh[q].vals[6] * 7);
+        }
+        return result;
+    };
+
+    // meshes at the chunk corners of a surface layer need the chunks of the layer above too
+    const glm::tvec3<cfg::Coord> chunk_count{ MESHES + 1, 2, MESHES + 1 };
+    std::vector<std::vector<cfg::Block>> chunks(Math::volume(chunk_count), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    std::vector<cfg::Vertex> mesh;
+    std::cout << "world\tmesher\tmesh [us]\tvertices/mesh\tupload [KiB/mesh]" << std::endl;
+    for (const auto & generator : generators) {
+        glm::tvec3<cfg::Coord> i;
+        for (i.z = 0; i.z < chunk_count.z; ++i.z)
+            for (i.y = 0; i.y < chunk_count.y; ++i.y)
+                for (i.x = 0; i.x < chunk_count.x; ++i.x)
+                    generator.generate(chunks[Math::to_index(i, chunk_count)].data(), i + glm::tvec3<cfg::Coord>{ 0, -1, 0 });
+        std::vector<Coverage> coverages;
+        std::vector<std::vector<std::string>> face_quads;
+        size_t differing{ 0 };
+        for (const auto & mesher : meshers) {
+            double time{ 0 };
+            size_t vertices{ 0 };
+            Coverage total;
+            for (i.z = 0; i.z < MESHES; ++i.z)
+                for (i.x = 0; i.x < MESHES; ++i.x) {
+                    std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> mesh_chunks;
+                    glm::tvec3<cfg::Coord> j;
+                    for (j.z = 0; j.z < cfg::MESH_CHUNK_SIZE.z; ++j.z)
+                        for (j.y = 0; j.y < cfg::MESH_CHUNK_SIZE.y; ++j.y)
+                            for (j.x = 0; j.x < cfg::MESH_CHUNK_SIZE.x; ++j.x)
+                                mesh_chunks[Math::to_index(j, cfg::MESH_CHUNK_SIZE)] =
+                                    chunks[Math::to_index(glm::tvec3<cfg::Coord>{ i.x, 0, i.z } + j, chunk_count)].data();
+                    const auto start = Clock::now();
+                    mesher.mesh(mesh, mesh_chunks);
+                    time += seconds(start, Clock::now());
+                    vertices += mesh.size();
+                    const auto mesh_coverage = coverage(mesh);
+                    total.faces += mesh_coverage.faces;
+                    total.blocks += mesh_coverage.blocks;
+                    total.aos += mesh_coverage.aos;
+                    if (&mesher == &meshers[0])
+                        face_quads.push_back(sortedQuads(mesh));
+                    else if (std::string{ mesher.name } == "bitmask")
+                        differing += sortedQuads(mesh) != face_quads[i.x + i.z * MESHES];
+                }
+            coverages.push_back(total);
+            const size_t mesh_count{ MESHES * MESHES };
+            std::cout << generator.name << "\t" << mesher.name << "\t" << time * 1e6 / mesh_count << "\t" <<
+                vertices / mesh_count << "\t" << double(vertices) * sizeof(cfg::Vertex) / 1024 / mesh_count << std::endl;
+        }
+        if (!(coverages[0] == coverages[1])) {
+            std::cout << "FAILED: " << generator.name << " greedy quads cover " << coverages[1].faces << " faces instead of " <<
+                coverages[0].faces << " (or other blocks or shading)" << std::endl;
+            return 1;
+        }
+        if (differing != 0) {
+            std::cout << "FAILED: " << generator.name << " bitmask quads differ from the faces ones in " << differing <<
+                " meshes" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// solidity rows of MesherType::BITMASK with every kernel the cpu supports against the scalar one, time per mesh
+// and the rows have to be bit for bit the same, then the padded copy before meshing
+int benchKernels() {
+    using mesher::Kernel;
+    static constexpr cfg::Coord MESHES{ 8 };
+    static constexpr size_t REPEATS{ 16 };
+    struct Generator {
+        const char * name;
+        void (*generate)(cfg::Block *, const glm::tvec3<cfg::Coord> &);
+    };
+    const Generator generators[]{
+        { "AIR", worldgen::generate<worldgen::WorldGenType::AIR> },
+        { "SINE", worldgen::generate<worldgen::WorldGenType::SINE> },
+        { "STANDARD", worldgen::generate<worldgen::WorldGenType::STANDARD> },
+        { "LAYERS", generateLayers }
+    };
+    struct NamedKernel {
+        const char * name;
+        Kernel kernel;
+    };
+    const NamedKernel kernels[]{ { "scalar", Kernel::SCALAR }, { "sse2", Kernel::SSE2 }, { "avx2", Kernel::AVX2 } };
+    static constexpr size_t ROWS{ mesher::PADDED_SIZE.y * mesher::PADDED_SIZE.z };
+    std::cout << "best kernel: " << kernels[static_cast<size_t>(mesher::bestKernel())].name << std::endl;
+
+    const glm::tvec3<cfg::Coord> chunk_count{ MESHES + 1, 2, MESHES + 1 };
+    std::vector<std::vector<cfg::Block>> chunks(Math::volume(chunk_count), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    std::vector<std::vector<cfg::Block>> padded(MESHES * MESHES, std::vector<cfg::Block>(Math::volume(mesher::PADDED_SIZE)));
+    std::vector<uint64_t> expected(ROWS), rows(ROWS);
+    std::cout << "world\tkernel\trows [us/mesh]\tcopy [us/mesh]" << std::endl;
+    for (const auto & generator : generators) {
+        glm::tvec3<cfg::Coord> i;
+        for (i.z = 0; i.z < chunk_count.z; ++i.z)
+            for (i.y = 0; i.y < chunk_count.y; ++i.y)
+                for (i.x = 0; i.x < chunk_count.x; ++i.x)
+                    generator.generate(chunks[Math::to_index(i, chunk_count)].data(), i + glm::tvec3<cfg::Coord>{ 0, -1, 0 });
+        double copy_time{ 0 };
+        for (size_t r = 0; r < REPEATS; ++r)
+            for (i.z = 0; i.z < MESHES; ++i.z)
+                for (i.x = 0; i.x < MESHES; ++i.x) {
+                    std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> mesh_chunks;
+                    glm::tvec3<cfg::Coord> j;
+                    for (j.z = 0; j.z < cfg::MESH_CHUNK_SIZE.z; ++j.z)
+                        for (j.y = 0; j.y < cfg::MESH_CHUNK_SIZE.y; ++j.y)
+                            for (j.x = 0; j.x < cfg::MESH_CHUNK_SIZE.x; ++j.x)
+                                mesh_chunks[Math::to_index(j, cfg::MESH_CHUNK_SIZE)] =
+                                    chunks[Math::to_index(glm::tvec3<cfg::Coord>{ i.x, 0, i.z } + j, chunk_count)].data();
+                    const auto start = Clock::now();
+                    mesher::copyPadded(padded[i.x + i.z * MESHES].data(), mesh_chunks);
+                    copy_time += seconds(start, Clock::now());
+                }
+        const size_t mesh_count{ MESHES * MESHES * REPEATS };
+        for (const auto & kernel : kernels) {
+            if (!mesher::kernelSupported(kernel.kernel))
+                continue;
+            double time{ 0 };
+            for (size_t r = 0; r < REPEATS; ++r)
+                for (const auto & blocks : padded) {
+                    const auto start = Clock::now();
+                    mesher::solidRows(blocks.data(), rows.data(), kernel.kernel);
+                    time += seconds(start, Clock::now());
+                    if (r != 0)
+                        continue;
+                    mesher::solidRows(blocks.data(), expected.data(), Kernel::SCALAR);
+                    if (rows != expected) {
+                        std::cout << "FAILED: " << generator.name << " " << kernel.name << " rows differ from the scalar ones" << std::endl;
+                        return 1;
+                    }
+                }
+            std::cout << generator.name << "\t" << kernel.name << "\t" << time * 1e6 / mesh_count << "\t" <<
+                copy_time * 1e6 / mesh_count << std::endl;
+        }
+    }
+    return 0;
+}
+
+// edit to visible: blocks of the center chunk set one at a time, the meshes around them invalidated (visible once
+// the workers made them again, after the pass, and they are taken from the queue) or patched right away (visible
+// once the queue is emptied and the patches are applied), latency and vertices to upload per edit
+// the patched meshes have to have the quads of the meshes made again from the same blocks
+int benchPatches() {
+    static constexpr size_t EDITS{ 64 };
+    static constexpr auto POLL = std::chrono::microseconds{ 50 };
+    const glm::tvec3<cfg::Coord> center_chunk{ 0, 0, 0 };
+    const char * modes[]{ "invalidate", "patch" };
+    std::cout << "mode\tedits\tmean [us]\tmedian [us]\tmax [us]\tfirst [us]\tupload [KiB/edit]" << std::endl;
+    for (const char * mode : modes) {
+        const bool patch{ std::string{ mode } == "patch" };
+        if (mkdir(mode, 0777) != 0 || chdir(mode) != 0 || mkdir("world", 0777) != 0) {
+            std::cout << "FAILED: can't create " << mode << std::endl;
+            return 1;
+        }
+        double total_time{ 0 }, max_time{ 0 }, first_time{ 0 };
+        std::vector<double> times;
+        size_t uploaded{ 0 }, total_uploaded{ 0 };
+        {
+            auto voxel_container = std::make_unique<VoxelContainer>();
+            auto & queue = voxel_container->getQueue();
+            Mesh mesh;
+            auto drain = [&] {
+                while (queue.pop(std::move(mesh)))
+                    uploaded += mesh.mesh.size() * sizeof(cfg::Vertex);
+            };
+            // sets the chunks VoxelScene may edit
+            voxel_container->moveCenterChunk(center_chunk);
+            while (!voxel_container->isLoaded(center_chunk)) {
+                while (queue.pop(std::move(mesh)));
+                std::this_thread::sleep_for(POLL);
+            }
+            std::vector<MeshPatch> patches;
+            std::vector<Mesh> queued;
+            // last patched vertices of every mesh
+            std::vector<std::pair<glm::tvec3<cfg::Coord>, std::vector<cfg::Vertex>>> patched;
+            Math::AABB3<cfg::Coord> edited{ glm::tvec3<cfg::Coord>{ cfg::CHUNK_SIZE }, glm::tvec3<cfg::Coord>{ -1 } };
+            uint32_t random{ 12345 };
+            for (size_t e = 0; e < EDITS; ++e) {
+                random = random * 1103515245 + 12345;
+                const glm::tvec3<cfg::Coord> block{
+                    cfg::Coord(random >> 8 & 31), cfg::Coord(random >> 13 & 31), cfg::Coord(random >> 18 & 31)
+                };
+                edited.min = glm::min(edited.min, block);
+                edited.max = glm::max(edited.max, block);
+                PackedChunk * chunk;
+                while ((chunk = voxel_container->getWritableChunk(center_chunk)) == nullptr) {
+                    while (queue.pop(std::move(mesh)));
+                    std::this_thread::sleep_for(POLL);
+                }
+                uploaded = 0;
+                const auto start = Clock::now();
+                const auto index = Math::position_to_index(block, cfg::CHUNK_SIZE);
+                chunk->set(index, chunk->get(index) == cfg::Block{ 0 } ? static_cast<cfg::Block>(e % 7 + 1) : cfg::Block{ 0 });
+                if (patch && voxel_container->patchMeshesWithBlockRange({ block, block }, patches)) {
+                    // as VoxelScene, only the queued meshes of the patched positions
+                    queued.clear();
+                    queue.popIf(queued, [&patches](const Mesh & m) {
+                        return std::any_of(std::begin(patches), std::end(patches), [&m](const MeshPatch & mesh_patch) {
+                            return glm::all(glm::equal(mesh_patch.position, m.position));
+                        });
+                    });
+                    for (const Mesh & queued_mesh : queued)
+                        uploaded += queued_mesh.mesh.size() * sizeof(cfg::Vertex);
+                    for (const MeshPatch & mesh_patch : patches)
+                        uploaded += (mesh_patch.full ? mesh_patch.mesh->size() : mesh_patch.quads.size() * 4) * sizeof(cfg::Vertex);
+                } else {
+                    if (!patch)
+                        voxel_container->invalidateMeshWithBlockRange({ block, block });
+                    while (!voxel_container->isLoaded(center_chunk)) {
+                        drain();
+                        std::this_thread::sleep_for(POLL);
+                    }
+                    drain();
+                }
+                const double time{ seconds(start, Clock::now()) };
+                total_uploaded += uploaded;
+                total_time += time;
+                times.push_back(time);
+                max_time = std::max(max_time, time);
+                if (e == 0)
+                    first_time = time;
+                for (const MeshPatch & mesh_patch : patches) {
+                    auto entry = std::find_if(std::begin(patched), std::end(patched), [&mesh_patch](const auto & entry) {
+                        return glm::all(glm::equal(entry.first, mesh_patch.position));
+                    });
+                    if (entry == std::end(patched))
+                        entry = patched.insert(std::end(patched), { mesh_patch.position, {} });
+                    entry->second = *mesh_patch.mesh;
+                }
+            }
+            if (patch) {
+                // made again by the workers
+                voxel_container->invalidateMeshWithBlockRange(edited);
+                std::vector<std::pair<glm::tvec3<cfg::Coord>, std::vector<cfg::Vertex>>> made;
+                while (!voxel_container->isLoaded(center_chunk)) {
+                    while (queue.pop(std::move(mesh)))
+                        made.emplace_back(mesh.position, std::move(mesh.mesh));
+                    std::this_thread::sleep_for(POLL);
+                }
+                while (queue.pop(std::move(mesh)))
+                    made.emplace_back(mesh.position, std::move(mesh.mesh));
+                for (const auto & entry : patched) {
+                    std::vector<cfg::Vertex> remade;
+                    for (const auto & made_mesh : made)
+                        if (glm::all(glm::equal(made_mesh.first, entry.first)))
+                            remade = made_mesh.second;
+                    if (sortedQuads(remade) != sortedQuads(entry.second)) {
+                        std::cout << "FAILED: patched mesh " << entry.first.x << " " << entry.first.y << " " << entry.first.z <<
+                            " differs from the mesh made again" << std::endl;
+                        return 1;
+                    }
+                }
+            }
+            voxel_container.reset();
+        }
+        if (chdir("..") != 0)
+            return 1;
+        // the first edit of a mesh makes all of it, most edits patch
+        std::sort(std::begin(times), std::end(times));
+        std::cout << mode << "\t" << EDITS << "\t" << total_time * 1e6 / EDITS << "\t" << times[EDITS / 2] * 1e6 << "\t" << max_time * 1e6 << "\t" <<
+            first_time * 1e6 << "\t" << double(total_uploaded) / 1024 / EDITS << std::endl;
+    }
+    return 0;
+}
+
+// an edit at a mesh corner in open air (above the SINE terrain) patches the 8 meshes around it, a block placed and
+// removed again, the scene entries (as VoxelScene keeps them) have to be the ones from before once the meshes are
+// made again, no entries for meshes that stayed empty and no removals of entries that aren't there
+int benchEntries() {
+    static constexpr auto POLL = std::chrono::microseconds{ 50 };
+    const glm::tvec3<cfg::Coord> center_chunk{ 0, 2, 0 };
+    const glm::tvec3<cfg::Coord> corner{ center_chunk * cfg::CHUNK_SIZE + cfg::MESH_OFFSET };
+    size_t before, patched, after;
+    bool removed_missing{ false };
+    {
+        auto voxel_container = std::make_unique<VoxelContainer>();
+        auto & queue = voxel_container->getQueue();
+        std::vector<glm::tvec3<cfg::Coord>> entries;
+        auto upload = [&](const Mesh & mesh) {
+            auto entry = std::find_if(std::begin(entries), std::end(entries), [&mesh](const glm::tvec3<cfg::Coord> & position) {
+                return glm::all(glm::equal(position, mesh.position));
+            });
+            if (mesh.mesh.empty()) {
+                if (entry == std::end(entries))
+                    removed_missing = true;
+                else
+                    entries.erase(entry);
+            } else if (entry == std::end(entries)) {
+                entries.push_back(mesh.position);
+            }
+        };
+        Mesh mesh;
+        auto waitUntilLoaded = [&] {
+            while (!voxel_container->isLoaded(center_chunk)) {
+                while (queue.pop(std::move(mesh)))
+                    upload(mesh);
+                std::this_thread::sleep_for(POLL);
+            }
+            while (queue.pop(std::move(mesh)))
+                upload(mesh);
+        };
+        voxel_container->moveCenterChunk(center_chunk);
+        waitUntilLoaded();
+        before = entries.size();
+
+        std::vector<MeshPatch> patches;
+        std::vector<Mesh> queued;
+        auto edit = [&](cfg::Block block) {
+            PackedChunk * chunk;
+            while ((chunk = voxel_container->getWritableChunk(center_chunk)) == nullptr) {
+                while (queue.pop(std::move(mesh)))
+                    upload(mesh);
+                std::this_thread::sleep_for(POLL);
+            }
+            chunk->set(Math::position_to_index(corner, cfg::CHUNK_SIZE), block);
+            if (!voxel_container->patchMeshesWithBlockRange({ corner, corner }, patches))
+                return false;
+            queued.clear();
+            queue.popIf(queued, [&patches](const Mesh & m) {
+                return std::any_of(std::begin(patches), std::end(patches), [&m](const MeshPatch & mesh_patch) {
+                    return glm::all(glm::equal(mesh_patch.position, m.position));
+                });
+            });
+            for (const Mesh & queued_mesh : queued)
+                upload(queued_mesh);
+            // VoxelScene::applyPatch() makes an entry for every patch
+            for (const MeshPatch & mesh_patch : patches)
+                if (std::none_of(std::begin(entries), std::end(entries), [&mesh_patch](const glm::tvec3<cfg::Coord> & position) {
+                    return glm::all(glm::equal(position, mesh_patch.position));
+                }))
+                    entries.push_back(mesh_patch.position);
+            return true;
+        };
+        if (!edit(cfg::Block{ 1 }) || !edit(cfg::Block{ 0 })) {
+            std::cout << "FAILED: the meshes around " << corner.x << " " << corner.y << " " << corner.z << " can't be patched" << std::endl;
+            return 1;
+        }
+        patched = entries.size();
+        voxel_container->invalidateMeshWithBlockRange({ corner, corner });
+        waitUntilLoaded();
+        after = entries.size();
+        voxel_container.reset();
+    }
+    std::cout << "before\tpatched\tafter" << std::endl;
+    std::cout << before << "\t" << patched << "\t" << after << std::endl;
+    if (after != before || removed_missing) {
+        std::cout << "FAILED: " << after << " scene entries instead of " << before << " once made again" <<
+            (removed_missing ? " (removed entries that aren't there)" : "") << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// continuous flight along x: the center chunk moves on as soon as everything around the previous one is meshed,
+// time from moveCenterChunk() until VoxelContainer::isLoaded(), with passes through the whole loading box and
+// with incremental ones (each in a world of its own, all chunks are generated), then back the same way as far as
+// chunks keep their array slots (chunks and meshes are all still there, what is left is the pass itself)
+int benchFlight() {
+    static constexpr cfg::Coord STEPS{ 16 };
+    struct Mode {
+        const char * name;
+        bool incremental;
+    };
+    const Mode modes[]{ { "full", false }, { "incremental", true } };
+    std::cout << "passes\tfirst [ms]\tstep [ms]\tmax\tback [ms]\tback jobs\tmeshes" << std::endl;
+    for (const auto & mode : modes) {
+        if (mkdir(mode.name, 0777) != 0 || chdir(mode.name) != 0 || mkdir("world", 0777) != 0) {
+            std::cout << "FAILED: can't create " << mode.name << std::endl;
+            return 1;
+        }
+        VoxelContainer::setIncrementalPasses(mode.incremental);
+        double first_time, step_time{ 0 }, max_step_time{ 0 }, back_time;
+        size_t meshes{ 0 }, back_steps{ 0 }, back_jobs, back_work;
+        {
+            const auto start = Clock::now();
+            auto voxel_container = std::make_unique<VoxelContainer>();
+            auto & queue = voxel_container->getQueue();
+            // like the main loop, meshes have to be taken or workers wait for room in the queue
+            auto waitUntilLoaded = [&](const glm::tvec3<cfg::Coord> & center_chunk) {
+                Mesh mesh;
+                while (!voxel_container->isLoaded(center_chunk)) {
+                    while (queue.pop(std::move(mesh)))
+                        ++meshes;
+                    std::this_thread::sleep_for(std::chrono::microseconds{ 100 });
+                }
+            };
+            waitUntilLoaded({ 0, 0, 0 });
+            first_time = seconds(start, Clock::now());
+            for (cfg::Coord step = 1; step <= STEPS; ++step) {
+                const glm::tvec3<cfg::Coord> center_chunk{ step, 0, 0 };
+                const auto step_start = Clock::now();
+                voxel_container->moveCenterChunk(center_chunk);
+                waitUntilLoaded(center_chunk);
+                const double time{ seconds(step_start, Clock::now()) };
+                step_time += time;
+                max_step_time = std::max(max_step_time, time);
+            }
+            // further back, chunks around the new center take the slots of the ones around the last
+            const auto before = voxel_container->getTaskStatistics();
+            const auto back_start = Clock::now();
+            for (cfg::Coord step = STEPS - 1; VoxelIterator::keepsSlots({ step - STEPS, 0, 0 }); --step, ++back_steps) {
+                voxel_container->moveCenterChunk({ step, 0, 0 });
+                waitUntilLoaded({ step, 0, 0 });
+            }
+            back_time = seconds(back_start, Clock::now());
+            const auto after = voxel_container->getTaskStatistics();
+            back_jobs = after.loads - before.loads;
+            back_work = after.generates - before.generates + after.meshes - before.meshes;
+        }
+        if (chdir("..") != 0)
+            return 1;
+        std::cout << mode.name << "\t" << first_time * 1e3 << "\t" << step_time * 1e3 / STEPS << "\t" <<
+            max_step_time * 1e3 << "\t" << back_time * 1e3 / back_steps << "\t" << back_jobs / back_steps << "\t" <<
+            meshes << std::endl;
+        if (back_work > 0) {
+            std::cout << "FAILED: " << back_work << " chunks generated or meshed on the way back" << std::endl;
+            return 1;
+        }
+    }
+    VoxelContainer::setIncrementalPasses(true);
+    return 0;
+}
+
+// center chunk changes every frame (or a block is edited every frame, which invalidates its meshes): flying a
+// chunk per frame, jumping between two chunks and editing while standing still, each in a world of its own
+// meshes have to keep coming while it goes on, and everything has to be loaded soon after it stops
+int benchStress() {
+    static constexpr auto DURATION = std::chrono::seconds{ 3 };
+    static constexpr auto FRAME = std::chrono::milliseconds{ 1 };
+    static constexpr double SETTLE_LIMIT{ 120 };
+    enum class Scenario { FLIGHT, JITTER, EDITS };
+    struct Case {
+        const char * name;
+        Scenario scenario;
+    };
+    const Case cases[]{ { "flight", Scenario::FLIGHT }, { "jitter", Scenario::JITTER }, { "edits", Scenario::EDITS } };
+    std::cout << "case\tframes\tmeshes\tedits\tsettle [ms]" << std::endl;
+    for (const auto & stress_case : cases) {
+        if (mkdir(stress_case.name, 0777) != 0 || chdir(stress_case.name) != 0 || mkdir("world", 0777) != 0) {
+            std::cout << "FAILED: can't create " << stress_case.name << std::endl;
+            return 1;
+        }
+        size_t frames{ 0 }, meshes{ 0 }, edits{ 0 };
+        double settle_time;
+        {
+            auto voxel_container = std::make_unique<VoxelContainer>();
+            auto & queue = voxel_container->getQueue();
+            Mesh mesh;
+            glm::tvec3<cfg::Coord> center_chunk{ 0, 0, 0 };
+            // edits need the meshes around them
+            while (stress_case.scenario == Scenario::EDITS && !voxel_container->isLoaded(center_chunk)) {
+                while (queue.pop(std::move(mesh)))
+                    ++meshes;
+                std::this_thread::sleep_for(FRAME);
+            }
+            const auto start = Clock::now();
+            while (Clock::now() - start < DURATION) {
+                while (queue.pop(std::move(mesh)))
+                    ++meshes;
+                ++frames;
+                switch (stress_case.scenario) {
+                case Scenario::FLIGHT:
+                    center_chunk.x = static_cast<cfg::Coord>(frames);
+                    break;
+                case Scenario::JITTER:
+                    center_chunk.x = frames % 2;
+                    break;
+                case Scenario::EDITS:
+                    // like VoxelScene does it, only chunks whose meshes are all there are writable
+                    if (PackedChunk * const chunk = voxel_container->getWritableChunk(center_chunk)) {
+                        const glm::tvec3<cfg::Coord> block{ cfg::CHUNK_SIZE / 2 };
+                        chunk->set(Math::position_to_index(block, cfg::CHUNK_SIZE), static_cast<cfg::Block>(frames % 7 + 1));
+                        voxel_container->invalidateMeshWithBlockRange({ block, block });
+                        ++edits;
+                    }
+                    break;
+                }
+                voxel_container->moveCenterChunk(center_chunk);
+                std::this_thread::sleep_for(FRAME);
+            }
+            const auto settle_start = Clock::now();
+            while (!voxel_container->isLoaded(center_chunk) && seconds(settle_start, Clock::now()) < SETTLE_LIMIT) {
+                while (queue.pop(std::move(mesh)))
+                    ++meshes;
+                std::this_thread::sleep_for(FRAME);
+            }
+            settle_time = seconds(settle_start, Clock::now());
+            if (!voxel_container->isLoaded(center_chunk)) {
+                std::cout << "FAILED: " << stress_case.name << " not loaded after " << SETTLE_LIMIT << " s" << std::endl;
+                return 1;
+            }
+        }
+        if (chdir("..") != 0)
+            return 1;
+        std::cout << stress_case.name << "\t" << frames << "\t" << meshes << "\t" << edits << "\t" << settle_time * 1e3 << std::endl;
+        if (meshes == 0) {
+            std::cout << "FAILED: no meshes while the center kept changing" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// the worker pool at 2, 4, 8 and 16 threads: time until the loading box around the first center is generated and
+// meshed, then per step of a flight along x (evicting and saving the generated chunks), each in a world of its own
+// speedup against 2 threads levels off at the hardware threads there are
+int benchPool() {
+    static constexpr cfg::Coord STEPS{ 8 };
+    const size_t thread_counts[]{ 2, 4, 8, 16 };
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "threads\tfirst [ms]\tspeedup\tstep [ms]\tgenerates\tmeshes\tsaves\tsteals" << std::endl;
+    double base_time{ 0 };
+    for (const size_t thread_count : thread_counts) {
+        const std::string name{ "threads-" + std::to_string(thread_count) };
+        if (mkdir(name.c_str(), 0777) != 0 || chdir(name.c_str()) != 0 || mkdir("world", 0777) != 0) {
+            std::cout << "FAILED: can't create " << name << std::endl;
+            return 1;
+        }
+        double first_time, step_time;
+        VoxelContainer::TaskStatistics statistics;
+        {
+            const auto start = Clock::now();
+            auto voxel_container = std::make_unique<VoxelContainer>(thread_count);
+            auto & queue = voxel_container->getQueue();
+            auto waitUntilLoaded = [&](const glm::tvec3<cfg::Coord> & center_chunk) {
+                Mesh mesh;
+                while (!voxel_container->isLoaded(center_chunk)) {
+                    while (queue.pop(std::move(mesh)));
+                    std::this_thread::sleep_for(std::chrono::microseconds{ 100 });
+                }
+            };
+            waitUntilLoaded({ 0, 0, 0 });
+            first_time = seconds(start, Clock::now());
+            const auto steps_start = Clock::now();
+            for (cfg::Coord step = 1; step <= STEPS; ++step) {
+                voxel_container->moveCenterChunk({ step * cfg::CHUNK_LOADING_RADIUS.x, 0, 0 });
+                waitUntilLoaded({ step * cfg::CHUNK_LOADING_RADIUS.x, 0, 0 });
+            }
+            step_time = seconds(steps_start, Clock::now()) / STEPS;
+            statistics = voxel_container->getTaskStatistics();
+        }
+        if (chdir("..") != 0)
+            return 1;
+        if (base_time == 0)
+            base_time = first_time;
+        std::cout << statistics.threads << "\t" << first_time * 1e3 << "\t" << base_time / first_time << "\t" <<
+            step_time * 1e3 << "\t" << statistics.generates << "\t" << statistics.meshes << "\t" <<
+            statistics.saves << "\t" << statistics.steals << std::endl;
+        if (statistics.threads != thread_count || statistics.meshes == 0) {
+            std::cout << "FAILED: " << name << " didn't run as many workers or didn't mesh" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// meshes whose chunks are all air or all solid skipped and not, in a SINE world (what VoxelContainer generates):
+// mesh tasks skipped, time until the loading box around the first center is generated and meshed, then until every
+// mesh in it is made again (chunks are all there, what is left is the pass and the meshing), each in a world of its own
+int benchSkips() {
+    struct Mode {
+        const char * name;
+        bool skip;
+    };
+    const Mode modes[]{ { "mesh-all", false }, { "skip", true } };
+    const glm::tvec3<cfg::Coord> center_chunk{ 0, 0, 0 };
+    // blocks whose meshes (around them) are the ones in the loading box
+    const Math::AABB3<cfg::Coord> all_meshes{
+        -cfg::MESH_LOADING_RADIUS * cfg::MESH_SIZE + Math::add(cfg::MESH_OFFSET, 1),
+        cfg::MESH_LOADING_RADIUS * cfg::MESH_SIZE + cfg::MESH_SIZE + Math::add(cfg::MESH_OFFSET, -2)
+    };
+    std::cout << "mode\tmeshes\tskipped\tskipped [%]\tfirst [ms]\tremesh [ms]\tremesh [meshes/s]" << std::endl;
+    double base_time{ 0 };
+    for (const auto & mode : modes) {
+        if (mkdir(mode.name, 0777) != 0 || chdir(mode.name) != 0 || mkdir("world", 0777) != 0) {
+            std::cout << "FAILED: can't create " << mode.name << std::endl;
+            return 1;
+        }
+        VoxelContainer::setMeshSkipping(mode.skip);
+        double first_time, remesh_time;
+        VoxelContainer::TaskStatistics first, statistics;
+        {
+            const auto start = Clock::now();
+            auto voxel_container = std::make_unique<VoxelContainer>();
+            auto & queue = voxel_container->getQueue();
+            voxel_container->moveCenterChunk(center_chunk);
+            auto waitUntilLoaded = [&] {
+                Mesh mesh;
+                while (!voxel_container->isLoaded(center_chunk)) {
+                    while (queue.pop(std::move(mesh)));
+                    std::this_thread::sleep_for(std::chrono::microseconds{ 100 });
+                }
+            };
+            waitUntilLoaded();
+            first_time = seconds(start, Clock::now());
+            first = voxel_container->getTaskStatistics();
+            const auto remesh_start = Clock::now();
+            voxel_container->invalidateMeshWithBlockRange(all_meshes);
+            waitUntilLoaded();
+            remesh_time = seconds(remesh_start, Clock::now());
+            statistics = voxel_container->getTaskStatistics();
+        }
+        if (chdir("..") != 0)
+            return 1;
+        const size_t remeshed{ statistics.meshes - first.meshes };
+        if (base_time == 0)
+            base_time = remesh_time;
+        std::cout << mode.name << "\t" << statistics.meshes << "\t" << statistics.skipped_meshes << "\t" <<
+            100.0 * statistics.skipped_meshes / statistics.meshes << "\t" << first_time * 1e3 << "\t" <<
+            remesh_time * 1e3 << "\t" << remeshed / remesh_time << std::endl;
+        if (remeshed != size_t(cfg::MESH_LOADING_VOLUME) || (mode.skip && statistics.skipped_meshes == 0)) {
+            std::cout << "FAILED: " << mode.name << " made " << remeshed << " meshes again instead of " <<
+                cfg::MESH_LOADING_VOLUME << " (or skipped none)" << std::endl;
+            return 1;
+        }
+    }
+    VoxelContainer::setMeshSkipping(true);
+    return 0;
+}
+
+// compression with and without a dictionary trained from other chunks of the same world generator,
+// then saves and loads a region with it, runs last: the dictionary stays the one used for saving afterwards
+int benchDictionaries() {
+    using codec::CodecType;
+    const codec::Codec codecs[]{
+        { CodecType::ZLIB, 1 }, { CodecType::ZLIB, 9 }, { CodecType::LZ4, 0 }, { CodecType::ZSTD, 3 }, { CodecType::ZSTD, 19 }
+    };
+    struct Generator {
+        const char * name;
+        void (*generate)(cfg::Block *, const glm::tvec3<cfg::Coord> &);
+    };
+    const Generator generators[]{
+        { "SINE", worldgen::generate<worldgen::WorldGenType::SINE> },
+        { "STANDARD", worldgen::generate<worldgen::WorldGenType::STANDARD> },
+        { "LAYERS", generateLayers }
+    };
+
+    const auto positions = surfaceChunks();
+    // chunk data with a byte per block, as Region compresses it for chunks of these generators
+    const double raw_bytes = double(positions.size()) * cfg::CHUNK_VOLUME;
+    std::vector<cfg::RegByte> compressed(cfg::COMPRESS_BUFFER_SIZE_IN_BYTES);
+    std::vector<cfg::RegByte> decompressed(cfg::CHUNK_VOLUME);
+    std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+    codec::Context context;
+    // of the last generator, for the region
+    codec::Dictionary dictionary;
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    std::vector<std::vector<cfg::RegByte>> chunk_data(positions.size());
+    std::vector<cfg::Block> generated(cfg::CHUNK_VOLUME);
+    std::cout << "world\tcodec\tdictionary [B]\tratio\twith\tsave [MB/s]\twith\tload [MB/s]\twith" << std::endl;
+    for (const auto & generator : generators) {
+        // samples from one region, measured on the next one
+        std::vector<std::vector<cfg::RegByte>> samples(cfg::CHUNK_DICTIONARY_SAMPLE_COUNT);
+        std::vector<const cfg::RegByte *> sample_pointers;
+        for (size_t i = 0; i < samples.size(); ++i) {
+            generator.generate(generated.data(), positions[i % positions.size()]);
+            samples[i].assign(std::begin(generated), std::end(generated));
+            sample_pointers.push_back(samples[i].data());
+        }
+        for (size_t i = 0; i < positions.size(); ++i) {
+            generator.generate(chunks[i].data(), positions[i] + glm::tvec3<cfg::Coord>{ cfg::REGION_SIZE.x, 0, 0 });
+            chunk_data[i].assign(std::begin(chunks[i]), std::end(chunks[i]));
+        }
+        dictionary = { 1, codec::trainDictionary(sample_pointers, cfg::CHUNK_DICTIONARY_SIZE) };
+
+        for (const auto & chunk_codec : codecs) {
+            if (!codec::available(chunk_codec.type))
+                continue;
+            double save_times[2], load_times[2];
+            size_t sizes[2];
+            for (size_t with = 0; with < 2; ++with) {
+                const codec::Dictionary * used{ with == 1 && !dictionary.data.empty() ? &dictionary : nullptr };
+                sizes[with] = 0;
+                save_times[with] = 0;
+                load_times[with] = 0;
+                for (const auto & chunk : chunk_data) {
+                    auto start = Clock::now();
+                    const size_t size = context.compress(
+                        chunk_codec, compressed.data(), compressed.size(), chunk.data(), chunk.size(), used
+                    );
+                    save_times[with] += seconds(start, Clock::now());
+                    start = Clock::now();
+                    const bool valid = context.decompress(
+                        chunk_codec.type, decompressed.data(), decompressed.size(), compressed.data(), size, used
+                    );
+                    load_times[with] += seconds(start, Clock::now());
+                    if (size == 0 || !valid || decompressed != chunk) {
+                        std::cout << "FAILED: " << codec::name(chunk_codec.type) << " round trip" << std::endl;
+                        return 1;
+                    }
+                    sizes[with] += size;
+                }
+            }
+            std::cout << generator.name << "\t" << codec::name(chunk_codec.type) << ":" << chunk_codec.level << "\t"
+                << dictionary.data.size() << "\t"
+                << raw_bytes / sizes[0] << "\t" << raw_bytes / sizes[1] << "\t"
+                << raw_bytes / save_times[0] / 1e6 << "\t" << raw_bytes / save_times[1] / 1e6 << "\t"
+                << raw_bytes / load_times[0] / 1e6 << "\t" << raw_bytes / load_times[1] / 1e6 << std::endl;
+        }
+    }
+    if (dictionary.data.empty()) {
+        std::cout << "FAILED: nothing to train a dictionary from" << std::endl;
+        return 1;
+    }
+
+    // through Region, chunks name the dictionary and load with it after reopening
+    const auto & stored = dictionaries::add(dictionary.data);
+    const glm::tvec3<cfg::Coord> region_position{ 0, 1200, 0 };
+    {
+        Region region{ region_position };
+        for (size_t i = 0; i < positions.size(); ++i)
+            region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+    }
+    Region region{ region_position };
+    for (size_t i = 0; i < positions.size(); ++i)
+        if (!loadChunk(region, positions[i], loaded.data()) || loaded != chunks[i]) {
+            std::cout << "FAILED: chunk " << i << " saved with dictionary " << stored.id << " differs" << std::endl;
+            return 1;
+        }
+    std::cout << "region with dictionary " << stored.id << ": " << raw_bytes / region.liveBytes() << " ratio" << std::endl;
+    return 0;
+}
+
+// memory of PackedChunk against flat chunks, random access and decoding the padded blocks of a mesh
+// (eight chunks around a corner, as VoxelContainer does for meshing) compared to copying them from flat chunks
+int benchPacked() {
+    static constexpr size_t LOOKUPS{ 1 << 24 };
+    static constexpr glm::tvec3<cfg::Coord> PADDED_SIZE{ Math::add(cfg::MESH_SIZE, 2) };
+    struct Generator {
+        const char * name;
+        void (*generate)(cfg::Block *, const glm::tvec3<cfg::Coord> &);
+    };
+    const Generator generators[]{
+        { "AIR", worldgen::generate<worldgen::WorldGenType::AIR> },
+        { "SINE", worldgen::generate<worldgen::WorldGenType::SINE> },
+        { "STANDARD", worldgen::generate<worldgen::WorldGenType::STANDARD> },
+        { "LAYERS", generateLayers }
+    };
+
+    // a region layer on the surface and the one below it
+    std::vector<glm::tvec3<cfg::Coord>> positions;
+    for (const auto & position : surfaceChunks()) {
+        positions.push_back(position);
+        positions.push_back(position - glm::tvec3<cfg::Coord>{ 0, 1, 0 });
+    }
+    std::vector<cfg::Block> flat(positions.size() * cfg::CHUNK_VOLUME);
+    std::vector<cfg::Block> unpacked(cfg::CHUNK_VOLUME);
+    std::vector<cfg::Block> padded(Math::volume(PADDED_SIZE));
+    std::vector<PackedChunk> chunks(positions.size());
+    std::vector<cfg::Coord> indices(LOOKUPS);
+    for (auto & index : indices)
+        index = std::rand() % (cfg::CHUNK_VOLUME * static_cast<cfg::Coord>(positions.size()));
+
+    std::cout << "world\tbytes/chunk\t0/1/2/4/8/16 bits\tget [ns]\tflat\tunpack [MB/s]\tmesh blocks [MB/s]\tflat" << std::endl;
+    for (const auto & generator : generators) {
+        for (size_t i = 0; i < positions.size(); ++i)
+            generator.generate(flat.data() + i * cfg::CHUNK_VOLUME, positions[i]);
+        size_t memory{ 0 };
+        std::array<size_t, 17> bits{};
+        for (size_t i = 0; i < positions.size(); ++i) {
+            chunks[i].pack(flat.data() + i * cfg::CHUNK_VOLUME);
+            chunks[i].unpack(unpacked.data());
+            if (!std::equal(std::begin(unpacked), std::end(unpacked), flat.data() + i * cfg::CHUNK_VOLUME)) {
+                std::cout << "FAILED: " << generator.name << " chunk " << i << " differs after packing" << std::endl;
+                return 1;
+            }
+            memory += chunks[i].memoryUsage() + sizeof(PackedChunk);
+            ++bits[chunks[i].bits()];
+        }
+
+        // sums keep the lookups from being optimized away
+        size_t sum{ 0 }, flat_sum{ 0 };
+        auto start = Clock::now();
+        for (const auto index : indices)
+            sum += chunks[index / cfg::CHUNK_VOLUME].get(index % cfg::CHUNK_VOLUME);
+        const double get_time = seconds(start, Clock::now());
+        start = Clock::now();
+        for (const auto index : indices)
+            flat_sum += flat[index];
+        const double flat_get_time = seconds(start, Clock::now());
+        if (sum != flat_sum) {
+            std::cout << "FAILED: " << generator.name << " lookups differ" << std::endl;
+            return 1;
+        }
+
+        start = Clock::now();
+        for (const auto & chunk : chunks)
+            chunk.unpack(unpacked.data());
+        const double unpack_time = seconds(start, Clock::now());
+
+        // meshes at the corners of the chunks of the surface layer, blocks of the layer and the one below
+        const glm::tvec3<cfg::Coord> mesh_chunk_size{ 2, 2, 2 };
+        const glm::tvec3<cfg::Coord> from{ Math::add(cfg::MESH_OFFSET, -1) };
+        const glm::tvec3<cfg::Coord> to{ from + PADDED_SIZE };
+        size_t meshes{ 0 };
+        std::vector<cfg::Block> flat_padded(padded.size());
+        double mesh_time{ 0 }, flat_mesh_time{ 0 };
+        for (size_t m = 0; m + 2 < positions.size() / 2; m += 3) {
+            const size_t lower{ m * 2 + 1 };
+            // chunks of x, x + 1 and below (x + 1 ignores the end of a row, the content doesn't matter here)
+            std::array<size_t, 8> mesh_chunks{ lower, lower + 2, lower - 1, lower + 1, lower, lower + 2, lower - 1, lower + 1 };
+            glm::tvec3<cfg::Coord> i;
+            start = Clock::now();
+            for (i.z = 0; i.z < mesh_chunk_size.z; ++i.z)
+                for (i.y = 0; i.y < mesh_chunk_size.y; ++i.y)
+                    for (i.x = 0; i.x < mesh_chunk_size.x; ++i.x) {
+                        const glm::tvec3<cfg::Coord> chunk_from{ i * cfg::CHUNK_SIZE };
+                        const auto box_from = glm::max(from, chunk_from);
+                        const auto box_to = glm::min(to, chunk_from + cfg::CHUNK_SIZE);
+                        chunks[mesh_chunks[Math::to_index(i, mesh_chunk_size)]].copyBox(
+                            box_from - chunk_from, box_to - box_from, padded.data(), PADDED_SIZE, box_from - from
+                        );
+                    }
+            mesh_time += seconds(start, Clock::now());
+            start = Clock::now();
+            // like mesher::mesh<MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_BETTER_COPY>()
+            size_t p{ 0 };
+            for (i.z = from.z; i.z < to.z; ++i.z)
+                for (i.y = from.y; i.y < to.y; ++i.y)
+                    for (i.x = from.x; i.x < to.x; i.x += cfg::MESH_OFFSET.x + 1) {
+                        const auto chunk = mesh_chunks[Math::to_index(Math::floor_div_unsigned(i, cfg::CHUNK_SIZE), mesh_chunk_size)];
+                        const cfg::Block * row{ flat.data() + chunk * cfg::CHUNK_VOLUME + Math::position_to_index_unsigned(i, cfg::CHUNK_SIZE) };
+                        for (cfg::Coord j = 0; j < cfg::MESH_OFFSET.x + 1; ++j)
+                            flat_padded[p++] = row[j];
+                    }
+            flat_mesh_time += seconds(start, Clock::now());
+            if (padded != flat_padded) {
+                std::cout << "FAILED: " << generator.name << " padded blocks of mesh " << meshes << " differ" << std::endl;
+                return 1;
+            }
+            ++meshes;
+        }
+
+        const double mb{ 1024.0 * 1024.0 };
+        const double mesh_mb{ double(meshes) * padded.size() / mb };
+        std::cout << generator.name << "\t" << memory / positions.size() << "\t";
+        for (const unsigned b : { 0, 1, 2, 4, 8, 16 })
+            std::cout << bits[b] << (b == 16 ? "\t" : "/");
+        std::cout <<
+            get_time * 1e9 / LOOKUPS << "\t" << flat_get_time * 1e9 / LOOKUPS << "\t" <<
+            double(positions.size()) * cfg::CHUNK_VOLUME / mb / unpack_time << "\t" <<
+            mesh_mb / mesh_time << "\t" << mesh_mb / flat_mesh_time << std::endl;
+    }
+    std::cout << "flat: " << cfg::CHUNK_VOLUME * sizeof(cfg::Block) << " bytes/chunk" << std::endl;
+    return 0;
+}
+
+// cost of the block width (cfg::Block, VOXEL_BLOCK_BITS): packed memory, meshing, region save and load and the
+// bytes chunks take in the region, for ids below 256 and with 16 bit blocks for ids with a variant in the high
+// byte (block metadata like an orientation), run it for builds with VOXEL_BLOCK_BITS 8 and 16 to compare
+int benchBlocks() {
+    struct Content {
+        const char * name;
+        // 0 for ids below 256
+        cfg::Coord variants;
+    };
+    const Content contents[]{ { "LAYERS", 0 }, { "VARIANTS", 4 } };
+    const auto positions = surfaceChunks();
+    std::vector<std::vector<cfg::Block>> chunks(positions.size(), std::vector<cfg::Block>(cfg::CHUNK_VOLUME));
+    std::vector<cfg::Block> loaded(cfg::CHUNK_VOLUME);
+    std::vector<cfg::Block> padded(Math::volume(mesher::PADDED_SIZE));
+    std::vector<cfg::Vertex> mesh;
+    PackedChunk packed;
+
+    std::cout << "block: " << sizeof(cfg::Block) << " bytes, vertex: " << sizeof(cfg::Vertex) << " bytes" << std::endl;
+    // times per chunk
+    std::cout << "world\tpacked [B/chunk]\tmesh [us]\tvertices [KiB/mesh]\tsave [us]\tload [us]\tregion [B/chunk]" << std::endl;
+    cfg::Coord region_y{ 1300 };
+    for (const auto & content : contents) {
+        if (content.variants != 0 && sizeof(cfg::Block) == 1)
+            continue;
+        for (size_t i = 0; i < positions.size(); ++i) {
+            generateLayers(chunks[i].data(), positions[i]);
+            for (cfg::Coord j = 0; j < cfg::CHUNK_VOLUME; ++j)
+                if (content.variants != 0 && chunks[i][j] != 0)
+                    chunks[i][j] = static_cast<cfg::Block>(chunks[i][j] | ((j * 7 + j / 33) % content.variants) << 8);
+        }
+
+        // chunks meshed on their own (air around them), as VoxelContainer does it: decode, then mesh
+        size_t memory{ 0 }, vertices{ 0 };
+        double mesh_time{ 0 };
+        for (const auto & chunk : chunks) {
+            packed.pack(chunk.data());
+            memory += packed.memoryUsage() + sizeof(PackedChunk);
+            const auto start = Clock::now();
+            std::fill(std::begin(padded), std::end(padded), cfg::Block{ 0 });
+            packed.copyBox({ 0, 0, 0 }, cfg::CHUNK_SIZE, padded.data(), mesher::PADDED_SIZE, { 1, 1, 1 });
+            mesh.clear();
+            mesher::meshPadded(mesh, padded.data());
+            mesh_time += seconds(start, Clock::now());
+            vertices += mesh.size();
+        }
+
+        const glm::tvec3<cfg::Coord> region_position{ 0, region_y++, 0 };
+        double save_time, load_time;
+        size_t region_bytes;
+        {
+            Region region{ region_position };
+            const auto start = Clock::now();
+            for (size_t i = 0; i < positions.size(); ++i)
+                region.saveChunk(Math::position_to_index(positions[i], cfg::REGION_SIZE), chunks[i].data(), scratch());
+            save_time = seconds(start, Clock::now());
+            region_bytes = region.liveBytes();
+        }
+        {
+            Region region{ region_position };
+            const auto start = Clock::now();
+            for (size_t i = 0; i < positions.size(); ++i)
+                if (!loadChunk(region, positions[i], loaded.data()) || loaded != chunks[i]) {
+                    std::cout << "FAILED: " << content.name << " chunk " << i << " differs after loading" << std::endl;
+                    return 1;
+                }
+            load_time = seconds(start, Clock::now());
+        }
+
+        std::cout << content.name << "\t" << memory / positions.size() << "\t" <<
+            mesh_time * 1e6 / positions.size() << "\t" <<
+            double(vertices) * sizeof(cfg::Vertex) / 1024.0 / positions.size() << "\t" <<
+            save_time * 1e6 / positions.size() << "\t" << load_time * 1e6 / positions.size() << "\t" <<
+            region_bytes / positions.size() << std::endl;
+    }
+    return 0;
+}
+
+struct Benchmark {
+    const char * name;
+    int (*function)();
+};
+
+const Benchmark BENCHMARKS[]{
+    { "slots", benchSlots },
+    { "defragment", benchDefragment },
+    { "codecs", benchCodecs },
+    { "syscalls", benchSyscalls },
+    { "backends", benchBackends },
+    { "chunkio", benchChunkIO },
+    { "writer", benchWriter },
+    { "allocations", benchAllocations },
+    { "recovery", benchRecovery },
+    { "checksums", benchChecksums },
+    { "storage", benchStorage },
+    { "regions", benchRegions },
+    { "packed", benchPacked },
+    { "blocks", benchBlocks },
+    { "greedy", benchGreedy },
+    { "kernels", benchKernels },
+    { "patches", benchPatches },
+    { "entries", benchEntries },
+    { "flight", benchFlight },
+    { "stress", benchStress },
+    { "pool", benchPool },
+    { "skips", benchSkips },
+    { "dictionaries", benchDictionaries },
+};
+
+}
+
+int main(int argc, char * argv[]) {
+    char directory[]{ "/tmp/voxel-bench-XXXXXX" };
+    if (mkdtemp(directory) == nullptr) {
+        std::cout << "Failed to create benchmark directory." << std::endl;
+        return 1;
+    }
+    // region and world files of a full run take up to about 1 GB, removed whatever the result
+    const auto removeDirectory = [&directory] {
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+        if (error)
+            std::cout << "Failed to remove " << directory << ": " << error.message() << std::endl;
+    };
+    if (chdir(directory) != 0 || mkdir("world", 0777) != 0) {
+        std::cout << "Failed to create benchmark directory." << std::endl;
+        removeDirectory();
+        return 1;
+    }
+    std::cout << "Working in " << directory << std::endl;
+
+    int result = 0;
+    for (const auto & benchmark : BENCHMARKS) {
+        if (argc > 1 && std::strcmp(argv[1], benchmark.name) != 0)
+            continue;
+        std::cout << "== " << benchmark.name << std::endl;
+        try {
+            result |= benchmark.function();
+        } catch (const std::exception & e) {
+            std::cout << "FAILED: " << e.what() << std::endl;
+            result = 1;
+        }
+    }
+    removeDirectory();
+    return result;
+}
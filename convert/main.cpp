@@ -159,7 +159,7 @@ void toRegions(const Model & model) {
     static constexpr Vec REGION_SIZE{cfg::REGION_SIZE.x, cfg::REGION_SIZE.y, cfg::REGION_SIZE.z };
     static constexpr size_t CHUNK_VOLUME{ CHUNK_SIZE.x * CHUNK_SIZE.y * CHUNK_SIZE.z };
     static constexpr size_t REGION_VOLUME{ REGION_SIZE.x * REGION_SIZE.y * REGION_SIZE.z };
-    using Block = int8_t;
+    using Block = cfg::Block;
     // good enough I guess
     struct KeyHash { size_t operator () (const Vec & v) const { return v.x ^ v.y ^ v.z; } };
     struct KeyEqual { bool operator () (const Vec & a, const Vec & b) const { return a.x == b.x && a.y == b.y && a.z == b.z; } };
@@ -174,10 +174,12 @@ void toRegions(const Model & model) {
                     auto j = chunk_map.insert({ d.c, {} });
                     std::fill(j.first->second.begin(), j.first->second.end(), 0);
                 }
-                chunk_map[d.c].at(d.bi) = model.v.at(toIndex(i, Vec{ model.x, model.y, model.z }));
+                // model voxels are bytes
+                chunk_map[d.c].at(d.bi) = static_cast<uint8_t>(model.v.at(toIndex(i, Vec{ model.x, model.y, model.z })));
             }
 
     std::unordered_map<Vec, Region, KeyHash, KeyEqual> region_map;
+    Region::Scratch scratch;
     for (const auto & chunk : chunk_map) {
         std::cout << chunk.first.x << ' ';
         std::cout << chunk.first.y << ' ';
@@ -187,7 +189,7 @@ void toRegions(const Model & model) {
             if (region_map.find(region_position) == region_map.end()) {
                 auto j = region_map.emplace(region_position, glm::tvec3<cfg::Coord>{ region_position.x, region_position.y, region_position.z });
             }
-            region_map.find(region_position)->second.saveChunk(chunk_index, (const cfg::Block *)chunk.second.data());
+            region_map.find(region_position)->second.saveChunk(chunk_index, chunk.second.data(), scratch);
     }
 }
 
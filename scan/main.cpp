@@ -0,0 +1,90 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+#include <dirent.h>
+
+#include "../src/Region.hpp"
+
+// checks every region file of a world against its checksums, one file per thread at a time
+// files are only read, regions of older versions have to be opened by the game first (they are converted then)
+// exit code 1 if anything is broken
+
+namespace {
+    // large reads so a scan runs at disk bandwidth
+    constexpr size_t READ_SIZE{ 1024 * 1024 * 4 };
+
+    std::vector<std::string> regionFiles(const std::string & directory) {
+        std::vector<std::string> files;
+        DIR * dir = opendir(directory.c_str());
+        if (dir == nullptr)
+            return files;
+        while (const dirent * entry = readdir(dir)) {
+            const std::string name{ entry->d_name };
+            // skip ".", "..", files left by an interrupted defragment and world files (Region::Storage::WORLD_FILES)
+            if (name.front() == '.' || (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) ||
+                name.find('|') == std::string::npos)
+                continue;
+            files.push_back(directory + "/" + name);
+        }
+        closedir(dir);
+        std::sort(std::begin(files), std::end(files));
+        return files;
+    }
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 3) {
+        std::cout << "Usage: [program] [world_directory (world)] [thread_count (all cores)]" << std::endl;
+        return 1;
+    }
+    const std::string directory{ argc > 1 ? argv[1] : "world" };
+    const size_t thread_count{ std::max(size_t{ 1 }, argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency()) };
+
+    const auto files = regionFiles(directory);
+    std::atomic<size_t> next_file{ 0 };
+    std::mutex mutex;
+    size_t chunks{ 0 }, uniform_chunks{ 0 }, corrupt_chunks{ 0 }, invalid_files{ 0 }, bytes{ 0 };
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&]() {
+            std::unique_ptr<cfg::RegByte[]> buffer{ std::make_unique<cfg::RegByte[]>(READ_SIZE) };
+            for (size_t i = next_file.fetch_add(1); i < files.size(); i = next_file.fetch_add(1)) {
+                const auto result = Region::scan(files[i].c_str(), buffer.get(), READ_SIZE);
+                std::lock_guard<std::mutex> lock{ mutex };
+                bytes += result.bytes;
+                if (!result.valid_header) {
+                    ++invalid_files;
+                    std::cout << files[i] << ": no valid header (broken or older version)" << std::endl;
+                    continue;
+                }
+                chunks += result.chunks;
+                uniform_chunks += result.uniform_chunks;
+                corrupt_chunks += result.corrupt_chunks.size();
+                for (const auto chunk_index : result.corrupt_chunks)
+                    std::cout << files[i] << ": chunk " << chunk_index << " is corrupt" << std::endl;
+            }
+        });
+    }
+    for (auto & thread : threads)
+        thread.join();
+    const double time = std::chrono::duration_cast<std::chrono::duration<double>>(
+        std::chrono::high_resolution_clock::now() - start
+    ).count();
+
+    std::cout << "regions:        " << files.size() << " (" << invalid_files << " without valid header)" << std::endl;
+    std::cout << "chunks:         " << chunks << " (+ " << uniform_chunks << " uniform)" << std::endl;
+    std::cout << "corrupt chunks: " << corrupt_chunks << std::endl;
+    std::cout << "read [MB]:      " << bytes / 1e6 << std::endl;
+    std::cout << "time [s]:       " << time << std::endl;
+    std::cout << "speed [MB/s]:   " << bytes / 1e6 / time << std::endl;
+    return corrupt_chunks == 0 && invalid_files == 0 ? 0 : 1;
+}
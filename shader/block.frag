@@ -33,9 +33,11 @@ float sinLerp(float a, float b, float c, float d, float s, float t) {
 
 void main()
 {
+    // per block of greedy quads (corners of the blocks of a quad have the same occlusion)
+    vec2 block_coord = fract(texture_coord);
     float interpolated_shade = smoothLerp(
         ao_colors.x, ao_colors.y, ao_colors.z, ao_colors.w,
-        texture_coord.s, texture_coord.t
+        block_coord.s, block_coord.t
     );
 
     outColor = vec4(vec3(color * interpolated_shade), 1.0f) * texture(inTexture, texture_coord);
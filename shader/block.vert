@@ -7,17 +7,31 @@ layout(location = 2) in uvec4 AO;
 uniform mat4 VP_matrix;
 uniform vec3 offset;
 
+// texture axes (s, t) of the sides, see mesher::GREEDY_SIDE_AXES
+const ivec2 SIDE_AXES[6] = ivec2[6](ivec2(2, 1), ivec2(1, 2), ivec2(0, 2), ivec2(2, 0), ivec2(1, 0), ivec2(0, 1));
+
 out float color;
 out vec2 texture_coord;
 flat out vec4 ao_colors;
 
 void main()
 {
-    gl_Position = VP_matrix * vec4(vec3(Position) + offset, 1.0f);
-    color = float(Color) / 255.0f;
+    // greedy quads keep their side in the bits above the position (see mesher::meshPaddedGreedy())
+    uvec3 position = Position & 63u;
+    uint side = (Position.x >> 6) | ((Position.y >> 6) << 2);
+    gl_Position = VP_matrix * vec4(vec3(position) + offset, 1.0f);
+    // ids above 255 repeat the colors
+    color = float(Color % 256u) / 255.0f;
 
     ao_colors = AO / 255.0f;
 
-    uvec2 i_tex_rel = uvec2((gl_VertexID & 1) ^ ((gl_VertexID >> 1) & 1), (gl_VertexID >> 1) & 1);
-    texture_coord = vec2(i_tex_rel);
+    if (side == 0u) {
+        // one quad per face
+        uvec2 i_tex_rel = uvec2((gl_VertexID & 1) ^ ((gl_VertexID >> 1) & 1), (gl_VertexID >> 1) & 1);
+        texture_coord = vec2(i_tex_rel);
+    } else {
+        // a block per texture repeat
+        ivec2 axes = SIDE_AXES[side - 1u];
+        texture_coord = vec2(position[axes.x], position[axes.y]);
+    }
 }
@@ -0,0 +1,426 @@
+#include "ChunkIO.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define VOXEL_HAVE_URING
+#endif
+
+#include "Print.hpp"
+
+namespace {
+    std::atomic<ChunkIO::Backend> default_backend{ ChunkIO::Backend::URING };
+
+    void fillUniform(cfg::Block * chunk, cfg::Block block) {
+        // nothing was read or decompressed
+        std::fill(chunk, chunk + cfg::CHUNK_VOLUME, block);
+    }
+
+    cfg::RegUint chunkIndex(const glm::tvec3<cfg::Coord> & chunk_position) {
+        return Math::position_to_index(chunk_position, cfg::REGION_SIZE);
+    }
+}
+
+void ChunkIO::setDefaultBackend(Backend backend) { default_backend.store(backend); }
+ChunkIO::Backend ChunkIO::getDefaultBackend() { return default_backend.load(); }
+
+#ifdef VOXEL_HAVE_URING
+// minimal io_uring (without liburing), only used by the thread owning the queue
+struct ChunkIO::Ring {
+    int fd{ -1 };
+    void * sq_mapping{ MAP_FAILED };
+    size_t sq_mapping_size{ 0 };
+    void * cq_mapping{ MAP_FAILED };
+    size_t cq_mapping_size{ 0 };
+    io_uring_sqe * sqes{ static_cast<io_uring_sqe *>(MAP_FAILED) };
+    size_t sqes_size{ 0 };
+    unsigned * sq_tail;
+    unsigned sq_mask;
+    unsigned * sq_array;
+    unsigned * cq_head;
+    unsigned * cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe * cqes;
+
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0)
+            return false;
+
+        sq_mapping_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_mapping_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mapping = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mapping)
+            sq_mapping_size = cq_mapping_size = std::max(sq_mapping_size, cq_mapping_size);
+        sq_mapping = mmap(nullptr, sq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_mapping == MAP_FAILED)
+            return false;
+        if (single_mapping) {
+            cq_mapping = sq_mapping;
+        } else {
+            cq_mapping = mmap(nullptr, cq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq_mapping == MAP_FAILED)
+                return false;
+        }
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED)
+            return false;
+
+        char * const sq{ static_cast<char *>(sq_mapping) };
+        char * const cq{ static_cast<char *>(cq_mapping) };
+        sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    ~Ring() {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqes_size);
+        if (cq_mapping != MAP_FAILED && cq_mapping != sq_mapping)
+            munmap(cq_mapping, cq_mapping_size);
+        if (sq_mapping != MAP_FAILED)
+            munmap(sq_mapping, sq_mapping_size);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    // the ring never holds more entries than there are UringSlots, so it can't overflow
+    void pushRead(int file, void * buffer, cfg::RegUint size, cfg::RegUint position, size_t user_data) {
+        const unsigned tail{ *sq_tail };
+        const unsigned index{ tail & sq_mask };
+        io_uring_sqe & sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = file;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = size;
+        sqe.off = position;
+        sqe.user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // returns number of submitted entries
+    int enter(unsigned to_submit, unsigned min_complete) {
+        const unsigned flags{ min_complete > 0 ? unsigned{ IORING_ENTER_GETEVENTS } : 0u };
+        int result;
+        do {
+            result = static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+        } while (result < 0 && errno == EINTR);
+        if (result < 0)
+            throw std::runtime_error("io_uring_enter failed.");
+        return result;
+    }
+
+    bool pop(size_t & user_data, int & result) {
+        const unsigned head{ *cq_head };
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+            return false;
+        const io_uring_cqe & cqe = cqes[head & cq_mask];
+        user_data = static_cast<size_t>(cqe.user_data);
+        result = cqe.res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+#else
+struct ChunkIO::Ring {};
+#endif
+
+ChunkIO::ChunkIO(size_t queue_count) {
+    m_backend = default_backend.load();
+    m_running = true;
+    m_requests_head = 0;
+    m_requests.reserve(queue_count * cfg::CHUNK_IO_RESERVED_REQUESTS);
+    for (size_t i = 0; i < queue_count; ++i) {
+        m_queues.push_back(std::make_unique<Queue>());
+        m_queues.back()->batch.reserve(cfg::CHUNK_IO_BATCH_SIZE);
+        m_queues.back()->completed.reserve(cfg::CHUNK_IO_RESERVED_REQUESTS);
+    }
+
+#ifdef VOXEL_HAVE_URING
+    if (m_backend == Backend::URING) {
+        for (auto & queue : m_queues) {
+            queue->ring = std::make_unique<Ring>();
+            if (!queue->ring->init(cfg::CHUNK_IO_QUEUE_DEPTH)) {
+                Print("io_uring not available, using I/O threads.");
+                m_backend = Backend::THREADS;
+                break;
+            }
+            queue->uring_slots.resize(cfg::CHUNK_IO_QUEUE_DEPTH);
+            for (size_t slot = 0; slot < cfg::CHUNK_IO_QUEUE_DEPTH; ++slot) {
+                queue->uring_slots[slot].buffer = std::make_unique<cfg::RegByte[]>(cfg::COMPRESS_BUFFER_SIZE_IN_BYTES);
+                queue->free_uring_slots.push_back(slot);
+            }
+        }
+    }
+#else
+    m_backend = Backend::THREADS;
+#endif
+    if (m_backend == Backend::THREADS) {
+        for (auto & queue : m_queues) {
+            queue->ring.reset();
+            queue->uring_slots.clear();
+            queue->free_uring_slots.clear();
+        }
+    }
+
+    for (size_t i = 0; i < cfg::CHUNK_IO_THREAD_COUNT; ++i)
+        m_threads.emplace_back(&ChunkIO::thread, this);
+}
+
+ChunkIO::~ChunkIO() {
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_running = false;
+    }
+    m_condition.notify_all();
+    std::for_each(std::begin(m_threads), std::end(m_threads), [](std::thread & thread) {
+        thread.join();
+    });
+}
+
+void ChunkIO::submit(size_t queue_index, const Request & request) {
+    Queue & queue = *m_queues[queue_index];
+    m_stats.submitted.fetch_add(1);
+    if (m_backend == Backend::URING && submitRead(queue, request))
+        return;
+    queue.batch.push_back(request);
+    if (queue.batch.size() >= cfg::CHUNK_IO_BATCH_SIZE)
+        flush(queue_index);
+}
+
+void ChunkIO::flush(size_t queue_index) {
+    Queue & queue = *m_queues[queue_index];
+    submitReads(queue);
+    if (queue.batch.empty())
+        return;
+    queue.queued += queue.batch.size();
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        for (const auto & request : queue.batch)
+            m_requests.emplace_back(queue_index, request);
+    }
+    if (queue.batch.size() == 1)
+        m_condition.notify_one();
+    else
+        m_condition.notify_all();
+    queue.batch.clear();
+    m_stats.batches.fetch_add(1);
+}
+
+bool ChunkIO::poll(size_t queue_index, Request & completed) {
+    Queue & queue = *m_queues[queue_index];
+    bool found{ false };
+    if (queue.queued > 0) {
+        std::lock_guard<std::mutex> lock{ queue.mutex };
+        if (!queue.completed.empty()) {
+            completed = queue.completed.back();
+            queue.completed.pop_back();
+            --queue.queued;
+            found = true;
+        }
+    }
+    if (!found)
+        found = reapRead(queue, completed, false);
+    if (found && completed.error)
+        std::rethrow_exception(completed.error);
+    return found;
+}
+
+bool ChunkIO::wait(size_t queue_index, Request & completed) {
+    Queue & queue = *m_queues[queue_index];
+    flush(queue_index);
+    bool waited{ false };
+    while (!poll(queue_index, completed)) {
+        const size_t reads_in_flight{ queue.uring_slots.size() - queue.free_uring_slots.size() };
+        if (queue.queued == 0 && reads_in_flight == 0)
+            return false;
+        if (!waited) {
+            m_stats.waits.fetch_add(1);
+            waited = true;
+        }
+        if (queue.queued == 0) {
+            if (reapRead(queue, completed, true)) {
+                if (completed.error)
+                    std::rethrow_exception(completed.error);
+                return true;
+            }
+        } else {
+            std::unique_lock<std::mutex> lock{ queue.mutex };
+            const auto done = [&queue] { return !queue.completed.empty(); };
+            // the ring can't wake us up, check it every now and then
+            if (reads_in_flight == 0)
+                queue.condition.wait(lock, done);
+            else
+                queue.condition.wait_for(lock, std::chrono::milliseconds{ 1 }, done);
+        }
+    }
+    return true;
+}
+
+size_t ChunkIO::inFlight(size_t queue_index) const {
+    const Queue & queue = *m_queues[queue_index];
+    return queue.batch.size() + queue.queued + queue.uring_slots.size() - queue.free_uring_slots.size();
+}
+
+void ChunkIO::thread() {
+    std::vector<std::pair<size_t, Request>> work;
+    work.reserve(m_queues.size() * cfg::CHUNK_IO_RESERVED_REQUESTS);
+    Region::Scratch scratch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            m_condition.wait(lock, [this] { return !m_running || m_requests_head < m_requests.size(); });
+            // only stop once everything is done
+            if (m_requests_head == m_requests.size())
+                return;
+            // take a share of the requests, leave the rest to the other threads
+            const size_t available{ m_requests.size() - m_requests_head };
+            const size_t count{ std::max(size_t{ 1 }, available / m_threads.size()) };
+            work.insert(std::end(work), std::begin(m_requests) + m_requests_head, std::begin(m_requests) + m_requests_head + count);
+            m_requests_head += count;
+            if (m_requests_head == m_requests.size()) {
+                m_requests.clear();
+                m_requests_head = 0;
+            } else if (m_requests_head > m_requests.size() / 2) {
+                // never drained completely, don't let it grow forever
+                m_requests.erase(std::begin(m_requests), std::begin(m_requests) + m_requests_head);
+                m_requests_head = 0;
+            }
+        }
+        for (auto & entry : work) {
+            execute(entry.second, scratch);
+            m_stats.thread_requests.fetch_add(1);
+            complete(*m_queues[entry.first], entry.second);
+        }
+        work.clear();
+    }
+}
+
+void ChunkIO::execute(Request & request, Region::Scratch & scratch) {
+    try {
+        cfg::Block uniform_block;
+        switch (request.region->loadChunk(chunkIndex(request.chunk_position), request.chunk, uniform_block, scratch)) {
+        case Region::LoadResult::MISSING:
+        case Region::LoadResult::CORRUPT:
+            request.loaded = false;
+            break;
+        case Region::LoadResult::UNIFORM:
+            fillUniform(request.chunk, uniform_block);
+            request.loaded = true;
+            break;
+        case Region::LoadResult::LOADED:
+            request.loaded = true;
+            break;
+        }
+    } catch (...) {
+        request.error = std::current_exception();
+    }
+}
+
+void ChunkIO::complete(Queue & queue, const Request & request) {
+    {
+        std::lock_guard<std::mutex> lock{ queue.mutex };
+        queue.completed.push_back(request);
+    }
+    queue.condition.notify_one();
+}
+
+#ifdef VOXEL_HAVE_URING
+bool ChunkIO::submitRead(Queue & queue, const Request & request) {
+    if (queue.free_uring_slots.empty()) {
+        // make room with reads that are already done
+        submitReads(queue);
+        Request done;
+        if (!reapRead(queue, done, false))
+            return false;
+        ++queue.queued;
+        complete(queue, done);
+    }
+    Request result{ request };
+    cfg::Block uniform_block;
+    Region::PendingLoad pending;
+    switch (request.region->beginLoad(chunkIndex(request.chunk_position), uniform_block, pending)) {
+    case Region::LoadResult::MISSING:
+    case Region::LoadResult::CORRUPT: // not returned by beginLoad()
+        result.loaded = false;
+        ++queue.queued;
+        complete(queue, result);
+        break;
+    case Region::LoadResult::UNIFORM:
+        fillUniform(result.chunk, uniform_block);
+        result.loaded = true;
+        ++queue.queued;
+        complete(queue, result);
+        break;
+    case Region::LoadResult::LOADED: {
+        const size_t slot_index{ queue.free_uring_slots.back() };
+        queue.free_uring_slots.pop_back();
+        UringSlot & slot = queue.uring_slots[slot_index];
+        slot.request = result;
+        slot.pending = pending;
+        queue.ring->pushRead(pending.fd, slot.buffer.get(), pending.size, pending.position, slot_index);
+        if (++queue.unsubmitted_reads >= cfg::CHUNK_IO_BATCH_SIZE)
+            submitReads(queue);
+        break;
+    }
+    }
+    return true;
+}
+
+void ChunkIO::submitReads(Queue & queue) {
+    while (queue.unsubmitted_reads > 0) {
+        queue.unsubmitted_reads -= queue.ring->enter(queue.unsubmitted_reads, 0);
+        m_stats.batches.fetch_add(1);
+    }
+}
+
+bool ChunkIO::reapRead(Queue & queue, Request & completed, bool block) {
+    if (queue.free_uring_slots.size() == queue.uring_slots.size())
+        return false;
+    size_t slot_index;
+    int result;
+    while (!queue.ring->pop(slot_index, result)) {
+        if (!block)
+            return false;
+        queue.ring->enter(0, 1);
+    }
+
+    UringSlot & slot = queue.uring_slots[slot_index];
+    completed = slot.request;
+    try {
+        // short or failed read (old kernel without IORING_OP_READ, ...), try again the old way
+        if (result != static_cast<int>(slot.pending.size))
+            if (pread(slot.pending.fd, slot.buffer.get(), slot.pending.size, slot.pending.position) != static_cast<ssize_t>(slot.pending.size))
+                Print("Failed to read chunk data.");
+        completed.loaded = completed.region->finishLoad(slot.pending, slot.buffer.get(), completed.chunk, queue.scratch) == Region::LoadResult::LOADED;
+    } catch (...) {
+        completed.error = std::current_exception();
+    }
+    queue.free_uring_slots.push_back(slot_index);
+    m_stats.uring_reads.fetch_add(1);
+    return true;
+}
+#else
+bool ChunkIO::submitRead(Queue &, const Request &) { return false; }
+void ChunkIO::submitReads(Queue &) {}
+bool ChunkIO::reapRead(Queue &, Request &, bool) { return false; }
+#endif
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <glm/vec3.hpp>
+#include "cfg.hpp"
+#include "Region.hpp"
+
+// asynchronous chunk loads, submitted in batches (saves go through ChunkWriter)
+// URING: chunk data is read with io_uring (cfg::CHUNK_IO_QUEUE_DEPTH reads in flight per queue)
+//        and decompressed by the thread polling the queue, overflowing loads go to the I/O threads
+// THREADS: everything runs on cfg::CHUNK_IO_THREAD_COUNT I/O threads
+class ChunkIO {
+public:
+    enum class Backend { URING, THREADS };
+    // backend used by ChunkIOs created after this call, URING falls back to THREADS if the kernel lacks io_uring
+    static void setDefaultBackend(Backend backend);
+    static Backend getDefaultBackend();
+
+    struct Request {
+        // must stay alive until the request is completed
+        Region * region;
+        glm::tvec3<cfg::Coord> chunk_position;
+        // destination, must not be touched until the request is completed
+        cfg::Block * chunk;
+        // false if chunk was not found in region (chunk is not touched) or is corrupt (chunk content is undefined)
+        bool loaded;
+        // rethrown by poll() and wait()
+        std::exception_ptr error;
+    };
+
+    struct Statistics {
+        std::atomic<size_t> submitted{ 0 };
+        std::atomic<size_t> batches{ 0 };
+        // loads whose chunk data was read with io_uring
+        std::atomic<size_t> uring_reads{ 0 };
+        // requests handled by the I/O threads
+        std::atomic<size_t> thread_requests{ 0 };
+        // wait() calls that had to block
+        std::atomic<size_t> waits{ 0 };
+    };
+
+    // a queue is used by a single thread (one per worker), completions are returned to the queue of submission
+    ChunkIO(size_t queue_count);
+    ChunkIO(const ChunkIO &) = delete;
+    ChunkIO & operator = (const ChunkIO &) = delete;
+    // all requests must be completed before
+    ~ChunkIO();
+
+    Backend backend() const { return m_backend; }
+    const Statistics & statistics() const { return m_stats; }
+
+    // requests are collected until flush() or cfg::CHUNK_IO_BATCH_SIZE of them are collected
+    void submit(size_t queue, const Request & request);
+    void flush(size_t queue);
+    // returns false if nothing is completed
+    bool poll(size_t queue, Request & completed);
+    // flushes and blocks until a request is completed, returns false if nothing is in flight
+    bool wait(size_t queue, Request & completed);
+    // submitted and not yet returned by poll() or wait()
+    size_t inFlight(size_t queue) const;
+
+private:
+    struct Ring;
+    struct UringSlot {
+        Request request;
+        Region::PendingLoad pending;
+        std::unique_ptr<cfg::RegByte[]> buffer;
+    };
+    struct Queue {
+        // only touched by the thread owning the queue
+        std::vector<Request> batch;
+        // requests that will show up in completed
+        size_t queued{ 0 };
+        std::unique_ptr<Ring> ring;
+        std::vector<UringSlot> uring_slots;
+        std::vector<size_t> free_uring_slots;
+        size_t unsubmitted_reads{ 0 };
+        // for decompressing io_uring reads
+        Region::Scratch scratch;
+        // filled by the I/O threads
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::vector<Request> completed;
+    };
+
+    Backend m_backend;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    // requests before m_requests_head are taken, vectors keep their memory so steady state doesn't allocate
+    std::vector<std::pair<size_t, Request>> m_requests;
+    size_t m_requests_head;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running;
+    Statistics m_stats;
+
+    void thread();
+    static void execute(Request & request, Region::Scratch & scratch);
+    static void complete(Queue & queue, const Request & request);
+    // returns false if the request has to go to the I/O threads instead
+    bool submitRead(Queue & queue, const Request & request);
+    void submitReads(Queue & queue);
+    // completes one read of the ring, returns false if none is done (and block is false)
+    bool reapRead(Queue & queue, Request & completed, bool block);
+
+};
@@ -0,0 +1,175 @@
+#include "ChunkWriter.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+ChunkWriter::ChunkWriter(RegionContainer & region_container, bool writer_thread) :
+    m_region_container{ region_container },
+    m_entries(cfg::CHUNK_WRITER_BUFFER_COUNT, Entry{ { 0, 0, 0 }, nullptr, NONE, NONE, false }),
+    m_queue(cfg::CHUNK_WRITER_BUFFER_COUNT),
+    m_buffers(cfg::CHUNK_WRITER_BUFFER_COUNT * cfg::CHUNK_VOLUME)
+{
+    m_entry_count = 0;
+    m_queue_head = 0;
+    m_queue_size = 0;
+    for (size_t i = 0; i < cfg::CHUNK_WRITER_BUFFER_COUNT; ++i)
+        m_free_buffers.push_back(i);
+    m_running = true;
+    if (writer_thread)
+        m_thread = std::thread{ &ChunkWriter::writer, this };
+}
+
+ChunkWriter::~ChunkWriter() {
+    if (!m_thread.joinable()) {
+        drain();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_running = false;
+    }
+    m_condition.notify_one();
+    // writer only stops once the queue is empty
+    m_thread.join();
+}
+
+void ChunkWriter::save(const glm::tvec3<cfg::Coord> & chunk_position, const cfg::Block * chunk) {
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    m_stats.saves.fetch_add(1);
+    size_t index;
+    while (true) {
+        index = find(chunk_position);
+        if (index != NONE) {
+            // replace a copy that is not being written yet
+            Entry & entry = m_entries[index];
+            size_t * replaced{ nullptr };
+            if (!entry.writing)
+                replaced = &entry.buffer;
+            else if (entry.next_buffer != NONE)
+                replaced = &entry.next_buffer;
+            if (replaced != nullptr) {
+                std::copy(chunk, chunk + cfg::CHUNK_VOLUME, buffer(*replaced));
+                m_stats.coalesced.fetch_add(1);
+                return;
+            }
+        }
+        if (!m_free_buffers.empty())
+            break;
+        // the entry might be gone after waiting, so look again
+        m_stats.stalls.fetch_add(1);
+        if (m_thread.joinable() || !writeNext(lock, threadScratch()))
+            m_written_condition.wait(lock);
+    }
+
+    const size_t new_buffer{ m_free_buffers.back() };
+    m_free_buffers.pop_back();
+    std::copy(chunk, chunk + cfg::CHUNK_VOLUME, buffer(new_buffer));
+    if (index != NONE) {
+        // being written, writer queues it again when done
+        m_entries[index].next_buffer = new_buffer;
+        return;
+    }
+    // a free buffer means there is a free entry
+    const auto free_entry = std::find_if(std::begin(m_entries), std::end(m_entries), [](const Entry & entry) {
+        return entry.region == nullptr;
+    });
+    Region * region = &m_region_container.get(Math::floor_div(chunk_position, cfg::REGION_SIZE));
+    *free_entry = Entry{ chunk_position, region, new_buffer, NONE, false };
+    ++m_entry_count;
+    enqueue(free_entry - std::begin(m_entries));
+    lock.unlock();
+    m_condition.notify_one();
+}
+
+bool ChunkWriter::load(const glm::tvec3<cfg::Coord> & chunk_position, cfg::Block * chunk) {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    const size_t index{ find(chunk_position) };
+    if (index == NONE)
+        return false;
+    const Entry & entry = m_entries[index];
+    const size_t latest{ entry.next_buffer != NONE ? entry.next_buffer : entry.buffer };
+    std::copy(buffer(latest), buffer(latest) + cfg::CHUNK_VOLUME, chunk);
+    m_stats.loads.fetch_add(1);
+    return true;
+}
+
+bool ChunkWriter::write(Region::Scratch & scratch) {
+    assert(!m_thread.joinable());
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    bool written{ false };
+    while (writeNext(lock, scratch))
+        written = true;
+    return written;
+}
+
+void ChunkWriter::drain() {
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    if (!m_thread.joinable())
+        while (writeNext(lock, threadScratch()));
+    // the rest is being written by other threads
+    m_written_condition.wait(lock, [this] { return m_entry_count == 0; });
+}
+
+size_t ChunkWriter::find(const glm::tvec3<cfg::Coord> & chunk_position) const {
+    // small enough for a linear search
+    if (m_entry_count == 0)
+        return NONE;
+    for (size_t i = 0; i < m_entries.size(); ++i)
+        if (m_entries[i].region != nullptr && glm::all(glm::equal(m_entries[i].chunk_position, chunk_position)))
+            return i;
+    return NONE;
+}
+
+void ChunkWriter::enqueue(size_t entry) {
+    assert(m_queue_size < m_queue.size());
+    m_queue[(m_queue_head + m_queue_size) % m_queue.size()] = entry;
+    ++m_queue_size;
+}
+
+void ChunkWriter::writer() {
+    Region::Scratch scratch;
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    while (true) {
+        m_condition.wait(lock, [this] { return !m_running || m_queue_size > 0; });
+        if (!writeNext(lock, scratch))
+            return;
+    }
+}
+
+bool ChunkWriter::writeNext(std::unique_lock<std::mutex> & lock, Region::Scratch & scratch) {
+    if (m_queue_size == 0)
+        return false;
+    const size_t index{ m_queue[m_queue_head] };
+    m_queue_head = (m_queue_head + 1) % m_queue.size();
+    --m_queue_size;
+    Entry & entry = m_entries[index];
+    entry.writing = true;
+    // buffer is left alone by save() and load() only reads it
+    lock.unlock();
+    entry.region->saveChunk(Math::position_to_index(entry.chunk_position, cfg::REGION_SIZE), buffer(entry.buffer), scratch);
+    m_stats.written.fetch_add(1);
+    lock.lock();
+
+    m_free_buffers.push_back(entry.buffer);
+    if (entry.next_buffer != NONE) {
+        entry.buffer = entry.next_buffer;
+        entry.next_buffer = NONE;
+        entry.writing = false;
+        enqueue(index);
+    } else {
+        const auto region_position = Math::floor_div(entry.chunk_position, cfg::REGION_SIZE);
+        entry.region = nullptr;
+        --m_entry_count;
+        // don't hold m_mutex while locking RegionContainer, save() locks them the other way around
+        lock.unlock();
+        m_region_container.release(region_position);
+        lock.lock();
+    }
+    m_written_condition.notify_all();
+    return true;
+}
+
+Region::Scratch & ChunkWriter::threadScratch() {
+    static thread_local Region::Scratch scratch;
+    return scratch;
+}
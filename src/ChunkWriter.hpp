@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <glm/vec3.hpp>
+#include "cfg.hpp"
+#include "RegionContainer.hpp"
+
+// write-behind queue for evicted dirty chunks
+// save() copies the chunk into one of cfg::CHUNK_WRITER_BUFFER_COUNT pooled buffers (waits if all are in use)
+// and the writer thread compresses and saves it to its region
+// without a writer thread, whoever owns the ChunkWriter calls write() for every save() instead (from any thread)
+// saving a chunk that is still queued only replaces its copy
+// nothing is allocated after construction
+class ChunkWriter {
+public:
+    ChunkWriter(RegionContainer & region_container, bool writer_thread = true);
+    ChunkWriter(const ChunkWriter &) = delete;
+    ChunkWriter & operator = (const ChunkWriter &) = delete;
+    // saves everything still queued
+    ~ChunkWriter();
+
+    // without a writer thread, a save() waiting for a free buffer writes queued chunks itself
+    void save(const glm::tvec3<cfg::Coord> & chunk_position, const cfg::Block * chunk);
+    // compresses and saves queued chunks until none is left, returns false if there was none
+    // (only without a writer thread)
+    bool write(Region::Scratch & scratch);
+    // copies the queued version of a chunk, returns false if there is none (the region has the latest version)
+    bool load(const glm::tvec3<cfg::Coord> & chunk_position, cfg::Block * chunk);
+    // returns once everything saved before the call is in its region
+    void drain();
+
+    struct Statistics {
+        std::atomic<size_t> saves{ 0 };
+        // saves that replaced a queued copy
+        std::atomic<size_t> coalesced{ 0 };
+        std::atomic<size_t> written{ 0 };
+        // loads served from the queue
+        std::atomic<size_t> loads{ 0 };
+        // saves that had to wait for a free buffer
+        std::atomic<size_t> stalls{ 0 };
+    };
+    const Statistics & statistics() const { return m_stats; }
+
+private:
+    static constexpr size_t NONE{ static_cast<size_t>(-1) };
+    // every entry holds at least one buffer, so there are never more entries than buffers
+    struct Entry {
+        glm::tvec3<cfg::Coord> chunk_position;
+        // reference held until the entry is gone, nullptr if entry is unused
+        Region * region;
+        size_t buffer;
+        // copy saved while buffer is being written, queued again once the write is done
+        size_t next_buffer;
+        bool writing;
+    };
+
+    RegionContainer & m_region_container;
+    std::vector<Entry> m_entries;
+    size_t m_entry_count;
+    // ring of entry indices waiting for the writer, an entry is queued at most once
+    std::vector<size_t> m_queue;
+    size_t m_queue_head;
+    size_t m_queue_size;
+    std::vector<cfg::Block> m_buffers;
+    std::vector<size_t> m_free_buffers;
+    std::mutex m_mutex;
+    // writer waits for m_queue
+    std::condition_variable m_condition;
+    // save() waits for buffers, drain() for m_entries
+    std::condition_variable m_written_condition;
+    bool m_running;
+    Statistics m_stats;
+    std::thread m_thread;
+
+    cfg::Block * buffer(size_t index) { return m_buffers.data() + index * cfg::CHUNK_VOLUME; }
+    // returns NONE if chunk is not queued
+    size_t find(const glm::tvec3<cfg::Coord> & chunk_position) const;
+    void enqueue(size_t entry);
+    void writer();
+    // writes the next queued chunk with lock held (unlocked while writing), returns false if none is queued
+    bool writeNext(std::unique_lock<std::mutex> & lock, Region::Scratch & scratch);
+    // for save() and drain() without a writer thread
+    static Region::Scratch & threadScratch();
+
+};
@@ -0,0 +1,349 @@
+#include "Codec.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+#include <zlib.h>
+#ifdef VOXEL_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef VOXEL_HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace {
+    // type in the low byte, level above
+    std::atomic<int> default_codec{ static_cast<int>(codec::CodecType::ZLIB) | (Z_BEST_COMPRESSION << 8) };
+}
+
+codec::Codec codec::getDefault() {
+    const int value = default_codec.load();
+    return { static_cast<CodecType>(value & 0xff), value >> 8 };
+}
+
+void codec::setDefault(Codec codec) {
+    default_codec.store(static_cast<int>(codec.type) | (codec.level << 8));
+}
+
+bool codec::available(CodecType type) {
+    switch (type) {
+    case CodecType::RAW:
+    case CodecType::ZLIB:
+        return true;
+    case CodecType::LZ4:
+#ifdef VOXEL_HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    case CodecType::ZSTD:
+#ifdef VOXEL_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char * codec::name(CodecType type) {
+    switch (type) {
+    case CodecType::RAW: return "raw";
+    case CodecType::ZLIB: return "zlib";
+    case CodecType::LZ4: return "lz4";
+    case CodecType::ZSTD: return "zstd";
+    }
+    return "unknown";
+}
+
+bool codec::parse(const char * text, Codec & codec) {
+    const std::string string{ text };
+    const auto colon = string.find(':');
+    const auto type_name = string.substr(0, colon);
+    for (const auto type : { CodecType::RAW, CodecType::ZLIB, CodecType::LZ4, CodecType::ZSTD }) {
+        if (type_name != name(type) || !available(type))
+            continue;
+        codec.type = type;
+        codec.level = type == CodecType::ZSTD ? 3 : Z_BEST_COMPRESSION;
+        if (colon != std::string::npos)
+            codec.level = std::atoi(string.c_str() + colon + 1);
+        return true;
+    }
+    return false;
+}
+
+namespace {
+    std::atomic<size_t> allocation_count{ 0 };
+
+    voidpf zlibAlloc(voidpf, uInt items, uInt size) {
+        allocation_count.fetch_add(1);
+        return std::calloc(items, size);
+    }
+
+    void zlibFree(voidpf, voidpf address) {
+        std::free(address);
+    }
+}
+
+struct codec::Context::State {
+    z_stream deflate_stream;
+    bool deflate_ready{ false };
+    int deflate_level;
+    z_stream inflate_stream;
+    bool inflate_ready{ false };
+#ifdef VOXEL_HAVE_ZSTD
+    ZSTD_CCtx * zstd_compress{ nullptr };
+    ZSTD_DCtx * zstd_decompress{ nullptr };
+#endif
+};
+
+size_t codec::allocationCount() { return allocation_count.load(); }
+
+uint32_t codec::checksum(const void * data, size_t size, uint32_t previous) {
+    return crc32(previous, static_cast<const Bytef *>(data), static_cast<uInt>(size));
+}
+
+codec::Context::Context() : m_state{ std::make_unique<State>() } {
+    // set up for zlib right away, so loading (inflate() with Z_FINISH never allocates a window)
+    // does not allocate, not even the first time
+    z_stream & stream = m_state->inflate_stream;
+    std::memset(&stream, 0, sizeof(stream));
+    stream.zalloc = zlibAlloc;
+    stream.zfree = zlibFree;
+    m_state->inflate_ready = inflateInit(&stream) == Z_OK;
+}
+
+codec::Context::~Context() {
+    if (m_state->deflate_ready)
+        deflateEnd(&m_state->deflate_stream);
+    if (m_state->inflate_ready)
+        inflateEnd(&m_state->inflate_stream);
+#ifdef VOXEL_HAVE_ZSTD
+    ZSTD_freeCCtx(m_state->zstd_compress);
+    ZSTD_freeDCtx(m_state->zstd_decompress);
+#endif
+}
+
+std::vector<cfg::RegByte> codec::trainDictionary(const std::vector<const cfg::RegByte *> & samples, size_t capacity) {
+    static constexpr size_t CHUNK_BYTES{ cfg::CHUNK_VOLUME };
+    std::vector<cfg::RegByte> dictionary;
+    if (samples.empty() || capacity == 0)
+        return dictionary;
+#ifdef VOXEL_HAVE_ZSTD
+    {
+        std::vector<cfg::RegByte> concatenated(samples.size() * CHUNK_BYTES);
+        const std::vector<size_t> sizes(samples.size(), CHUNK_BYTES);
+        for (size_t i = 0; i < samples.size(); ++i)
+            std::memcpy(concatenated.data() + i * CHUNK_BYTES, samples[i], CHUNK_BYTES);
+        dictionary.resize(capacity);
+        const size_t result = ZDICT_trainFromBuffer(
+            dictionary.data(), capacity, concatenated.data(), sizes.data(), static_cast<unsigned>(samples.size())
+        );
+        if (!ZDICT_isError(result)) {
+            dictionary.resize(result);
+            return dictionary;
+        }
+        // too few or too uniform samples, the rows below still work
+        dictionary.clear();
+    }
+#endif
+    static constexpr size_t ROW_BYTES{ cfg::CHUNK_SIZE.x };
+    std::unordered_map<std::string, size_t> counts;
+    for (const cfg::RegByte * sample : samples)
+        for (size_t row = 0; row < CHUNK_BYTES; row += ROW_BYTES)
+            ++counts[std::string{ reinterpret_cast<const char *>(sample) + row, ROW_BYTES }];
+    std::vector<std::pair<size_t, const std::string *>> repeated;
+    // rows in a good share of the samples, not those repeated by chance
+    const size_t minimum_count{ std::max(size_t{ 2 }, samples.size() / 8) };
+    for (const auto & count : counts)
+        if (count.second >= minimum_count)
+            repeated.push_back({ count.second, &count.first });
+    // most frequent first to pick them, stored the other way around
+    std::sort(std::begin(repeated), std::end(repeated), [](const auto & a, const auto & b) {
+        return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+    });
+    repeated.resize(std::min(repeated.size(), capacity / ROW_BYTES));
+    for (auto row = repeated.rbegin(); row != repeated.rend(); ++row)
+        dictionary.insert(std::end(dictionary), std::begin(*row->second), std::end(*row->second));
+    return dictionary;
+}
+
+size_t codec::Context::compress(
+    Codec codec,
+    cfg::RegByte * destination, size_t destination_size,
+    const void * source, size_t source_size,
+    const Dictionary * dictionary
+) {
+    switch (codec.type) {
+    case CodecType::RAW:
+        if (source_size > destination_size)
+            return 0;
+        std::memcpy(destination, source, source_size);
+        return source_size;
+    case CodecType::ZLIB: {
+        // same stream format as compress2()
+        z_stream & stream = m_state->deflate_stream;
+        if (m_state->deflate_ready && m_state->deflate_level != codec.level) {
+            deflateEnd(&stream);
+            m_state->deflate_ready = false;
+        }
+        if (m_state->deflate_ready) {
+            deflateReset(&stream);
+        } else {
+            std::memset(&stream, 0, sizeof(stream));
+            stream.zalloc = zlibAlloc;
+            stream.zfree = zlibFree;
+            if (deflateInit(&stream, codec.level) != Z_OK)
+                return 0;
+            m_state->deflate_ready = true;
+            m_state->deflate_level = codec.level;
+        }
+        if (dictionary != nullptr &&
+            deflateSetDictionary(&stream, dictionary->data.data(), static_cast<uInt>(dictionary->data.size())) != Z_OK)
+            return 0;
+        stream.next_in = static_cast<Bytef *>(const_cast<void *>(source));
+        stream.avail_in = static_cast<uInt>(source_size);
+        stream.next_out = destination;
+        stream.avail_out = static_cast<uInt>(destination_size);
+        return deflate(&stream, Z_FINISH) == Z_STREAM_END ? stream.total_out : 0;
+    }
+    case CodecType::LZ4: {
+#ifdef VOXEL_HAVE_LZ4
+        // state lives on the stack
+        if (dictionary != nullptr) {
+            LZ4_stream_t stream;
+            LZ4_resetStream(&stream);
+            LZ4_loadDict(&stream, reinterpret_cast<const char *>(dictionary->data.data()), static_cast<int>(dictionary->data.size()));
+            const int result = LZ4_compress_fast_continue(
+                &stream, static_cast<const char *>(source), reinterpret_cast<char *>(destination),
+                static_cast<int>(source_size), static_cast<int>(destination_size), 1
+            );
+            return result > 0 ? static_cast<size_t>(result) : 0;
+        }
+        const int result = LZ4_compress_default(
+            static_cast<const char *>(source), reinterpret_cast<char *>(destination),
+            static_cast<int>(source_size), static_cast<int>(destination_size)
+        );
+        return result > 0 ? static_cast<size_t>(result) : 0;
+#else
+        return 0;
+#endif
+    }
+    case CodecType::ZSTD: {
+#ifdef VOXEL_HAVE_ZSTD
+        // contexts keep their memory, counted once
+        if (m_state->zstd_compress == nullptr) {
+            m_state->zstd_compress = ZSTD_createCCtx();
+            allocation_count.fetch_add(1);
+        }
+        const size_t result = dictionary != nullptr ? ZSTD_compress_usingDict(
+            m_state->zstd_compress, destination, destination_size, source, source_size,
+            dictionary->data.data(), dictionary->data.size(), codec.level
+        ) : ZSTD_compressCCtx(
+            m_state->zstd_compress, destination, destination_size, source, source_size, codec.level
+        );
+        return ZSTD_isError(result) ? 0 : result;
+#else
+        return 0;
+#endif
+    }
+    }
+    return 0;
+}
+
+bool codec::Context::decompress(
+    CodecType type,
+    void * destination, size_t destination_size,
+    const cfg::RegByte * source, size_t source_size,
+    const Dictionary * dictionary
+) {
+    switch (type) {
+    case CodecType::RAW:
+        if (source_size != destination_size)
+            return false;
+        std::memcpy(destination, source, source_size);
+        return true;
+    case CodecType::ZLIB: {
+        z_stream & stream = m_state->inflate_stream;
+        if (m_state->inflate_ready) {
+            inflateReset(&stream);
+        } else {
+            std::memset(&stream, 0, sizeof(stream));
+            stream.zalloc = zlibAlloc;
+            stream.zfree = zlibFree;
+            if (inflateInit(&stream) != Z_OK)
+                return false;
+            m_state->inflate_ready = true;
+        }
+        stream.next_in = const_cast<Bytef *>(source);
+        stream.avail_in = static_cast<uInt>(source_size);
+        stream.next_out = static_cast<Bytef *>(destination);
+        stream.avail_out = static_cast<uInt>(destination_size);
+        int result = inflate(&stream, Z_FINISH);
+        if (result == Z_NEED_DICT) {
+            // fails if the stream was compressed with another dictionary
+            if (dictionary == nullptr ||
+                inflateSetDictionary(&stream, dictionary->data.data(), static_cast<uInt>(dictionary->data.size())) != Z_OK)
+                return false;
+            result = inflate(&stream, Z_FINISH);
+        }
+        return result == Z_STREAM_END && stream.total_out == destination_size;
+    }
+    case CodecType::LZ4: {
+#ifdef VOXEL_HAVE_LZ4
+        const int result = dictionary != nullptr ? LZ4_decompress_safe_usingDict(
+            reinterpret_cast<const char *>(source), static_cast<char *>(destination),
+            static_cast<int>(source_size), static_cast<int>(destination_size),
+            reinterpret_cast<const char *>(dictionary->data.data()), static_cast<int>(dictionary->data.size())
+        ) : LZ4_decompress_safe(
+            reinterpret_cast<const char *>(source), static_cast<char *>(destination),
+            static_cast<int>(source_size), static_cast<int>(destination_size)
+        );
+        return result >= 0 && static_cast<size_t>(result) == destination_size;
+#else
+        return false;
+#endif
+    }
+    case CodecType::ZSTD: {
+#ifdef VOXEL_HAVE_ZSTD
+        if (m_state->zstd_decompress == nullptr) {
+            m_state->zstd_decompress = ZSTD_createDCtx();
+            allocation_count.fetch_add(1);
+        }
+        const size_t result = dictionary != nullptr ? ZSTD_decompress_usingDict(
+            m_state->zstd_decompress, destination, destination_size, source, source_size,
+            dictionary->data.data(), dictionary->data.size()
+        ) : ZSTD_decompressDCtx(
+            m_state->zstd_decompress, destination, destination_size, source, source_size
+        );
+        return !ZSTD_isError(result) && result == destination_size;
+#else
+        return false;
+#endif
+    }
+    }
+    return false;
+}
+
+size_t codec::compress(
+    Codec codec,
+    cfg::RegByte * destination, size_t destination_size,
+    const void * source, size_t source_size
+) {
+    Context context;
+    return context.compress(codec, destination, destination_size, source, source_size);
+}
+
+bool codec::decompress(
+    CodecType type,
+    void * destination, size_t destination_size,
+    const cfg::RegByte * source, size_t source_size
+) {
+    Context context;
+    return context.decompress(type, destination, destination_size, source, source_size);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "cfg.hpp"
+
+namespace codec {
+    // stored per chunk in the region file, never change existing values
+    enum class CodecType : uint8_t {
+        RAW = 0,
+        ZLIB = 1,
+        LZ4 = 2, // only if built with VOXEL_HAVE_LZ4
+        ZSTD = 3 // only if built with VOXEL_HAVE_ZSTD
+    };
+
+    struct Codec {
+        CodecType type;
+        int level; // ignored by RAW and LZ4
+    };
+
+    // codec used for saving chunks, can be changed at any time (chunks remember their codec)
+    Codec getDefault();
+    void setDefault(Codec codec);
+    bool available(CodecType type);
+    const char * name(CodecType type);
+    // parses "raw", "zlib", "zlib:9", "lz4", "zstd:3", ... returns false if unknown or not available
+    bool parse(const char * text, Codec & codec);
+
+    // preset dictionary: data that chunks are compressed as a continuation of, so matches against block
+    // patterns common to all chunks are found from the first byte on (zlib uses at most the last 32 KiB)
+    // data compressed with a dictionary can only be decompressed with the same one (id is for callers)
+    struct Dictionary {
+        uint32_t id;
+        std::vector<cfg::RegByte> data;
+    };
+    // builds a dictionary of at most capacity bytes from sample chunk data (uncompressed, CHUNK_VOLUME bytes each)
+    // with zstd ZDICT_trainFromBuffer(), otherwise the CHUNK_SIZE.x long rows repeated most across samples
+    // (most frequent last, closest to the data), returns nothing if the samples have nothing in common
+    // Region doesn't use dictionaries for zstd saves
+    std::vector<cfg::RegByte> trainDictionary(const std::vector<const cfg::RegByte *> & samples, size_t capacity);
+
+    // keeps codec state (zlib streams, zstd contexts) between calls, use one per thread
+    // nothing is allocated after the first use of each codec (and zlib level)
+    class Context {
+    public:
+        Context();
+        Context(const Context &) = delete;
+        Context & operator = (const Context &) = delete;
+        ~Context();
+        // same as codec::compress() and codec::decompress()
+        // dictionary is ignored by RAW, setting it up costs some time per call with zlib (no prepared dictionaries)
+        size_t compress(
+            Codec codec,
+            cfg::RegByte * destination, size_t destination_size,
+            const void * source, size_t source_size,
+            const Dictionary * dictionary = nullptr
+        );
+        bool decompress(
+            CodecType type,
+            void * destination, size_t destination_size,
+            const cfg::RegByte * source, size_t source_size,
+            const Dictionary * dictionary = nullptr
+        );
+
+    private:
+        struct State;
+        std::unique_ptr<State> m_state;
+    };
+    // allocations made by codec libraries on behalf of Contexts so far
+    size_t allocationCount();
+
+    // CRC-32 (zlib), continues previous for data split into parts
+    uint32_t checksum(const void * data, size_t size, uint32_t previous = 0);
+
+    // one-off versions, set up codec state every call
+    // returns compressed size, 0 on failure
+    size_t compress(
+        Codec codec,
+        cfg::RegByte * destination, size_t destination_size,
+        const void * source, size_t source_size
+    );
+    // returns true if destination was filled with exactly destination_size bytes
+    bool decompress(
+        CodecType type,
+        void * destination, size_t destination_size,
+        const cfg::RegByte * source, size_t source_size
+    );
+}
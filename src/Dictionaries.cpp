@@ -0,0 +1,183 @@
+#include "Dictionaries.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Print.hpp"
+
+namespace {
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t id;
+        uint32_t size;
+        // codec::checksum() of the data
+        uint32_t checksum;
+    };
+
+    std::mutex mutex;
+    // loaded dictionaries are never freed, pointers stay valid
+    std::unordered_map<uint32_t, std::unique_ptr<codec::Dictionary>> loaded;
+    // highest id in the world directory, 0 if none, valid once scanned
+    uint32_t latest_id{ 0 };
+    bool scanned{ false };
+    std::atomic<const codec::Dictionary *> current_dictionary{ nullptr };
+    std::atomic_bool current_ready{ false };
+
+    std::atomic_bool training{ false };
+    std::mutex sample_mutex;
+    std::vector<std::vector<cfg::RegByte>> samples;
+    bool trained{ false };
+
+    std::string fileName(uint32_t id) {
+        return "world/dictionary." + std::to_string(id);
+    }
+
+    // call with mutex
+    void scan() {
+        if (scanned)
+            return;
+        scanned = true;
+        DIR * dir = opendir("world");
+        if (dir == nullptr)
+            return;
+        static constexpr char PREFIX[]{ "dictionary." };
+        while (const dirent * entry = readdir(dir)) {
+            if (std::strncmp(entry->d_name, PREFIX, sizeof(PREFIX) - 1) != 0)
+                continue;
+            // not files left by an interrupted add()
+            char * end;
+            const unsigned long id{ std::strtoul(entry->d_name + sizeof(PREFIX) - 1, &end, 10) };
+            if (*end == '\0')
+                latest_id = std::max(latest_id, static_cast<uint32_t>(id));
+        }
+        closedir(dir);
+    }
+
+    // call with mutex
+    const codec::Dictionary * load(uint32_t id) {
+        const auto found = loaded.find(id);
+        if (found != loaded.end())
+            return found->second.get();
+        const int fd = open(fileName(id).c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+        FileHeader header{};
+        auto dictionary = std::make_unique<codec::Dictionary>();
+        bool valid = pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+            header.magic == dictionaries::MAGIC && header.version == dictionaries::VERSION && header.id == id &&
+            header.size <= cfg::CHUNK_DICTIONARY_SIZE;
+        if (valid) {
+            dictionary->id = id;
+            dictionary->data.resize(header.size);
+            valid = pread(fd, dictionary->data.data(), header.size, sizeof(header)) == static_cast<ssize_t>(header.size) &&
+                codec::checksum(dictionary->data.data(), header.size) == header.checksum;
+        }
+        close(fd);
+        if (!valid) {
+            Print("Dictionary ", id, " is broken.");
+            return nullptr;
+        }
+        const codec::Dictionary * result{ dictionary.get() };
+        loaded.emplace(id, std::move(dictionary));
+        return result;
+    }
+}
+
+const codec::Dictionary * dictionaries::current() {
+    if (current_ready.load())
+        return current_dictionary.load();
+    std::lock_guard<std::mutex> lock{ mutex };
+    scan();
+    if (!current_ready.load()) {
+        current_dictionary.store(latest_id != 0 ? load(latest_id) : nullptr);
+        current_ready.store(true);
+    }
+    return current_dictionary.load();
+}
+
+const codec::Dictionary * dictionaries::get(uint32_t id) {
+    std::lock_guard<std::mutex> lock{ mutex };
+    return load(id);
+}
+
+const codec::Dictionary & dictionaries::add(std::vector<cfg::RegByte> data) {
+    if (data.size() > cfg::CHUNK_DICTIONARY_SIZE)
+        throw std::runtime_error("Dictionary too large.");
+    std::lock_guard<std::mutex> lock{ mutex };
+    scan();
+    auto dictionary = std::make_unique<codec::Dictionary>();
+    dictionary->id = latest_id + 1;
+    dictionary->data = std::move(data);
+
+    // complete on disk before any chunk refers to it
+    const FileHeader header{
+        MAGIC, VERSION, dictionary->id, static_cast<uint32_t>(dictionary->data.size()),
+        codec::checksum(dictionary->data.data(), dictionary->data.size())
+    };
+    const std::string name{ fileName(dictionary->id) };
+    const std::string temp_name{ name + ".tmp" };
+    const int fd = open(temp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        throw std::runtime_error("Failed to create dictionary file.");
+    pwrite(fd, &header, sizeof(header), 0);
+    pwrite(fd, dictionary->data.data(), dictionary->data.size(), sizeof(header));
+    fsync(fd);
+    close(fd);
+    if (rename(temp_name.c_str(), name.c_str()) != 0)
+        throw std::runtime_error("Failed to store dictionary file.");
+    const int directory_fd = open("world", O_RDONLY | O_DIRECTORY);
+    if (directory_fd >= 0) {
+        fsync(directory_fd);
+        close(directory_fd);
+    }
+
+    latest_id = dictionary->id;
+    const codec::Dictionary & result{ *dictionary };
+    loaded.emplace(result.id, std::move(dictionary));
+    current_dictionary.store(&result);
+    current_ready.store(true);
+    return result;
+}
+
+void dictionaries::setTraining(bool enabled) {
+    training.store(enabled);
+}
+
+void dictionaries::sample(const cfg::RegByte * chunk) {
+    if (!training.load() || current() != nullptr)
+        return;
+    std::vector<std::vector<cfg::RegByte>> complete;
+    {
+        std::lock_guard<std::mutex> lock{ sample_mutex };
+        if (trained)
+            return;
+        samples.emplace_back(chunk, chunk + cfg::CHUNK_VOLUME);
+        if (samples.size() < cfg::CHUNK_DICTIONARY_SAMPLE_COUNT)
+            return;
+        // only one dictionary per run, also if the samples had nothing in common
+        trained = true;
+        complete.swap(samples);
+    }
+    std::vector<const cfg::RegByte *> pointers;
+    for (const auto & sample : complete)
+        pointers.push_back(sample.data());
+    auto data = codec::trainDictionary(pointers, cfg::CHUNK_DICTIONARY_SIZE);
+    if (data.empty())
+        return;
+    const auto & dictionary = add(std::move(data));
+    Print("Trained dictionary ", dictionary.id, " (", dictionary.data.size(), " bytes).");
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "cfg.hpp"
+#include "Codec.hpp"
+
+// preset dictionaries for chunk data (codec::Dictionary), shared by all regions of a world
+// stored in world/dictionary.<id> (magic, version, id, size, checksum, data), never changed or deleted,
+// chunks remember the id of the one they were compressed with (Region::Slot::codec)
+// with training on, the first cfg::CHUNK_DICTIONARY_SAMPLE_COUNT chunks saved while the world has no dictionary
+// are sampled and a dictionary is trained from them, it's used for every save afterwards
+namespace dictionaries {
+    static constexpr uint32_t MAGIC{ 0x44525856 }; // "VXRD"
+    static constexpr uint32_t VERSION{ 1 };
+
+    // dictionary used for saving chunks: the latest one of the world, nullptr if there is none
+    const codec::Dictionary * current();
+    // loaded from the world directory on first use, stays in memory, nullptr if missing or broken
+    const codec::Dictionary * get(uint32_t id);
+    // stores a new dictionary with the next id, it becomes current()
+    const codec::Dictionary & add(std::vector<cfg::RegByte> data);
+
+    // off by default
+    void setTraining(bool training);
+    // called for every chunk saved, does something only while training and there is no dictionary yet
+    // the save reaching the sample count trains the dictionary
+    // chunk is the CHUNK_VOLUME bytes of chunk data of a chunk with a byte per block (Region::Slot::WIDE)
+    void sample(const cfg::RegByte * chunk);
+}
@@ -1,7 +1,10 @@
 #pragma once
 
-#include <queue>
+#include <deque>
 #include <mutex>
+#include <vector>
+#include <iterator>
+#include <algorithm>
 #include <cassert>
 #include <condition_variable>
 
@@ -12,7 +15,7 @@ public:
         std::unique_lock<std::mutex> l{ lock };
         while (m_queue.size() == N)
             m_condition.wait(l);
-        m_queue.push(std::move(value));
+        m_queue.push_back(std::move(value));
     }
 
     bool pop(T && result) {
@@ -20,13 +23,27 @@ public:
             std::unique_lock<std::mutex> l{ lock };
             if (m_queue.empty()) return false;
             result = std::move(m_queue.front());
-            m_queue.pop();
+            m_queue.pop_front();
         }
         m_condition.notify_one();
         return true;
     }
+
+    // takes the elements predicate is true for, in queue order, the others keep theirs
+    template <typename Predicate>
+    void popIf(std::vector<T> & result, Predicate predicate) {
+        { // unlock before notify
+            std::unique_lock<std::mutex> l{ lock };
+            const auto taken = std::stable_partition(m_queue.begin(), m_queue.end(), [&predicate](const T & value) {
+                return !predicate(value);
+            });
+            std::move(taken, m_queue.end(), std::back_inserter(result));
+            m_queue.erase(taken, m_queue.end());
+        }
+        m_condition.notify_all();
+    }
 private:
-    std::queue<T> m_queue;
+    std::deque<T> m_queue;
     std::mutex lock;
     std::condition_variable m_condition;
 
@@ -4,12 +4,15 @@
 #include <array>
 #include <vector>
 #include "Print.hpp"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace Math {
     template <typename T>
     struct VecKeyHash {
     std::size_t operator () (const glm::tvec3<T> & k) const {
-        return k.x * k.y * k.z; // TODO: better hash function
+        return (std::size_t(k.x) * 73856093) ^ (std::size_t(k.y) * 19349663) ^ (std::size_t(k.z) * 83492791);
     }};
     template <typename T>
     struct VecKeyEqual {
@@ -197,6 +200,26 @@ namespace Math {
             static_cast<std::uint8_t>(corner);
     }
 
+    // index of the lowest set bit, bits must not be 0
+    inline unsigned countTrailingZeros(uint32_t bits) {
+    #ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, bits);
+        return static_cast<unsigned>(index);
+    #else
+        return static_cast<unsigned>(__builtin_ctz(bits));
+    #endif
+    }
+    inline unsigned countTrailingZeros64(uint64_t bits) {
+    #ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return static_cast<unsigned>(index);
+    #else
+        return static_cast<unsigned>(__builtin_ctzll(bits));
+    #endif
+    }
+
     inline uint8_t vertexAOInv(bool side_a, bool side_b, bool corner) {
         if (side_a && side_b) return 1;
         return !side_a + !side_b + !corner + 1;
@@ -11,4 +11,15 @@ struct Mesh {
     Mesh(Mesh &&) = default;
     Mesh & operator = (const Mesh &) = delete;
     Mesh & operator = (Mesh &&) = default;
+};
+
+// quads of a mesh that changed, see VoxelContainer::patchMeshesWithBlockRange()
+struct MeshPatch {
+    glm::tvec3<cfg::Coord> position;
+    // all of the mesh after the patch, valid until the next patch
+    const std::vector<cfg::Vertex> * mesh;
+    // quads (4 vertices each) that changed (sorted), the rest of the mesh is as it was
+    std::vector<uint32_t> quads;
+    // the mesh was made anew, nothing is as it was
+    bool full;
 };
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "PackedChunk.hpp"
+
+#include <array>
+#include <algorithm>
+#include <cstring>
+
+#include "Math.hpp"
+
+namespace {
+    using Word = uint64_t;
+    constexpr unsigned WORD_BITS{ sizeof(Word) * CHAR_BIT };
+
+    // palette index + 1 of every block, 0 if it is not in the palette being built (entries are reset after use)
+    thread_local std::vector<uint16_t> palette_lookup(size_t{ 1 } << sizeof(cfg::Block) * CHAR_BIT);
+
+    // blocks of every byte of indices, so a byte is decoded at once
+    template <unsigned BITS>
+    using ByteTable = std::array<std::array<cfg::Block, CHAR_BIT / BITS>, 256>;
+
+    template <unsigned BITS>
+    ByteTable<BITS> byteTable(const std::vector<cfg::Block> & palette) {
+        ByteTable<BITS> table;
+        // set() decodes with the palette already holding the entry that doesn't fit
+        std::array<cfg::Block, size_t{ 1 } << BITS> entries{};
+        std::copy_n(std::begin(palette), std::min(palette.size(), entries.size()), std::begin(entries));
+        for (unsigned byte = 0; byte < table.size(); ++byte)
+            for (unsigned j = 0; j < CHAR_BIT / BITS; ++j)
+                table[byte][j] = entries[byte >> j * BITS & ((1u << BITS) - 1)];
+        return table;
+    }
+
+    // count blocks from index on, a byte of indices at a time where they are whole
+    template <unsigned BITS>
+    void decodeRun(const Word * words, const ByteTable<BITS> & table, cfg::Coord index, cfg::Coord count, cfg::Block * destination) {
+        static constexpr cfg::Coord PER_WORD{ WORD_BITS / BITS };
+        static constexpr cfg::Coord PER_BYTE{ CHAR_BIT / BITS };
+        static constexpr Word MASK{ (Word{ 1 } << BITS) - 1 };
+        auto indices = [words](cfg::Coord i) {
+            return words[i / PER_WORD] >> (i % PER_WORD * BITS);
+        };
+        const cfg::Coord end{ index + count };
+        cfg::Coord i{ index };
+        for (; i % PER_BYTE != 0 && i < end; ++i)
+            *destination++ = table[indices(i) & MASK][0];
+        for (; i + PER_BYTE <= end; i += PER_BYTE, destination += PER_BYTE)
+            std::memcpy(destination, table[indices(i) & 0xff].data(), PER_BYTE * sizeof(cfg::Block));
+        for (; i < end; ++i)
+            *destination++ = table[indices(i) & MASK][0];
+    }
+}
+
+PackedChunk::PackedChunk() :
+    m_bits{ 0 },
+    m_air_count{ cfg::CHUNK_VOLUME },
+    m_palette{ cfg::Block{ 0 } }
+{
+}
+
+unsigned PackedChunk::bitsFor(size_t palette_size) {
+    if (palette_size <= 1)
+        return 0;
+    unsigned bits{ 1 };
+    while ((size_t{ 1 } << bits) < palette_size)
+        bits *= 2;
+    return std::min(bits, BLOCK_BITS);
+}
+
+void PackedChunk::pack(const cfg::Block * chunk) {
+    m_air_count = static_cast<cfg::Coord>(std::count(chunk, chunk + cfg::CHUNK_VOLUME, cfg::Block{ 0 }));
+    m_palette.clear();
+    for (cfg::Coord i = 0; i < cfg::CHUNK_VOLUME; ++i) {
+        if (palette_lookup[chunk[i]] != 0)
+            continue;
+        m_palette.push_back(chunk[i]);
+        palette_lookup[chunk[i]] = static_cast<uint16_t>(m_palette.size());
+        // too many for anything narrower than the blocks themselves
+        if (m_palette.size() > size_t{ 1 } << BLOCK_BITS / 2)
+            break;
+    }
+    for (const cfg::Block block : m_palette)
+        palette_lookup[block] = 0;
+    m_bits = bitsFor(m_palette.size());
+    if (m_bits == BLOCK_BITS)
+        m_palette.clear();
+    encode(chunk);
+}
+
+void PackedChunk::encode(const cfg::Block * chunk) {
+    const size_t word_count{ size_t{ cfg::CHUNK_VOLUME } * m_bits / WORD_BITS };
+    m_words.assign(word_count, 0);
+    // give memory back when a chunk got a lot simpler
+    if (m_words.capacity() > word_count * 2)
+        m_words.shrink_to_fit();
+    if (m_bits == 0)
+        return;
+
+    if (m_bits == BLOCK_BITS) {
+        std::memcpy(blocks(), chunk, cfg::CHUNK_VOLUME * sizeof(cfg::Block));
+        return;
+    }
+    for (size_t i = 0; i < m_palette.size(); ++i)
+        palette_lookup[m_palette[i]] = static_cast<uint16_t>(i + 1);
+
+    const unsigned per_word{ WORD_BITS / m_bits };
+    for (size_t w = 0; w < word_count; ++w) {
+        const cfg::Block * blocks{ chunk + w * per_word };
+        Word word{ 0 };
+        for (unsigned j = 0; j < per_word; ++j)
+            word |= Word{ palette_lookup[blocks[j]] - 1u } << (j * m_bits);
+        m_words[w] = word;
+    }
+    for (const cfg::Block block : m_palette)
+        palette_lookup[block] = 0;
+}
+
+void PackedChunk::unpack(cfg::Block * chunk) const {
+    withDecoder([chunk](const auto & decode) {
+        decode(0, cfg::CHUNK_VOLUME, chunk);
+    });
+}
+
+void PackedChunk::copyBox(
+    const glm::tvec3<cfg::Coord> & from, const glm::tvec3<cfg::Coord> & size,
+    cfg::Block * destination, const glm::tvec3<cfg::Coord> & destination_size,
+    const glm::tvec3<cfg::Coord> & destination_position
+) const {
+    withDecoder([&](const auto & decode) {
+        glm::tvec3<cfg::Coord> i{ 0, 0, 0 };
+        for (i.z = 0; i.z < size.z; ++i.z)
+            for (i.y = 0; i.y < size.y; ++i.y)
+                decode(
+                    Math::to_index(from + i, cfg::CHUNK_SIZE), size.x,
+                    destination + Math::to_index(destination_position + i, destination_size)
+                );
+    });
+}
+
+void PackedChunk::set(cfg::Coord index, cfg::Block block) {
+    m_air_count += (block == cfg::Block{ 0 }) - (get(index) == cfg::Block{ 0 });
+    if (m_bits == BLOCK_BITS) {
+        blocks()[index] = block;
+        return;
+    }
+    const auto found = std::find(std::begin(m_palette), std::end(m_palette), block);
+    const Word palette_index{ static_cast<Word>(found - std::begin(m_palette)) };
+    if (found == std::end(m_palette)) {
+        m_palette.push_back(block);
+        const unsigned bits{ bitsFor(m_palette.size()) };
+        if (bits != m_bits) {
+            // widen, indices of the blocks already in the palette don't change
+            std::vector<cfg::Block> blocks(cfg::CHUNK_VOLUME);
+            unpack(blocks.data());
+            blocks[index] = block;
+            m_bits = bits;
+            if (m_bits == BLOCK_BITS)
+                m_palette.clear();
+            encode(blocks.data());
+            return;
+        }
+    }
+    if (m_bits == 0)
+        return;
+    const size_t bit{ static_cast<size_t>(index) * m_bits };
+    Word & word{ m_words[bit / WORD_BITS] };
+    word = (word & ~(mask(m_bits) << bit % WORD_BITS)) | palette_index << bit % WORD_BITS;
+}
+
+template <typename Function>
+void PackedChunk::withDecoder(Function && function) const {
+    switch (m_bits) {
+    case 0:
+        function([this](cfg::Coord, cfg::Coord count, cfg::Block * destination) {
+            std::fill(destination, destination + count, m_palette[0]);
+        });
+        break;
+    case 1: {
+        const auto table = byteTable<1>(m_palette);
+        function([this, &table](cfg::Coord index, cfg::Coord count, cfg::Block * destination) {
+            decodeRun<1>(m_words.data(), table, index, count, destination);
+        });
+        break;
+    }
+    case 2: {
+        const auto table = byteTable<2>(m_palette);
+        function([this, &table](cfg::Coord index, cfg::Coord count, cfg::Block * destination) {
+            decodeRun<2>(m_words.data(), table, index, count, destination);
+        });
+        break;
+    }
+    case 4: {
+        const auto table = byteTable<4>(m_palette);
+        function([this, &table](cfg::Coord index, cfg::Coord count, cfg::Block * destination) {
+            decodeRun<4>(m_words.data(), table, index, count, destination);
+        });
+        break;
+    }
+    default:
+        if (m_bits == BLOCK_BITS) {
+            function([this](cfg::Coord index, cfg::Coord count, cfg::Block * destination) {
+                std::memcpy(destination, blocks() + index, count * sizeof(cfg::Block));
+            });
+        } else if constexpr (BLOCK_BITS > 8) {
+            const auto table = byteTable<8>(m_palette);
+            function([this, &table](cfg::Coord index, cfg::Coord count, cfg::Block * destination) {
+                decodeRun<8>(m_words.data(), table, index, count, destination);
+            });
+        }
+        break;
+    }
+}
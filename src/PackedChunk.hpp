@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <climits>
+#include <vector>
+#include <glm/vec3.hpp>
+#include "cfg.hpp"
+
+// chunk kept in memory as a palette of the blocks in it and per block an index into the palette,
+// packed into 0, 1, 2, 4 or 8 bits (the fewest the palette fits in, 8 only for 16 bit blocks)
+// 0 bits: uniform chunk, only the palette is stored
+// indices as wide as cfg::Block: no palette, the blocks are stored as they are (in the bytes of the words)
+// indices never straddle words, reading a block is a load, a shift, a mask and a palette lookup
+// not thread safe, VoxelContainer keeps writers apart from readers (as it did for flat chunks)
+class PackedChunk {
+public:
+    // uniform, all air
+    PackedChunk();
+
+    // replaces the content, the palette is rebuilt to hold only the blocks in chunk
+    void pack(const cfg::Block * chunk);
+    void unpack(cfg::Block * chunk) const;
+    // copies the box of size at from (in the chunk) into the box of destination_size at destination_position
+    // (whole rows are decoded at once, uniform chunks are filled)
+    void copyBox(
+        const glm::tvec3<cfg::Coord> & from, const glm::tvec3<cfg::Coord> & size,
+        cfg::Block * destination, const glm::tvec3<cfg::Coord> & destination_size,
+        const glm::tvec3<cfg::Coord> & destination_position
+    ) const;
+
+    cfg::Block get(cfg::Coord index) const {
+        if (m_bits == 0)
+            return m_palette[0];
+        if (m_bits == BLOCK_BITS)
+            return blocks()[index];
+        const size_t bit{ static_cast<size_t>(index) * m_bits };
+        return m_palette[m_words[bit / WORD_BITS] >> (bit % WORD_BITS) & mask(m_bits)];
+    }
+    // blocks not in the palette are added, indices are widened once it doesn't fit anymore
+    // (the palette only shrinks on pack())
+    void set(cfg::Coord index, cfg::Block block);
+
+    bool uniform() const { return m_bits == 0; }
+    // kept up to date by pack() and set(), a mesh of chunks that are all air or all solid has no faces
+    bool allAir() const { return m_air_count == cfg::CHUNK_VOLUME; }
+    bool allSolid() const { return m_air_count == 0; }
+    unsigned bits() const { return m_bits; }
+    // 0 if blocks are stored as they are
+    size_t paletteSize() const { return m_palette.size(); }
+    // heap memory held
+    size_t memoryUsage() const { return m_palette.capacity() * sizeof(cfg::Block) + m_words.capacity() * sizeof(Word); }
+
+private:
+    using Word = uint64_t;
+    static constexpr unsigned WORD_BITS{ sizeof(Word) * CHAR_BIT };
+    static constexpr unsigned BLOCK_BITS{ sizeof(cfg::Block) * CHAR_BIT };
+    static_assert(cfg::CHUNK_VOLUME % WORD_BITS == 0);
+
+    unsigned m_bits;
+    // blocks that are air
+    cfg::Coord m_air_count;
+    std::vector<cfg::Block> m_palette;
+    std::vector<Word> m_words;
+
+    static constexpr Word mask(unsigned bits) { return (Word{ 1 } << bits) - 1; }
+    // fewest bits a palette of size fits in
+    static unsigned bitsFor(size_t palette_size);
+    // indices of chunk for the current palette and m_bits
+    void encode(const cfg::Block * chunk);
+    cfg::Block * blocks() { return reinterpret_cast<cfg::Block *>(m_words.data()); }
+    const cfg::Block * blocks() const { return reinterpret_cast<const cfg::Block *>(m_words.data()); }
+    // calls function with a decoder (index, count, destination) writing count blocks from index on to destination,
+    // set up once for all the runs decoded in function
+    template <typename Function>
+    void withDecoder(Function && function) const;
+
+};
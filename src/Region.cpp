@@ -1,20 +1,57 @@
 #include "Region.hpp"
 
 #include <array>
+#include <vector>
+#include <algorithm>
 #include <memory> // TODO: remove
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-#include <zlib.h>
-
+#include "Codec.hpp"
+#include "Dictionaries.hpp"
 #include "Print.hpp"
 
-Region::Region(const glm::tvec3<cfg::Coord> & region_position) {
+namespace {
+    std::atomic<Region::Backend> default_backend{ Region::Backend::PREAD };
+    std::atomic<Region::Storage> default_storage{ Region::Storage::FILES };
+
+    // makes renames in the directory durable
+    void syncDirectory(const char * path) {
+        const int directory_fd = open(path, O_RDONLY | O_DIRECTORY);
+        if (directory_fd < 0)
+            return;
+        fsync(directory_fd);
+        close(directory_fd);
+    }
+}
+
+static_assert(
+    cfg::REGION_MMAP_RESERVE >= 2 * cfg::REGION_VOLUME * cfg::COMPRESS_BUFFER_SIZE_IN_BYTES,
+    "Mapping must be able to hold a full region plus garbage."
+);
+
+void Region::setDefaultBackend(Backend backend) { default_backend.store(backend); }
+Region::Backend Region::getDefaultBackend() { return default_backend.load(); }
+void Region::setDefaultStorage(Storage storage) { default_storage.store(storage); }
+Region::Storage Region::getDefaultStorage() { return default_storage.load(); }
+
+Region::Region(const glm::tvec3<cfg::Coord> & region_position) : region_position{ region_position } {
     ref_count = 0;
-    
-    std::array<char, 128> file_name;
+    mapping = nullptr;
+    world_file = nullptr;
+    sequence = 0;
+    slots_dirty.store(false);
+    saves_since_checkpoint.store(0);
+    pending_loads.store(0);
+    slots.resize(cfg::REGION_VOLUME);
+    uncommitted.resize(cfg::REGION_VOLUME, 0);
+
     const int name_result = std::snprintf(
         std::begin(file_name), file_name.size(), "%s/%i|%i|%i",
         "world", region_position.x, region_position.y, region_position.z
@@ -23,22 +60,76 @@ Region::Region(const glm::tvec3<cfg::Coord> & region_position) {
     if (name_result < 0 || name_result >= file_name.size())
         throw std::runtime_error("Oops, region file name too large.");
 
+    if (getDefaultStorage() == Storage::WORLD_FILES) {
+        world_file = &WorldFile::get(region_position);
+        fd = world_file->fd();
+        // end and garbage are kept by world_file
+        end.store(0);
+        garbage.store(0);
+        file_size.store(0);
+        // slots stay empty for a new region
+        world_file->readRegion(region_position, slots.data(), slots.size() * sizeof(Slot));
+        return;
+    }
+
     fd = open(file_name.data(), O_RDWR | O_CREAT, 0666);
     struct stat file_info;
     const auto result = fstat(fd, &file_info);
     const auto new_region = file_info.st_size == 0;
 
     if (new_region) {
-        const cfg::RegUint end_value = (2 * cfg::REGION_VOLUME + 2) * sizeof(cfg::RegUint);
-        end.store(end_value);
+        end.store(HEADER_SIZE);
         garbage.store(0);
-        ftruncate(fd, end_value);
-    } else {
-        std::array<cfg::RegUint, 2> eg;
-        read(eg.data(), 2 * sizeof(cfg::RegUint), 0);
-        end.store(eg[0]);
-        garbage.store(eg[1]);
+        ftruncate(fd, HEADER_SIZE);
+        writeHeader(fd, sequence);
+    } else if (!useLatestHeader(file_info.st_size, VERSION)) {
+        if (useLatestHeader(file_info.st_size, 7) || useLatestHeader(file_info.st_size, 6) || useLatestHeader(file_info.st_size, 5)) {
+            // same layout, chunk data of older versions is never Slot::SECOND, Slot::WIDE (before 7) and names
+            // no dictionary (before 6), the next commit writes a current header
+            slots_dirty.store(true);
+        } else {
+            if (!useLatestHeader(file_info.st_size, 4)) {
+                std::array<cfg::RegUint, 2> info{ 0, 0 };
+                read(info.data(), sizeof(info), 0);
+                if (info[0] == MAGIC && info[1] > VERSION)
+                    throw std::runtime_error("Unsupported region file version.");
+                if (info[0] == MAGIC && info[1] >= 4)
+                    throw std::runtime_error("Region file has no valid header.");
+                // version 0 has no magic
+                slots = readOldSlots(info[0] == MAGIC ? info[1] : 0);
+            }
+            // convert older versions to current format
+            migrate();
+        }
     }
+
+    // fd might have changed by migrate()
+    fstat(fd, &file_info);
+    file_size.store(file_info.st_size);
+    if (getDefaultBackend() == Backend::MMAP)
+        map();
+}
+
+void Region::map() {
+    // pages beyond the end of the file must never be touched
+    reserve(end.load());
+    void * address = mmap(nullptr, cfg::REGION_MMAP_RESERVE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+        throw std::runtime_error("Failed to map region file.");
+    mapping = static_cast<cfg::RegByte *>(address);
+}
+
+void Region::reserve(size_t size) {
+    if (size <= file_size.load())
+        return;
+    std::lock_guard<std::mutex> lock{ grow_mutex };
+    if (size <= file_size.load())
+        return;
+    const size_t new_size{ (size + cfg::REGION_MMAP_EXTENT - 1) / cfg::REGION_MMAP_EXTENT * cfg::REGION_MMAP_EXTENT };
+    if (new_size > cfg::REGION_MMAP_RESERVE)
+        throw std::runtime_error("Region file too large for mapping.");
+    ftruncate(fd, new_size);
+    file_size.store(new_size);
 }
 
 size_t Region::refCountGet() const { return ref_count; }
@@ -47,148 +138,553 @@ void Region::refCountDecrement() { assert(ref_count != 0); --ref_count; }
 
 Region::~Region() {
     if (fd < 0) return;
-    const std::array<cfg::RegUint, 2> eg{ end.load(), garbage.load() };
-    write(eg.data(), 2 * sizeof(cfg::RegUint), 0);
+    commit();
+    if (world_file != nullptr)
+        return;
+    if (mapping != nullptr) {
+        munmap(mapping, cfg::REGION_MMAP_RESERVE);
+        // cut off unused part of the last extent
+        ftruncate(fd, end.load());
+    }
     close(fd);
 }
 
 void Region::read(void * buffer, cfg::RegUint count, cfg::RegUint position) {
+    if (mapping != nullptr) {
+        assert(position + count <= file_size.load());
+        std::memcpy(buffer, mapping + position, count);
+        return;
+    }
+    stats.syscalls.fetch_add(1);
     pread(fd, buffer, count, position);
 }
 
 void Region::write(const void * buffer, cfg::RegUint count, cfg::RegUint position) {
+    if (mapping != nullptr) {
+        reserve(size_t(position) + count);
+        std::memcpy(mapping + position, buffer, count);
+        return;
+    }
+    stats.syscalls.fetch_add(1);
     pwrite(fd, buffer, count, position);
 }
 
-void Region::saveChunk(cfg::RegUint chunk_index, const cfg::Block * chunk) {
-    // TODO: allocate the buffer only once (and with the maximum needed size)
-    std::unique_ptr<cfg::RegByte[]> buffer{ std::make_unique<cfg::RegByte[]>(cfg::COMPRESS_BUFFER_SIZE_IN_BYTES) };
-    uLongf compressed_size = cfg::COMPRESS_BUFFER_SIZE_IN_BYTES;
-    const auto compression_result = compress2(
-        buffer.get(), &compressed_size,
-        chunk, cfg::CHUNK_VOLUME * sizeof(cfg::Block),
-        Z_BEST_COMPRESSION
+cfg::RegUint Region::allocate(cfg::RegUint capacity) {
+    if (world_file != nullptr)
+        return world_file->allocate(capacity);
+    return end.fetch_add(capacity);
+}
+
+void Region::release(cfg::RegUint position, cfg::RegUint capacity) {
+    stats.garbage_bytes.fetch_add(capacity);
+    if (world_file == nullptr) {
+        garbage.fetch_add(capacity);
+        return;
+    }
+    if (capacity == 0)
+        return;
+    std::lock_guard<std::mutex> lock{ freed_mutex };
+    freed.push_back({ position, capacity });
+}
+
+void Region::sync() {
+    // pages written through a shared mapping are in the page cache like pwrite()s
+    fdatasync(fd);
+}
+
+cfg::RegUint Region::headerChecksum(const HeaderInfo & info, const void * table, size_t table_size) {
+    const uint32_t info_checksum{ codec::checksum(&info, offsetof(HeaderInfo, checksum)) };
+    return codec::checksum(table, table_size, info_checksum);
+}
+
+cfg::RegUint Region::headerCopySize(cfg::RegUint version) {
+    return HEADER_INFO_SIZE + cfg::REGION_VOLUME * (version >= 5 ? sizeof(Slot) : OLD_SLOT_SIZE);
+}
+
+void Region::writeHeader(int file, cfg::RegUint header_sequence) {
+    HeaderInfo info{ MAGIC, VERSION, header_sequence, end.load(), garbage.load(), 0 };
+    info.checksum = headerChecksum(info, slots.data(), slots.size() * sizeof(Slot));
+    const cfg::RegUint copy_position{ header_sequence % 2 * HEADER_COPY_SIZE };
+    if (file == fd) {
+        write(slots.data(), slots.size() * sizeof(Slot), copy_position + HEADER_INFO_SIZE);
+        write(&info, HEADER_INFO_SIZE, copy_position);
+    } else {
+        pwrite(file, slots.data(), slots.size() * sizeof(Slot), copy_position + HEADER_INFO_SIZE);
+        pwrite(file, &info, HEADER_INFO_SIZE, copy_position);
+    }
+}
+
+bool Region::readHeader(int file, cfg::RegUint version, cfg::RegUint copy, HeaderInfo & info, std::vector<Slot> & table) {
+    const cfg::RegUint copy_position{ copy * headerCopySize(version) };
+    info = HeaderInfo{};
+    pread(file, &info, HEADER_INFO_SIZE, copy_position);
+    if (info.magic != MAGIC || info.version != version)
+        return false;
+    if (version >= 5) {
+        pread(file, table.data(), table.size() * sizeof(Slot), copy_position + HEADER_INFO_SIZE);
+        return info.checksum == headerChecksum(info, table.data(), table.size() * sizeof(Slot));
+    }
+    std::vector<cfg::RegUint> old_table(4 * cfg::REGION_VOLUME);
+    pread(file, old_table.data(), old_table.size() * sizeof(cfg::RegUint), copy_position + HEADER_INFO_SIZE);
+    if (info.checksum != headerChecksum(info, old_table.data(), old_table.size() * sizeof(cfg::RegUint)))
+        return false;
+    for (cfg::RegUint i = 0; i < cfg::REGION_VOLUME; ++i)
+        table[i] = { old_table[4 * i], old_table[4 * i + 1], old_table[4 * i + 2], old_table[4 * i + 3], 0 };
+    return true;
+}
+
+bool Region::readLatestHeader(int file, size_t file_length, cfg::RegUint version, HeaderInfo & info, std::vector<Slot> & table) {
+    if (file_length < 2 * size_t(headerCopySize(version)))
+        return false;
+    // a crash while committing can only break the copy that was being written
+    HeaderInfo other_info;
+    std::vector<Slot> other_table(cfg::REGION_VOLUME);
+    const bool valid{ readHeader(file, version, 0, info, table) };
+    if (readHeader(file, version, 1, other_info, other_table) && (!valid || other_info.sequence > info.sequence)) {
+        info = other_info;
+        table.swap(other_table);
+    } else if (!valid) {
+        return false;
+    }
+    return true;
+}
+
+bool Region::useLatestHeader(size_t file_length, cfg::RegUint version) {
+    HeaderInfo info;
+    if (!readLatestHeader(fd, file_length, version, info, slots))
+        return false;
+    sequence = info.sequence;
+    end.store(info.end);
+    garbage.store(info.garbage);
+    return true;
+}
+
+void Region::commit() {
+    saves_since_checkpoint.store(0);
+    if (!slots_dirty.exchange(false))
+        return;
+    if (world_file != nullptr) {
+        world_file->commitRegion(region_position, slots.data(), slots.size() * sizeof(Slot), freed);
+    } else {
+        // chunk data has to be on disk before a header pointing to it
+        sync();
+        ++sequence;
+        writeHeader(fd, sequence);
+        sync();
+    }
+    std::fill(std::begin(uncommitted), std::end(uncommitted), 0);
+    stats.commits.fetch_add(1);
+}
+
+void Region::checkpoint() {
+    std::unique_lock<std::shared_mutex> lock{ mutex };
+    commit();
+}
+
+void Region::prefetch() {
+    // fd and mapping change when defragmenting
+    std::shared_lock<std::shared_mutex> lock{ mutex };
+    // start and end of the chunk data
+    std::vector<std::pair<cfg::RegUint, cfg::RegUint>> extents;
+    for (const Slot & slot : slots)
+        if (slot.hasData())
+            extents.push_back({ slot.dataPosition(), slot.dataPosition() + slot.size });
+    std::sort(std::begin(extents), std::end(extents));
+    static const size_t page_size{ static_cast<size_t>(sysconf(_SC_PAGESIZE)) };
+    for (size_t i = 0; i < extents.size();) {
+        const size_t start{ extents[i].first };
+        size_t stop{ extents[i].second };
+        for (++i; i < extents.size() && extents[i].first <= stop + cfg::REGION_PREFETCH_GAP; ++i)
+            stop = std::max(stop, size_t{ extents[i].second });
+        stats.syscalls.fetch_add(1);
+        if (mapping != nullptr) {
+            const size_t page_start{ start / page_size * page_size };
+            madvise(mapping + page_start, stop - page_start, MADV_WILLNEED);
+        } else {
+            posix_fadvise(fd, start, stop - start, POSIX_FADV_WILLNEED);
+        }
+    }
+}
+
+std::vector<Region::Slot> Region::readOldSlots(cfg::RegUint version) {
+    static constexpr auto ZLIB = static_cast<cfg::RegUint>(codec::CodecType::ZLIB);
+    std::vector<Slot> slots(cfg::REGION_VOLUME);
+    if (version == 0) {
+        std::vector<cfg::RegUint> table(2 * cfg::REGION_VOLUME);
+        read(table.data(), table.size() * sizeof(cfg::RegUint), 2 * sizeof(cfg::RegUint));
+        for (cfg::RegUint i = 0; i < cfg::REGION_VOLUME; ++i)
+            slots[i] = { table[2 * i], table[2 * i + 1], table[2 * i + 1], ZLIB, 0 };
+    } else if (version == 2 || version == 3) {
+        std::vector<cfg::RegUint> table(4 * cfg::REGION_VOLUME);
+        read(table.data(), table.size() * sizeof(cfg::RegUint), OLD_HEADER_INFO_SIZE);
+        for (cfg::RegUint i = 0; i < cfg::REGION_VOLUME; ++i)
+            slots[i] = { table[4 * i], table[4 * i + 1], table[4 * i + 2], table[4 * i + 3], 0 };
+    } else if (version == 1) {
+        std::vector<cfg::RegUint> table(3 * cfg::REGION_VOLUME);
+        read(table.data(), table.size() * sizeof(cfg::RegUint), OLD_HEADER_INFO_SIZE);
+        for (cfg::RegUint i = 0; i < cfg::REGION_VOLUME; ++i)
+            slots[i] = { table[3 * i], table[3 * i + 1], table[3 * i + 2], ZLIB, 0 };
+    } else {
+        throw std::runtime_error("Unsupported region file version.");
+    }
+    return slots;
+}
+
+cfg::RegUint Region::capacityFor(cfg::RegUint size) {
+    const cfg::RegUint with_slack = size + size / cfg::REGION_SLOT_SLACK_DIVISOR;
+    return 2 * ((with_slack + cfg::REGION_SLOT_GRANULARITY - 1) / cfg::REGION_SLOT_GRANULARITY * cfg::REGION_SLOT_GRANULARITY);
+}
+
+void Region::saveChunk(cfg::RegUint chunk_index, const cfg::Block * chunk, Scratch & scratch) {
+    // chunk[i] == chunk[i + 1] for all i
+    if (std::memcmp(chunk, chunk + 1, (cfg::CHUNK_VOLUME - 1) * sizeof(cfg::Block)) == 0) {
+        saveUniformChunk(chunk_index, chunk[0], scratch);
+        return;
+    }
+
+    cfg::RegByte * const buffer{ scratch.buffer.get() };
+    const codec::Codec chunk_codec{ codec::getDefault() };
+    const cfg::RegByte * data;
+    bool wide;
+    const size_t data_size{ serialize(chunk, scratch, data, wide) };
+    // dictionaries are trained on and only used for byte per block data
+    if (!wide)
+        dictionaries::sample(data);
+    // zstd compresses these chunks no better with a trained dictionary and saves at half the speed (bench dictionaries),
+    // chunks saved with one still load
+    const bool no_dictionary{ chunk_codec.type == codec::CodecType::RAW || chunk_codec.type == codec::CodecType::ZSTD || wide };
+    const codec::Dictionary * const dictionary{ no_dictionary ? nullptr : dictionaries::current() };
+    const size_t compressed_size = scratch.codec.compress(
+        chunk_codec,
+        buffer, cfg::COMPRESS_BUFFER_SIZE_IN_BYTES,
+        data, data_size,
+        dictionary
     );
-    if (compression_result != Z_OK)
+    if (compressed_size == 0)
         throw std::runtime_error("Failed to compress chunk.");
+    const cfg::RegUint data_checksum{ codec::checksum(buffer, compressed_size) };
+    const cfg::RegUint slot_dictionary{ dictionary != nullptr ? dictionary->id : 0 };
 
-    std::array<cfg::RegUint, 2> ops; // old position, size
     // locking shared is safe assuming no other thread will access loaded version
     // or the in region version of the chunk
     std::shared_lock<std::shared_mutex> lock{ mutex };
-    read(ops.data(), sizeof(cfg::RegUint) * ops.size(), (2 + 2 * chunk_index) * sizeof(cfg::RegUint));
+    Slot & slot = slots[chunk_index];
     const cfg::RegUint new_size = compressed_size;
-    const int64_t size_difference = static_cast<int64_t>(ops[1]) - static_cast<int64_t>(new_size);
-    if (size_difference < 0) {
-        // update garbage and end
-        const cfg::RegUint old_end = end.fetch_add(new_size);
-        garbage.fetch_add(ops[1]);
-        // append in file
-        std::array<cfg::RegUint, 2> nps{ old_end, new_size }; // new position, size
-        // write chunk
-        write(buffer.get(), new_size, old_end);
-        // write position and size
-        write(nps.data(), 2 * sizeof(cfg::RegUint), (2 + 2 * chunk_index) * sizeof(cfg::RegUint));
-
+    const cfg::RegUint half{ slot.capacity / 2 };
+    const bool second{ Slot::secondOf(slot.codec) };
+    stats.saves.fetch_add(1);
+    if (slot.hasData() && new_size > slot.size)
+        stats.grown.fetch_add(1);
+    // the half the last commit points to is never written, data written since then is replaced where it is
+    // (version 7 data can be larger than the first half, the second one isn't free then)
+    bool fits{ false };
+    bool new_second{ second };
+    if (slot.hasData() && new_size <= half) {
+        if (uncommitted[chunk_index]) {
+            fits = true;
+        } else if (second || slot.size <= half) {
+            fits = true;
+            new_second = !second;
+        }
+    }
+    if (fits) {
+        const cfg::RegUint new_position{ slot.position + (new_second ? half : 0) };
+        write(buffer, new_size, new_position);
+        slot = { slot.position, new_size, slot.capacity, Slot::codecValue(chunk_codec.type, slot_dictionary, wide, new_second), data_checksum };
     } else {
-        // replace
-        // TODO: replace 'uint32: size' with 'uint16: size, uint16: capacity' to be able to use in-place more often
-        // write chunk
-        write(buffer.get(), new_size, ops[0]);
-        // write size
-        write(&new_size, sizeof(new_size), (2 + 2 * chunk_index + 1) * sizeof(cfg::RegUint));
-        // set garbage size
-        garbage.fetch_add(static_cast<cfg::RegUint>(size_difference));
+        // append in file with a fresh size class into the first half, old slot becomes garbage
+        const cfg::RegUint new_capacity = capacityFor(new_size);
+        const cfg::RegUint new_position = allocate(new_capacity);
+        release(slot.position, slot.capacity);
+        stats.appends.fetch_add(1);
+        write(buffer, new_size, new_position);
+        slot = { new_position, new_size, new_capacity, Slot::codecValue(chunk_codec.type, slot_dictionary, wide, false), data_checksum };
     }
+    uncommitted[chunk_index] = 1;
+    slots_dirty.store(true);
 
     lock.unlock();
 
+    afterSave(scratch);
+//    Print("saved :)");
+}
 
+void Region::saveUniformChunk(cfg::RegUint chunk_index, cfg::Block block, Scratch & scratch) {
+    std::shared_lock<std::shared_mutex> lock{ mutex };
+    Slot & slot = slots[chunk_index];
+    stats.saves.fetch_add(1);
+    stats.uniform.fetch_add(1);
+    // no chunk data, reserved space is kept
+    slot = { slot.position, block, slot.capacity, Slot::UNIFORM, 0 };
+    slots_dirty.store(true);
+    lock.unlock();
+
+    afterSave(scratch);
+}
+
+void Region::afterSave(Scratch & scratch) {
     // "double checked locking" (defragment will lock unique and check garbage again before defragmenting
-    // in case someone already defragmented between garbage.load() and defragment())
-    if (garbage.load() >= cfg::DEFRAGMENT_GARBAGE_THRESHOLD)
-        defragment();
-//    Print("saved :)");
+    // in case someone already defragmented between needsDefragment() and defragment())
+    if (needsDefragment())
+        defragment(scratch);
+    if (saves_since_checkpoint.fetch_add(1) + 1 == cfg::REGION_CHECKPOINT_INTERVAL)
+        checkpoint();
+}
+
+size_t Region::liveBytes() {
+    std::unique_lock<std::shared_mutex> lock{ mutex };
+    size_t result{ 0 };
+    for (const auto & slot : slots)
+        if (slot.hasData())
+            result += slot.size;
+    return result;
 }
 
-void Region::defragment() {
+bool Region::needsDefragment() const {
+    // the whole region is rewritten, so wait until that's worth it
+    const size_t current_garbage{ garbage.load() };
+    return current_garbage >= cfg::DEFRAGMENT_GARBAGE_THRESHOLD &&
+        current_garbage * 100 >= (size_t(end.load()) - HEADER_SIZE) * cfg::DEFRAGMENT_GARBAGE_PERCENT;
+}
+
+void Region::defragment(Scratch & scratch) {
     // double checked locking (see caller function)
+    // unique lock keeps loadChunk() and saveChunk() out while payloads are moved
     std::unique_lock<std::shared_mutex> lock{ mutex };
-    if (garbage.load() < cfg::DEFRAGMENT_GARBAGE_THRESHOLD)
+    if (!needsDefragment())
         return;
-    
-    // TODO: implement defragmenting
-
-
-
-
-/*
-        assert(region != nullptr);
-    
-    uint32_t * raw_start = m_defragment_buffer_raw.get();
-    uint32_t * raw_end = raw_start + REGION_VOLUME * 2;
-    region->read(raw_start, REGION_VOLUME * 2 * sizeof(uint32_t), 2 * sizeof(uint32_t));
-    u32Vec3 * vec_start = m_defragment_buffer.get();
-    u32Vec3 * vec_end = vec_start; // will be set to correct value in loop
-    uint32_t index = 0;
-    for (uint32_t * raw = raw_start; raw != raw_end; raw += 2, ++index) {
-        if (*raw != 0) {
-            // x: index, y: position, z: size
-            vec_end->x = index;
-            vec_end->y = *raw;
-            vec_end->z = *(raw + 1);
-            ++vec_end;
+    // someone is reading chunk data, try again after one of the next saves
+    // (beginLoad() needs the shared lock, so this can't increase while locked)
+    if (pending_loads.load() != 0)
+        return;
+
+    rewrite(scratch.buffer.get());
+    stats.defragments.fetch_add(1);
+}
+
+void Region::rewrite(cfg::RegByte * buffer) {
+    std::array<char, 136> temp_name;
+    std::snprintf(std::begin(temp_name), temp_name.size(), "%s.tmp", file_name.data());
+    const int temp_fd = open(temp_name.data(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (temp_fd < 0)
+        throw std::runtime_error("Failed to create temporary region file.");
+
+    cfg::RegUint new_end = HEADER_SIZE;
+    for (auto & slot : slots) {
+        if (slot.position == 0)
+            continue;
+        assert(slot.uniform() || slot.size <= cfg::COMPRESS_BUFFER_SIZE_IN_BYTES);
+        // capacity is kept, uniform chunks keep their reserved space, data goes into the first half
+        if (!slot.uniform()) {
+            read(buffer, slot.size, slot.dataPosition());
+            pwrite(temp_fd, buffer, slot.size, new_end);
+            slot.codec &= ~Slot::SECOND;
         }
+        slot.position = new_end;
+        new_end += slot.capacity;
     }
 
-    // sort by position to prevent overwriting needed data
-    // (since everything will be moved towards position 0)
-    std::sort(vec_start, vec_end,
-        [](const u32Vec3 & a, const u32Vec3 & b) {
-            return a.y < b.y;
-        }
-    );
+    end.store(new_end);
+    garbage.store(0);
+    ++sequence;
+    writeHeader(temp_fd, sequence);
+    ftruncate(temp_fd, new_end);
+    // old file must not be replaced before the new one is complete
+    fsync(temp_fd);
+    if (rename(temp_name.data(), file_name.data()) != 0)
+        throw std::runtime_error("Failed to replace region file.");
+    syncDirectory("world");
 
-    uint8_t * buffer = m_compress_buffer.get();
-    uint32_t new_end = (2 * REGION_VOLUME + 2) * (uint32_t)sizeof(uint32_t);
-    for (u32Vec3 * i = vec_start; i != vec_end; ++i) {
-        // move to new location
-        assert(i->y < ((2 * REGION_VOLUME + 2) * (uint32_t)sizeof(uint32_t)));
-        assert(i->z <= c_maximum_compressed_size);
-        region->read(buffer, i->z, i->y);
-        region->write(buffer, i->z, new_end);
-        raw_start[2 * i->x] = new_end;
-        assert(raw_start[2 * i->x + 1] == i->z);
-        new_end += i->z;
-    }
+    const bool mapped{ mapping != nullptr };
+    if (mapped)
+        munmap(mapping, cfg::REGION_MMAP_RESERVE);
+    close(fd);
+    fd = temp_fd;
+    file_size.store(new_end);
+    slots_dirty.store(false);
+    std::fill(std::begin(uncommitted), std::end(uncommitted), 0);
+    stats.commits.fetch_add(1);
+    if (mapped)
+        map();
+}
 
-    region->garbage = 0;
-    region->end = new_end;
-    // write back header
-    region->write(raw_start, REGION_VOLUME * 2 * sizeof(uint32_t), 2 * sizeof(uint32_t));*/
+void Region::migrate() {
+    std::unique_ptr<cfg::RegByte[]> buffer{ std::make_unique<cfg::RegByte[]>(cfg::COMPRESS_BUFFER_SIZE_IN_BYTES) };
+    for (auto & slot : slots) {
+        if (slot.uniform()) {
+            // drop reserved space
+            slot.position = 0;
+            slot.capacity = 0;
+        } else if (slot.hasData()) {
+            assert(slot.size <= cfg::COMPRESS_BUFFER_SIZE_IN_BYTES);
+            slot.capacity = capacityFor(slot.size);
+            read(buffer.get(), slot.size, slot.position);
+            slot.checksum = codec::checksum(buffer.get(), slot.size);
+        }
+    }
+    rewrite(buffer.get());
 }
 
-bool Region::loadChunk(cfg::RegUint chunk_index, cfg::Block * chunk) {
+Region::LoadResult Region::loadChunk(cfg::RegUint chunk_index, cfg::Block * chunk, cfg::Block & uniform_block, Scratch & scratch) {
     std::shared_lock<std::shared_mutex> lock{ mutex };
-    std::array<cfg::RegUint, 2> ps;
-    read(ps.data(), sizeof(cfg::RegUint) * ps.size(), (2 + 2 * chunk_index) * sizeof(cfg::RegUint));
-    if (ps[0] != 0) { // if exists
-        assert(ps[1] > 0); // TODO: assert ps[1] < MAX_ALLOWED_SIZE
-        // TODO: replace with per-worker buffer already with allocated max needed size
-        std::unique_ptr<cfg::RegByte[]> buffer{ std::make_unique<cfg::RegByte[]>(ps[1]) };
-        read(buffer.get(), ps[1], ps[0]);
-        lock.unlock(); // don't need file anymore
-        uLongf uncompressed_size = cfg::CHUNK_VOLUME * sizeof(cfg::Block);
-        const auto decompression_result = uncompress(
-            chunk, &uncompressed_size,
-            buffer.get(), ps[1]
-        );
-        // TODO: handle differently?
-        if (decompression_result != Z_OK || uncompressed_size != cfg::CHUNK_VOLUME * sizeof(cfg::Block))
-            throw std::runtime_error("Broken save file I guess.");
+    const Slot slot{ slots[chunk_index] };
+    stats.loads.fetch_add(1);
+    if (slot.uniform()) {
+        uniform_block = static_cast<cfg::Block>(slot.size);
+        return LoadResult::UNIFORM;
+    } else if (slot.hasData()) {
+        assert(slot.size > 0 && slot.size <= cfg::COMPRESS_BUFFER_SIZE_IN_BYTES);
+        bool decompressed;
+        if (mapping != nullptr) {
+            // lock stays until done, defragment() could move the data
+            decompressed = decompress(slot.codec, slot.checksum, mapping + slot.dataPosition(), slot.size, chunk, scratch);
+            lock.unlock();
+        } else {
+            read(scratch.buffer.get(), slot.size, slot.dataPosition());
+            lock.unlock(); // don't need file anymore
+            decompressed = decompress(slot.codec, slot.checksum, scratch.buffer.get(), slot.size, chunk, scratch);
+        }
+        if (!decompressed)
+            return corrupt(chunk_index);
 //        Print("loaded :)");
-        return true;
+        return LoadResult::LOADED;
+    } else {
+        return LoadResult::MISSING;
+    }
+}
+
+Region::LoadResult Region::beginLoad(cfg::RegUint chunk_index, cfg::Block & uniform_block, PendingLoad & pending) {
+    std::shared_lock<std::shared_mutex> lock{ mutex };
+    const Slot slot{ slots[chunk_index] };
+    stats.loads.fetch_add(1);
+    if (slot.uniform()) {
+        uniform_block = static_cast<cfg::Block>(slot.size);
+        return LoadResult::UNIFORM;
+    } else if (slot.hasData()) {
+        assert(slot.size > 0 && slot.size <= cfg::COMPRESS_BUFFER_SIZE_IN_BYTES);
+        pending = { chunk_index, fd, slot.dataPosition(), slot.size, slot.codec, slot.checksum };
+        pending_loads.fetch_add(1);
+        return LoadResult::LOADED;
     } else {
+        return LoadResult::MISSING;
+    }
+}
+
+Region::LoadResult Region::finishLoad(const PendingLoad & pending, const cfg::RegByte * data, cfg::Block * chunk, Scratch & scratch) {
+    pending_loads.fetch_sub(1);
+    if (!decompress(pending.codec, pending.checksum, data, pending.size, chunk, scratch))
+        return corrupt(pending.chunk_index);
+    return LoadResult::LOADED;
+}
+
+size_t Region::serialize(const cfg::Block * chunk, Scratch & scratch, const cfg::RegByte * & data, bool & wide) {
+    if constexpr (sizeof(cfg::Block) == 1) {
+        data = reinterpret_cast<const cfg::RegByte *>(chunk);
+        wide = false;
+        return cfg::CHUNK_VOLUME;
+    } else {
+        cfg::RegByte * const bytes{ scratch.blocks.get() };
+        data = bytes;
+        wide = std::any_of(chunk, chunk + cfg::CHUNK_VOLUME, [](cfg::Block block) { return block > 0xff; });
+        for (cfg::Coord i = 0; i < cfg::CHUNK_VOLUME; ++i)
+            bytes[i] = static_cast<cfg::RegByte>(chunk[i]);
+        if (!wide)
+            return cfg::CHUNK_VOLUME;
+        // planes compress better than interleaved bytes, the high plane is mostly a few values
+        for (cfg::Coord i = 0; i < cfg::CHUNK_VOLUME; ++i)
+            bytes[cfg::CHUNK_VOLUME + i] = static_cast<cfg::RegByte>(chunk[i] >> 8);
+        return 2 * size_t{ cfg::CHUNK_VOLUME };
+    }
+}
+
+bool Region::decompress(
+    cfg::RegUint slot_codec, cfg::RegUint data_checksum, const cfg::RegByte * data, cfg::RegUint size,
+    cfg::Block * chunk, Scratch & scratch
+) {
+    if (codec::checksum(data, size) != data_checksum)
         return false;
+    const codec::Dictionary * dictionary{ nullptr };
+    if (Slot::dictionaryOf(slot_codec) != 0) {
+        dictionary = dictionaries::get(Slot::dictionaryOf(slot_codec));
+        if (dictionary == nullptr)
+            return false;
+    }
+    const bool wide{ Slot::wideOf(slot_codec) };
+    if constexpr (sizeof(cfg::Block) == 1) {
+        // written by a build with wider blocks
+        if (wide)
+            return false;
+        return scratch.codec.decompress(
+            Slot::codecTypeOf(slot_codec), chunk, cfg::CHUNK_VOLUME, data, size, dictionary
+        );
+    } else {
+        cfg::RegByte * const bytes{ scratch.blocks.get() };
+        if (!scratch.codec.decompress(
+            Slot::codecTypeOf(slot_codec), bytes, (wide ? 2 : 1) * size_t{ cfg::CHUNK_VOLUME }, data, size, dictionary
+        ))
+            return false;
+        if (wide) {
+            for (cfg::Coord i = 0; i < cfg::CHUNK_VOLUME; ++i)
+                chunk[i] = static_cast<cfg::Block>(bytes[i] | bytes[cfg::CHUNK_VOLUME + i] << 8);
+        } else {
+            std::copy(bytes, bytes + cfg::CHUNK_VOLUME, chunk);
+        }
+        return true;
+    }
+}
+
+Region::LoadResult Region::corrupt(cfg::RegUint chunk_index) {
+    stats.corrupt.fetch_add(1);
+    Print("Chunk ", chunk_index, " of region ", file_name.data(), " is corrupt, regenerating it.");
+    return LoadResult::CORRUPT;
+}
+
+Region::ScanResult Region::scan(const char * file_name, cfg::RegByte * buffer, size_t buffer_size) {
+    assert(buffer_size >= cfg::COMPRESS_BUFFER_SIZE_IN_BYTES);
+    ScanResult result{ false, 0, 0, {}, 0 };
+    const int file = open(file_name, O_RDONLY);
+    if (file < 0)
+        return result;
+    struct stat file_info;
+    fstat(file, &file_info);
+    HeaderInfo info;
+    std::vector<Slot> table(cfg::REGION_VOLUME);
+    result.valid_header = readLatestHeader(file, file_info.st_size, VERSION, info, table);
+    result.bytes = std::min(size_t(file_info.st_size), size_t(HEADER_SIZE));
+    if (!result.valid_header) {
+        close(file);
+        return result;
+    }
+
+    // go through the file front to back in large reads
+    posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+    std::vector<cfg::RegUint> order;
+    for (cfg::RegUint i = 0; i < cfg::REGION_VOLUME; ++i) {
+        if (table[i].uniform())
+            ++result.uniform_chunks;
+        else if (table[i].hasData())
+            order.push_back(i);
+    }
+    std::sort(std::begin(order), std::end(order), [&table](cfg::RegUint a, cfg::RegUint b) {
+        return table[a].dataPosition() < table[b].dataPosition();
+    });
+    size_t window_position{ 0 };
+    size_t window_size{ 0 };
+    for (const cfg::RegUint i : order) {
+        const Slot & slot = table[i];
+        ++result.chunks;
+        const size_t slot_end{ size_t(slot.dataPosition()) + slot.size };
+        if (slot.dataPosition() < window_position || slot_end > window_position + window_size) {
+            window_position = slot.dataPosition();
+            const ssize_t count{ pread(file, buffer, buffer_size, window_position) };
+            window_size = count > 0 ? count : 0;
+            result.bytes += window_size;
+        }
+        // past the end of the file if still not in the window
+        if (slot_end > window_position + window_size ||
+            codec::checksum(buffer + (slot.dataPosition() - window_position), slot.size) != slot.checksum)
+            result.corrupt_chunks.push_back(i);
     }
+    close(file);
+    return result;
 }
@@ -1,10 +1,16 @@
 #pragma once
 
 #include <shared_mutex>
+#include <mutex>
 #include <atomic>
+#include <array>
+#include <vector>
 #include <cstdint>
+#include <memory>
 #include <glm/vec3.hpp>
 #include "cfg.hpp"
+#include "Codec.hpp"
+#include "WorldFile.hpp"
 
 class Region {
 public:
@@ -14,9 +20,66 @@ public:
     Region & operator = (const Region &) = delete;
     Region & operator = (Region &&) = delete;
 
-    // only called by workers and ~ChunkContainer()
-    void saveChunk(cfg::RegUint chunk_index, const cfg::Block * chunk);
-    bool loadChunk(cfg::RegUint chunk_index, cfg::Block * chunk);
+    // memory for compressed chunk data and codec state, with it loads and saves don't allocate
+    // one per thread calling saveChunk(), loadChunk() or finishLoad()
+    struct Scratch {
+        Scratch() :
+            buffer{ std::make_unique<cfg::RegByte[]>(cfg::COMPRESS_BUFFER_SIZE_IN_BYTES) },
+            blocks{ std::make_unique<cfg::RegByte[]>(cfg::CHUNK_VOLUME * sizeof(cfg::Block)) } {}
+        std::unique_ptr<cfg::RegByte[]> buffer;
+        // chunk data before compressing and after decompressing (see Slot::WIDE)
+        std::unique_ptr<cfg::RegByte[]> blocks;
+        codec::Context codec;
+    };
+
+    // only called by ChunkWriter and ChunkIO
+    void saveChunk(cfg::RegUint chunk_index, const cfg::Block * chunk, Scratch & scratch);
+    enum class LoadResult { MISSING, LOADED, UNIFORM, CORRUPT };
+    // UNIFORM: chunk is not touched, every block of the chunk is uniform_block
+    // CORRUPT: chunk data doesn't match its checksum or doesn't decompress, chunk content is undefined
+    //          (regenerate it, saving replaces the broken data)
+    LoadResult loadChunk(cfg::RegUint chunk_index, cfg::Block * chunk, cfg::Block & uniform_block, Scratch & scratch);
+
+    // loadChunk() split in two for callers reading the chunk data themselves (ChunkIO)
+    // LOADED: size bytes at position of fd have to be read and handed to finishLoad(), the data
+    //         is not moved until then (defragment() is postponed)
+    // MISSING and UNIFORM: same as loadChunk(), finishLoad() must not be called
+    struct PendingLoad {
+        cfg::RegUint chunk_index;
+        int fd;
+        cfg::RegUint position;
+        cfg::RegUint size;
+        cfg::RegUint codec;
+        cfg::RegUint checksum;
+    };
+    LoadResult beginLoad(cfg::RegUint chunk_index, cfg::Block & uniform_block, PendingLoad & pending);
+    // returns LOADED or CORRUPT
+    LoadResult finishLoad(const PendingLoad & pending, const cfg::RegByte * data, cfg::Block * chunk, Scratch & scratch);
+
+    // PREAD: pread()/pwrite() on the file
+    // MMAP: whole file mapped (cfg::REGION_MMAP_RESERVE address space), grown in cfg::REGION_MMAP_EXTENT steps,
+    //       chunks are decompressed straight out of the mapping
+    enum class Backend { PREAD, MMAP };
+    // backend used by regions opened after this call
+    static void setDefaultBackend(Backend backend);
+    static Backend getDefaultBackend();
+
+    // FILES: a file per region (world/x|y|z)
+    // WORLD_FILES: regions share cfg::WORLD_FILE_COUNT WorldFiles, the slot table is stored in the world file
+    //              and chunk data in extents allocated from it, Backend::MMAP and defragment() are not used
+    enum class Storage { FILES, WORLD_FILES };
+    // storage used by regions opened after this call, a world has to be saved with the same storage every time
+    static void setDefaultStorage(Storage storage);
+    static Storage getDefaultStorage();
+
+    // commits the region: waits until all saves so far are on disk and writes a new header
+    // also done on close and every cfg::REGION_CHECKPOINT_INTERVAL saves (group commit)
+    // after a crash the region is opened as of its last commit, later saves are lost
+    void checkpoint();
+
+    // asks the kernel to read the chunk data of the region into the page cache (posix_fadvise() or madvise()),
+    // returns without waiting for it
+    void prefetch();
 
     // only call these from RegionContainer
     Region(const glm::tvec3<cfg::Coord> & region_position);
@@ -25,17 +88,196 @@ public:
     void refCountIncrement();
     void refCountDecrement();
 
+    // file layout (version 8):
+    // 2 * (magic, version, sequence, end, garbage, checksum, REGION_VOLUME * Slot), chunk data ...
+    // a commit writes the header into the copy not holding the latest one, opening uses the valid copy
+    // (checksum over the rest of the copy matches) with the higher sequence
+    // chunk data a committed header points to is never overwritten, so a crash can't corrupt it
+    // version 7: same, but chunk data always at the start of the reserved space (no Slot::SECOND)
+    // version 6: same, but chunk data always holds 8 bit blocks
+    // version 5: same, but Slot::codec without dictionary
+    // version 4: same, but Slot without checksum
+    // version 3: magic, version, end, garbage, REGION_VOLUME * Slot, chunk data ...
+    // version 2: same as 3, but without uniform slots
+    // version 1: same, but Slot without codec (always zlib)
+    // version 0 (no magic): end, garbage, REGION_VOLUME * (position, size), chunk data ...
+    static constexpr cfg::RegUint MAGIC{ 0x47525856 }; // "VXRG"
+    static constexpr cfg::RegUint VERSION{ 8 };
+
+    struct Slot {
+        cfg::RegUint position; // 0 if chunk not in region
+        cfg::RegUint size;
+        // reserved space starting at position, two halves the chunk data takes turns in (see saveChunk()),
+        // chunk can be rewritten without moving while size <= capacity / 2
+        cfg::RegUint capacity;
+        // codec::CodecType the chunk data was compressed with in the low byte,
+        // id of the dictionary (see Dictionaries.hpp) above, 0 for none, WIDE and SECOND
+        cfg::RegUint codec;
+        cfg::RegUint checksum; // codec::checksum() of the chunk data
+
+        // codec value for chunks made of a single block, size holds the block, there is no chunk data
+        // position and capacity still hold the reserved space (if any) for when the chunk stops being uniform
+        static constexpr cfg::RegUint UNIFORM{ 0xff };
+        bool uniform() const { return codec == UNIFORM; }
+        bool stored() const { return position != 0 || uniform(); }
+        bool hasData() const { return position != 0 && !uniform(); }
+        // chunk data is in the second half of the reserved space
+        static constexpr cfg::RegUint SECOND{ cfg::RegUint{ 1 } << 30 };
+        cfg::RegUint dataPosition() const { return position + (secondOf(codec) ? capacity / 2 : 0); }
+        // chunk data is a byte per block if every block of the chunk is below 256, with WIDE it is the low
+        // bytes of all blocks followed by the high bytes (16 bit blocks only)
+        static constexpr cfg::RegUint WIDE{ cfg::RegUint{ 1 } << 31 };
+        static cfg::RegUint codecValue(codec::CodecType type, uint32_t dictionary, bool wide, bool second) {
+            return static_cast<cfg::RegUint>(type) | dictionary << 8 | (wide ? WIDE : 0) | (second ? SECOND : 0);
+        }
+        static codec::CodecType codecTypeOf(cfg::RegUint value) { return static_cast<codec::CodecType>(value & 0xff); }
+        static uint32_t dictionaryOf(cfg::RegUint value) { return (value & ~(WIDE | SECOND)) >> 8; }
+        static bool wideOf(cfg::RegUint value) { return (value & WIDE) != 0; }
+        // false for uniform chunks
+        static bool secondOf(cfg::RegUint value) { return value != UNIFORM && (value & SECOND) != 0; }
+    };
+
+    struct Statistics {
+        std::atomic<size_t> saves{ 0 };
+        std::atomic<size_t> appends{ 0 };
+        // saves that were larger than the previous version of the chunk
+        std::atomic<size_t> grown{ 0 };
+        std::atomic<size_t> garbage_bytes{ 0 };
+        std::atomic<size_t> uniform{ 0 };
+        std::atomic<size_t> loads{ 0 };
+        // pread() and pwrite() calls
+        std::atomic<size_t> syscalls{ 0 };
+        std::atomic<size_t> commits{ 0 };
+        // rewrites of the region file because of garbage (commits too)
+        std::atomic<size_t> defragments{ 0 };
+        // loads that returned LoadResult::CORRUPT
+        std::atomic<size_t> corrupt{ 0 };
+    };
+    const Statistics & statistics() const { return stats; }
+    // sum of payload sizes of all chunks in this region
+    size_t liveBytes();
+
+    // rounds up to the size class a slot of this size gets allocated with, both halves
+    static cfg::RegUint capacityFor(cfg::RegUint size);
+
+    struct ScanResult {
+        // false if the file has no valid header of the current version, nothing else is checked then
+        bool valid_header;
+        size_t chunks;
+        size_t uniform_chunks;
+        // indices of chunks whose data doesn't match its checksum
+        std::vector<cfg::RegUint> corrupt_chunks;
+        // file bytes read
+        size_t bytes;
+    };
+    // checks the file of a region that is not open against its checksums, nothing is written
+    // reads the chunk data front to back in blocks of buffer_size, buffer_size must be at least
+    // cfg::COMPRESS_BUFFER_SIZE_IN_BYTES
+    static ScanResult scan(const char * file_name, cfg::RegByte * buffer, size_t buffer_size);
+
+    struct HeaderInfo {
+        cfg::RegUint magic;
+        cfg::RegUint version;
+        // incremented every commit, the copy written is sequence % 2
+        cfg::RegUint sequence;
+        cfg::RegUint end;
+        cfg::RegUint garbage;
+        // codec::checksum() of everything before it and the slot table
+        cfg::RegUint checksum;
+    };
+    static constexpr cfg::RegUint HEADER_INFO_SIZE{ sizeof(HeaderInfo) };
+    static constexpr cfg::RegUint HEADER_COPY_SIZE{ HEADER_INFO_SIZE + cfg::REGION_VOLUME * sizeof(Slot) };
+    // chunk data starts here
+    static constexpr cfg::RegUint HEADER_SIZE{ 2 * HEADER_COPY_SIZE };
+    static_assert(sizeof(Slot) == 5 * sizeof(cfg::RegUint));
+    static_assert(sizeof(HeaderInfo) == 6 * sizeof(cfg::RegUint));
+
 private:
+    // versions before 4 have a single header, starting with magic, version, end, garbage
+    static constexpr cfg::RegUint OLD_HEADER_INFO_SIZE{ 4 * sizeof(cfg::RegUint) };
+    // slots of versions before 5 have no checksum
+    static constexpr cfg::RegUint OLD_SLOT_SIZE{ 4 * sizeof(cfg::RegUint) };
+
     // TODO: shared lock
     std::shared_mutex mutex;
     size_t ref_count;
+    // with Storage::WORLD_FILES the fd of world_file, not owned
     int fd;
+    std::array<char, 128> file_name;
     // TODO: atomic garbage and end
     std::atomic<cfg::RegUint> garbage;
     std::atomic<cfg::RegUint> end;
+    // nullptr when using Backend::PREAD
+    cfg::RegByte * mapping;
+    std::atomic<size_t> file_size;
+    std::mutex grow_mutex;
+    // whole slot table, only the file data is accessed for chunk loads and saves
+    // a slot is only modified by the thread saving that chunk (or with unique lock)
+    std::vector<Slot> slots;
+    // per slot, chunk data was written since the last commit (the committed header doesn't point to it)
+    // only then a chunk is rewritten in the same half, otherwise it goes into the other one
+    std::vector<uint8_t> uncommitted;
+    // of the latest header
+    cfg::RegUint sequence;
+    std::atomic_bool slots_dirty;
+    std::atomic<size_t> saves_since_checkpoint;
+    // beginLoad() calls without finishLoad() yet
+    std::atomic<size_t> pending_loads;
+    Statistics stats;
+    // nullptr when using Storage::FILES
+    WorldFile * world_file;
+    glm::tvec3<cfg::Coord> region_position;
+    // extents of world_file not used anymore, given back to it by the next commit
+    std::vector<WorldFile::Extent> freed;
+    std::mutex freed_mutex;
 
     void read(void * buffer, cfg::RegUint count, cfg::RegUint position);
     void write(const void * buffer, cfg::RegUint count, cfg::RegUint position);
-    void defragment();
+    // grows the file for the mapping to at least size bytes
+    void reserve(size_t size);
+    void map();
+    // space for chunk data, appended to the file or allocated from world_file
+    cfg::RegUint allocate(cfg::RegUint capacity);
+    // chunk data at position is not used anymore, garbage or freed
+    void release(cfg::RegUint position, cfg::RegUint capacity);
+    // fdatasync(), also writes back what was written through the mapping
+    void sync();
+    // call with unique lock
+    void commit();
+    static cfg::RegUint headerChecksum(const HeaderInfo & info, const void * table, size_t table_size);
+    // writes a header copy with the current slots, end and garbage to file (PREAD backend only) or the region
+    void writeHeader(int file, cfg::RegUint header_sequence);
+    // header copies of file versions 4 and up, slots of older versions are converted (without checksum)
+    // returns false if the copy is not valid
+    static bool readHeader(int file, cfg::RegUint version, cfg::RegUint copy, HeaderInfo & info, std::vector<Slot> & table);
+    // reads the latest valid header, returns false if there is none
+    static bool readLatestHeader(int file, size_t file_length, cfg::RegUint version, HeaderInfo & info, std::vector<Slot> & table);
+    // sets slots, end, garbage and sequence from the latest valid header of this version
+    bool useLatestHeader(size_t file_length, cfg::RegUint version);
+    static cfg::RegUint headerCopySize(cfg::RegUint version);
+    // chunk data of chunk into scratch.blocks (or chunk itself with 8 bit blocks), returns its size, wide is set
+    // if the chunk needs Slot::WIDE
+    static size_t serialize(const cfg::Block * chunk, Scratch & scratch, const cfg::RegByte * & data, bool & wide);
+    // checks and decompresses chunk data, false if it is broken (or its dictionary is missing, or it is
+    // Slot::WIDE with 8 bit blocks)
+    bool decompress(
+        cfg::RegUint slot_codec, cfg::RegUint data_checksum, const cfg::RegByte * data, cfg::RegUint size,
+        cfg::Block * chunk, Scratch & scratch
+    );
+    // counts and reports a broken chunk, returns LoadResult::CORRUPT
+    LoadResult corrupt(cfg::RegUint chunk_index);
+    // reads the slot table of an older file version
+    std::vector<Slot> readOldSlots(cfg::RegUint version);
+    void saveUniformChunk(cfg::RegUint chunk_index, cfg::Block block, Scratch & scratch);
+    bool needsDefragment() const;
+    // defragments and checkpoints when needed, call without lock
+    void afterSave(Scratch & scratch);
+    void defragment(Scratch & scratch);
+    // writes the chunk data of slots packed (capacity kept) into a new file with a committed header
+    // and replaces the region file with it, a crash leaves either the old or the new file
+    void rewrite(cfg::RegByte * buffer);
+    // converts slots read from an older file version and rewrites the region in the current format
+    // checksums are made from the data as it is
+    void migrate();
 
 };
@@ -1,45 +1,96 @@
 #include "RegionContainer.hpp"
 #include "Print.hpp"
 
-Region & RegionContainer::get(const Key & key) {
-    std::lock_guard<std::mutex> lock{ m_mutex };
-    const auto entry = m_map.find(key);
-    decltype(m_used.begin()) iterator;
-    if (entry == m_map.end()) {
-        while (m_map.size() >= cfg::REGION_CACHE_SIZE && m_lru.size() > 0) {
-            m_map.erase(m_lru.back().first);
-            m_lru.pop_back();
-        }
+RegionContainer::Shard & RegionContainer::shardOf(const Key & key) {
+    // fibonacci hashing, the high bits of the product depend on all bits of the hash
+    const uint64_t hash{ static_cast<uint64_t>(Math::VecKeyHash<cfg::Coord>{}(key)) * 0x9e3779b97f4a7c15u };
+    return m_shards[(hash >> 32) % m_shards.size()];
+}
+
+bool RegionContainer::evict(Shard & shard) {
+    if (shard.lru.empty())
+        return false;
+    if (shard.lru.back().prefetched)
+        m_stats.prefetch_unused.fetch_add(1);
+    // closing commits the region, other threads wanting it wait for the shard lock until that is done
+    shard.map.erase(shard.lru.back().key);
+    shard.lru.pop_back();
+    m_size.fetch_sub(1);
+    return true;
+}
+
+RegionContainer::Iterator RegionContainer::open(Shard & shard, const Key & key) {
+    while (m_size.load() >= cfg::REGION_CACHE_SIZE && evict(shard));
+    // try the other shards without waiting, regions are only closed while holding their shard lock
+    for (size_t i = 0; i < m_shards.size() && m_size.load() >= cfg::REGION_CACHE_SIZE; ++i) {
+        Shard & other = m_shards[i];
+        if (&other == &shard)
+            continue;
+        std::unique_lock<std::mutex> other_lock{ other.mutex, std::try_to_lock };
+        if (other_lock.owns_lock())
+            while (m_size.load() >= cfg::REGION_CACHE_SIZE && evict(other));
+    }
+
+    if (m_size.load() >= cfg::REGION_CACHE_SIZE)
+        Print("Warning region map full.");
 
-        if (m_map.size() >= cfg::REGION_CACHE_SIZE)
-            Print("Warning region map full.");
-
-        // create new region class
-        m_used.emplace_front(
-            std::piecewise_construct,
-            std::forward_as_tuple(key),
-            std::forward_as_tuple(key)
-        );
-        iterator = m_used.begin();
-        m_map.insert({ key, iterator });
+    // create new region class
+    shard.used.emplace_front(key);
+    shard.map.insert({ key, shard.used.begin() });
+    m_size.fetch_add(1);
+    return shard.used.begin();
+}
+
+Region & RegionContainer::get(const Key & key) {
+    Shard & shard = shardOf(key);
+    std::lock_guard<std::mutex> lock{ shard.mutex };
+    const auto entry = shard.map.find(key);
+    Iterator iterator;
+    if (entry == shard.map.end()) {
+        m_stats.misses.fetch_add(1);
+        iterator = open(shard, key);
     } else {
         // get existing region class
+        m_stats.hits.fetch_add(1);
         iterator = entry->second;
-        if (iterator->second.refCountGet() == 0)
+        if (iterator->prefetched) {
+            m_stats.prefetch_hits.fetch_add(1);
+            iterator->prefetched = false;
+        }
+        if (iterator->region.refCountGet() == 0)
             // if it is unused, move from lru to used list
-            m_used.splice(m_used.begin(), m_lru, iterator);
+            shard.used.splice(shard.used.begin(), shard.lru, iterator);
     }
-    iterator->second.refCountIncrement();
-    return iterator->second;
+    iterator->region.refCountIncrement();
+    return iterator->region;
 }
 
 void RegionContainer::release(const Key & key) {
-    std::lock_guard<std::mutex> lock{ m_mutex };
-    const auto entry = m_map.find(key);
-    assert(entry != m_map.end());
-    Region & region = entry->second->second;
+    Shard & shard = shardOf(key);
+    std::lock_guard<std::mutex> lock{ shard.mutex };
+    const auto entry = shard.map.find(key);
+    assert(entry != shard.map.end());
+    Region & region = entry->second->region;
     assert(region.refCountGet() > 0);
     region.refCountDecrement();
     if (region.refCountGet() == 0)
-        m_lru.splice(m_lru.begin(), m_used, entry->second);
+        shard.lru.splice(shard.lru.begin(), shard.used, entry->second);
+}
+
+void RegionContainer::prefetch(const Key & key) {
+    Region * region;
+    {
+        Shard & shard = shardOf(key);
+        std::lock_guard<std::mutex> lock{ shard.mutex };
+        if (shard.map.find(key) != shard.map.end())
+            return;
+        const Iterator iterator{ open(shard, key) };
+        iterator->prefetched = true;
+        m_stats.prefetched.fetch_add(1);
+        // held while reading ahead without the lock
+        iterator->region.refCountIncrement();
+        region = &iterator->region;
+    }
+    region->prefetch();
+    release(key);
 }
@@ -3,22 +3,66 @@
 #include <mutex>
 #include <unordered_map>
 #include <list>
+#include <array>
+#include <atomic>
 #include "Region.hpp"
 #include "cfg.hpp"
 
+// open regions, split into cfg::REGION_CONTAINER_SHARD_COUNT shards by position, each with its own lock,
+// so workers using different regions don't wait for each other (or for a region being opened or closed)
+// regions are closed once more than cfg::REGION_CACHE_SIZE are open, least recently released first
+// (per shard, when the shard of the new region has no unused ones the other shards are tried)
 class RegionContainer {
 private:
     using Key = glm::tvec3<cfg::Coord>;
     using Val = Region;
-    using ListEntry = std::pair<Key, Val>;
-    std::list<ListEntry> m_used;
-    std::list<ListEntry> m_lru;
-    using Iterator = typename decltype(m_lru)::iterator;
-    std::unordered_map<Key, Iterator, Math::VecKeyHash<cfg::Coord>, Math::VecKeyEqual<cfg::Coord>> m_map;
-    std::mutex m_mutex;
+    struct Entry {
+        Entry(const Key & key) : key{ key }, region{ key }, prefetched{ false } {}
+        Key key;
+        Val region;
+        // opened by prefetch() and not used by get() yet
+        bool prefetched;
+    };
+    using Iterator = typename std::list<Entry>::iterator;
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::list<Entry> used;
+        std::list<Entry> lru;
+        std::unordered_map<Key, Iterator, Math::VecKeyHash<cfg::Coord>, Math::VecKeyEqual<cfg::Coord>> map;
+    };
+    std::array<Shard, cfg::REGION_CONTAINER_SHARD_COUNT> m_shards;
+    // open regions of all shards
+    std::atomic<size_t> m_size{ 0 };
 
 public:
     Region & get(const Key & key);
     void release(const Key & key);
+    // opens the region if it isn't open yet and reads ahead its chunk data (Region::prefetch())
+    // it is kept open like a released region
+    void prefetch(const Key & key);
+
+    struct Statistics {
+        // get() calls that found the region open
+        std::atomic<size_t> hits{ 0 };
+        // get() calls that had to open the region
+        std::atomic<size_t> misses{ 0 };
+        // regions opened by prefetch()
+        std::atomic<size_t> prefetched{ 0 };
+        // prefetched regions get() found before anyone else used them
+        std::atomic<size_t> prefetch_hits{ 0 };
+        // prefetched regions closed without being used
+        std::atomic<size_t> prefetch_unused{ 0 };
+    };
+    const Statistics & statistics() const { return m_stats; }
+
+private:
+    Statistics m_stats;
+
+    Shard & shardOf(const Key & key);
+    // closes the least recently released region of shard, call with lock of shard
+    bool evict(Shard & shard);
+    // makes room and opens a region into the used list, call with lock of shard
+    Iterator open(Shard & shard, const Key & key);
 
 };
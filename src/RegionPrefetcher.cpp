@@ -0,0 +1,55 @@
+#include "RegionPrefetcher.hpp"
+
+#include <glm/glm.hpp>
+
+RegionPrefetcher::RegionPrefetcher(RegionContainer & region_container) :
+    m_region_container{ region_container }
+{
+    m_center_chunk = { 0, 0, 0 };
+    m_direction = { 0, 0, 0 };
+    m_running = true;
+    m_thread = std::thread{ &RegionPrefetcher::prefetcher, this };
+}
+
+RegionPrefetcher::~RegionPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_running = false;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+void RegionPrefetcher::moveCenterChunk(const glm::tvec3<cfg::Coord> & center_chunk) {
+    if (glm::all(glm::equal(center_chunk, m_center_chunk)))
+        return;
+    m_direction = glm::sign(center_chunk - m_center_chunk);
+    m_center_chunk = center_chunk;
+
+    const auto area = Math::toAABB3(m_center_chunk + m_direction * cfg::REGION_PREFETCH_DISTANCE, cfg::CHUNK_LOADING_RADIUS);
+    const auto first = Math::floor_div(area.min, cfg::REGION_SIZE);
+    const auto last = Math::floor_div(area.max, cfg::REGION_SIZE);
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_queue.clear();
+    glm::tvec3<cfg::Coord> region_position;
+    for (region_position.z = first.z; region_position.z <= last.z; ++region_position.z)
+        for (region_position.y = first.y; region_position.y <= last.y; ++region_position.y)
+            for (region_position.x = first.x; region_position.x <= last.x; ++region_position.x)
+                m_queue.push_back(region_position);
+    m_condition.notify_one();
+}
+
+void RegionPrefetcher::prefetcher() {
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    while (true) {
+        m_condition.wait(lock, [this]() { return !m_running || !m_queue.empty(); });
+        if (!m_running)
+            return;
+        const glm::tvec3<cfg::Coord> region_position{ m_queue.back() };
+        m_queue.pop_back();
+        lock.unlock();
+        // regions that are open already are skipped right away
+        m_region_container.prefetch(region_position);
+        lock.lock();
+    }
+}
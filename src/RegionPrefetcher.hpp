@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <glm/vec3.hpp>
+#include "cfg.hpp"
+#include "RegionContainer.hpp"
+
+// opens the regions the loader is going to need next on its own thread, so workers crossing into a
+// new region find it open (slot table read) with its chunk data on the way into the page cache
+// the guess: the center chunk keeps moving in the direction of its last move for cfg::REGION_PREFETCH_DISTANCE
+// chunks, regions of the loading area around there are prefetched (RegionContainer::prefetch())
+// whether it helped is counted in RegionContainer::Statistics
+class RegionPrefetcher {
+public:
+    RegionPrefetcher(RegionContainer & region_container);
+    RegionPrefetcher(const RegionPrefetcher &) = delete;
+    RegionPrefetcher & operator = (const RegionPrefetcher &) = delete;
+    ~RegionPrefetcher();
+
+    // call with every new center chunk, only queues work
+    void moveCenterChunk(const glm::tvec3<cfg::Coord> & center_chunk);
+
+private:
+    RegionContainer & m_region_container;
+    glm::tvec3<cfg::Coord> m_center_chunk;
+    // per axis -1, 0 or 1
+    glm::tvec3<cfg::Coord> m_direction;
+    // regions of the latest guess not prefetched yet, replaced by every move
+    std::vector<glm::tvec3<cfg::Coord>> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running;
+    std::thread m_thread;
+
+    void prefetcher();
+
+};
@@ -1,6 +1,8 @@
 #include "VoxelContainer.hpp"
 
 #include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <glm/gtx/string_cast.hpp>
 
@@ -8,14 +10,25 @@
 #include "worldgen.hpp"
 #include "Print.hpp"
 
+namespace {
+    std::atomic_bool incremental_passes{ true };
+    std::atomic_bool mesh_skipping{ true };
+    std::atomic<mesher::MesherType> padded_mesher{ mesher::MesherType::BITMASK };
 
-VoxelContainer::VoxelContainer() :
-    m_barrier{ cfg::WORKER_THREAD_COUNT }
+    size_t workerThreadCount(size_t thread_count) {
+        if (thread_count != 0)
+            return std::min(thread_count, cfg::MAX_WORKER_THREAD_COUNT);
+        // 0 if unknown
+        return std::clamp(size_t{ std::thread::hardware_concurrency() }, cfg::MIN_WORKER_THREAD_COUNT, cfg::MAX_WORKER_THREAD_COUNT);
+    }
+}
+
+VoxelContainer::VoxelContainer(size_t thread_count) :
+    m_thread_count{ workerThreadCount(thread_count) },
+    m_worker_buffers(m_thread_count),
+    m_tasks{ m_thread_count },
+    m_chunk_io{ m_thread_count }
 {
-    std::for_each(std::begin(m_workers_data), std::end(m_workers_data), [] (WorkerData & worker_data) {
-        std::fill(std::begin(worker_data.regions), std::end(worker_data.regions), nullptr);
-        std::fill(std::begin(worker_data.positions), std::end(worker_data.positions), glm::tvec3<cfg::Coord>{ 0, 0, 0 });
-    });
     std::for_each(std::begin(m_chunk_positions), std::end(m_chunk_positions), [] (std::atomic<Math::DumbVec3> & vector) {
         vector.store(Math::toDumb3(glm::tvec3<cfg::Coord>{ 0, 0, 0 }, false));
     });
@@ -25,51 +38,64 @@ VoxelContainer::VoxelContainer() :
     });
     m_mesh_positions[0].store(Math::toDumb3(glm::tvec3<cfg::Coord>{ 1, 0, 0 }, false));
     std::fill(std::begin(m_mesh_empties), std::end(m_mesh_empties), true);
-    std::fill(std::begin(m_blocks), std::end(m_blocks), cfg::Block{ 0 });
+    for (auto & generation : m_mesh_generations)
+        generation.store(0);
+    m_edit_count = 0;
+    m_edit_padded.resize(Math::volume(mesher::PADDED_SIZE));
+    for (auto & buffers : m_worker_buffers) {
+        buffers.chunk.resize(cfg::CHUNK_VOLUME);
+        buffers.padded.resize(Math::volume(mesher::PADDED_SIZE));
+    }
     std::fill(std::begin(m_chunk_dirty), std::end(m_chunk_dirty), false);
+    for (auto & count : m_task_counts)
+        count.store(0);
+    m_skipped_meshes.store(0);
+    m_sleeping_workers.store(0);
     m_workers_running.store(true);
-    m_iterator.store(0);
+    m_epoch.store(0);
+    m_loaded_center_chunk.store(Math::toDumb3(glm::tvec3<cfg::Coord>{ 0, 0, 0 }, false));
+    m_target_center_chunk.store(Math::toDumb3(glm::tvec3<cfg::Coord>{ 0, 0, 0 }, true));
     m_loader_center_chunk = { 0, 0, 0 };
     m_actual_center_chunk = { 0, 0, 0 };
-    m_center_dirty.store(false);
-    clearMeshReadines();
-    m_workers_finished.store(0);
-    for (size_t i = 0; i < cfg::WORKER_THREAD_COUNT; ++i)
-        m_workers[i] = std::thread{ &VoxelContainer::worker, this, i };
+    {
+        std::lock_guard<std::mutex> lock{ m_center_lock };
+        startPass();
+    }
+    for (size_t i = 0; i < m_thread_count; ++i)
+        m_workers.emplace_back(&VoxelContainer::worker, this, i);
 }
 
 VoxelContainer::~VoxelContainer() {
-    m_workers_running.store(false);
-    // speed up shutdown of workers
-    m_center_dirty.store(true);
-    m_condition.notify_one();
-    // empty mesh queue after set m_center_dirty 
+    {
+        std::lock_guard<std::mutex> lock{ m_center_lock };
+        m_workers_running.store(false);
+    }
+    m_condition.notify_all();
+    // empty mesh queue after workers stopped taking jobs
     // no need to fully empty queue
-    // making cfg::WORKER_THREAD_COUNT slots in queue is enough
+    // the meshes of the task each worker may still be in fit
     Mesh m;
     while (m_mesh_queue.pop(std::move(m)));
     std::for_each(std::begin(m_workers), std::end(m_workers), [this](std::thread & worker){
         worker.join();
     });
 
-    // TODO: !!!!!! release all Regions held by chunks here !!!!!!
-    //       it is good practice, but reference count is not enforced
-    //       so RAII will take care of correct cleanup when ~RegionContainer() is called
-
+    // whatever is still dirty goes through the writer too, all of it is in the regions before they close
+    // (tasks left behind are dropped, save tasks included, drain() writes what they would have)
+    cfg::Block * const chunk = m_worker_buffers[0].chunk.data();
     for (size_t i = 0; i < cfg::CHUNK_ARRAY_VOLUME; ++i) {
         if (m_chunk_dirty[i]) {
             bool dummy;
             const auto chunk_position = Math::toVec3<cfg::Coord>(m_chunk_positions[i], dummy);
-            const auto region_position = Math::floor_div(chunk_position, cfg::REGION_SIZE);
-            Region & region = m_region_container.get(region_position);
-            saveChunk(m_blocks.data() + i * cfg::CHUNK_VOLUME, chunk_position, &region);
-            m_region_container.release(region_position);
+            m_chunks[i].unpack(chunk);
+            m_chunk_writer.save(chunk_position, chunk);
             // TODO: check if this is true: m_chunk_dirty does not need to be atomic, because there will be no concurrent access
             //       and it is implicitly synchronized between threads by other atomic variables
             m_chunk_dirty[i] = false;
 //            Print("Saving ", glm::to_string(chunk_position));
         }
     }
+    m_chunk_writer.drain();
 }
 
 void VoxelContainer::moveCenterChunk(const glm::tvec3<cfg::Coord> & new_center_chunk) {
@@ -81,16 +107,49 @@ void VoxelContainer::moveCenterChunk(const glm::tvec3<cfg::Coord> & new_center_c
         Math::toAABB3(m_loader_center_chunk, cfg::CHUNK_LOADING_RADIUS)
     );
     if (changed) {
-        m_center_dirty.store(true);
+        m_target_center_chunk.store(Math::toDumb3(new_center_chunk, true));
+        m_epoch.fetch_add(1);
+        // one worker is enough to start the next pass
         m_condition.notify_one();
+        m_region_prefetcher.moveCenterChunk(new_center_chunk);
     }
 }
 
-const cfg::Block * VoxelContainer::getChunk(const glm::tvec3<cfg::Coord> & chunk_position) {
+bool VoxelContainer::isLoaded(const glm::tvec3<cfg::Coord> & center_chunk) const {
+    bool valid;
+    const auto loaded_center_chunk = Math::toVec3<cfg::Coord>(m_loaded_center_chunk.load(), valid);
+    return valid && glm::all(glm::equal(loaded_center_chunk, center_chunk));
+}
+
+void VoxelContainer::setIncrementalPasses(bool incremental) { incremental_passes.store(incremental); }
+
+void VoxelContainer::setMeshSkipping(bool skip) { mesh_skipping.store(skip); }
+
+void VoxelContainer::setMesher(mesher::MesherType type) {
+    assert(
+        type == mesher::MesherType::BITMASK || type == mesher::MesherType::GREEDY ||
+        type == mesher::MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_BETTER_COPY
+    );
+    padded_mesher.store(type);
+}
+
+VoxelContainer::TaskStatistics VoxelContainer::getTaskStatistics() const {
+    TaskStatistics statistics;
+    statistics.threads = m_thread_count;
+    statistics.loads = m_task_counts[static_cast<size_t>(TaskType::LOAD)].load();
+    statistics.generates = m_task_counts[static_cast<size_t>(TaskType::GENERATE)].load();
+    statistics.meshes = m_task_counts[static_cast<size_t>(TaskType::MESH)].load();
+    statistics.skipped_meshes = m_skipped_meshes.load();
+    statistics.saves = m_task_counts[static_cast<size_t>(TaskType::SAVE)].load();
+    statistics.steals = m_tasks.statistics().steals.load();
+    return statistics;
+}
+
+const PackedChunk * VoxelContainer::getChunk(const glm::tvec3<cfg::Coord> & chunk_position) {
     return getChunkNonConst(chunk_position);
 }
 
-cfg::Block * VoxelContainer::getChunkNonConst(const glm::tvec3<cfg::Coord> & chunk_position) {
+PackedChunk * VoxelContainer::getChunkNonConst(const glm::tvec3<cfg::Coord> & chunk_position) {
     const auto chunk_index = Math::position_to_index(chunk_position, cfg::CHUNK_ARRAY_SIZE);
     bool valid_chunk;
     const auto loaded_chunk_position = Math::toVec3<cfg::Coord>(m_chunk_positions[chunk_index].load(), valid_chunk);
@@ -100,12 +159,12 @@ cfg::Block * VoxelContainer::getChunkNonConst(const glm::tvec3<cfg::Coord> & chu
         return nullptr;
     if (!Math::inside(m_center_chunk_overlap, chunk_position))
         return nullptr;
-    return m_blocks.data() + chunk_index * cfg::CHUNK_VOLUME;
+    return &m_chunks[chunk_index];
 }
 
 
-cfg::Block * VoxelContainer::getWritableChunk(const glm::tvec3<cfg::Coord> & chunk_position) {
-    cfg::Block * chunk = getChunkNonConst(chunk_position);
+PackedChunk * VoxelContainer::getWritableChunk(const glm::tvec3<cfg::Coord> & chunk_position) {
+    PackedChunk * chunk = getChunkNonConst(chunk_position);
     if (chunk == nullptr) return nullptr;
     // check if meshes are dirty
     if (checkMeshes(chunk_position) == false)
@@ -127,154 +186,389 @@ void VoxelContainer::invalidateMeshWithBlockRange(Math::AABB3<cfg::Coord> range)
                 const auto mesh_index = Math::position_to_index(i, cfg::MESH_ARRAY_SIZE);
                 m_mesh_positions[mesh_index].store(Math::toDumb3(i, false)); // alternatively atomic_fetch_and(valid_flag)
             }
-    m_center_dirty.store(true);
+    {
+        // endPass() checks the epoch and sets m_loaded_center_chunk under the same lock
+        std::lock_guard<std::mutex> lock{ m_center_lock };
+        m_loaded_center_chunk.store(Math::toDumb3(m_actual_center_chunk, false));
+        m_epoch.fetch_add(1);
+    }
     m_condition.notify_one();
 }
 
+bool VoxelContainer::patchMeshesWithBlockRange(const Math::AABB3<cfg::Coord> & range, std::vector<MeshPatch> & patches) {
+    patches.clear();
+    Math::AABB3<cfg::Coord> meshes;
+    meshes.min = Math::floor_div(range.min - Math::add(cfg::MESH_OFFSET, cfg::BLOCK_MESH_EFFECT_RADIUS), cfg::MESH_SIZE);
+    meshes.max = Math::floor_div(range.max - Math::sub(cfg::MESH_OFFSET, cfg::BLOCK_MESH_EFFECT_RADIUS), cfg::MESH_SIZE);
+    glm::tvec3<cfg::Coord> i;
+    for (i.z = meshes.min.z; i.z <= meshes.max.z; ++i.z)
+        for (i.y = meshes.min.y; i.y <= meshes.max.y; ++i.y)
+            for (i.x = meshes.min.x; i.x <= meshes.max.x; ++i.x) {
+                if (!patchable(i, Math::position_to_index(i, cfg::MESH_ARRAY_SIZE))) {
+                    invalidateMeshWithBlockRange(range);
+                    return false;
+                }
+            }
+
+    ++m_edit_count;
+    for (i.z = meshes.min.z; i.z <= meshes.max.z; ++i.z)
+        for (i.y = meshes.min.y; i.y <= meshes.max.y; ++i.y)
+            for (i.x = meshes.min.x; i.x <= meshes.max.x; ++i.x) {
+                const auto mesh_index = Math::position_to_index(i, cfg::MESH_ARRAY_SIZE);
+                const uint32_t generation{ m_mesh_generations[mesh_index].load() };
+                copyMeshBlocks(i, m_edit_padded.data());
+                MeshPatch patch;
+                patch.position = i;
+                auto edited = std::find_if(std::begin(m_edited_meshes), std::end(m_edited_meshes), [&i](const EditedMesh & mesh) {
+                    return glm::all(glm::equal(mesh.position, i));
+                });
+                patch.full = edited == std::end(m_edited_meshes) || edited->generation != generation;
+                if (edited == std::end(m_edited_meshes)) {
+                    if (m_edited_meshes.size() < cfg::EDITED_MESH_LIMIT) {
+                        m_edited_meshes.push_back({ i, 0, 0, std::make_unique<mesher::IndexedMesh>() });
+                        edited = std::prev(std::end(m_edited_meshes));
+                    } else {
+                        edited = std::min_element(std::begin(m_edited_meshes), std::end(m_edited_meshes), [](const EditedMesh & a, const EditedMesh & b) {
+                            return a.last_edit < b.last_edit;
+                        });
+                    }
+                }
+                edited->position = i;
+                edited->generation = generation;
+                edited->last_edit = m_edit_count;
+                if (patch.full) {
+                    edited->mesh->build(m_edit_padded.data());
+                } else {
+                    const glm::tvec3<cfg::Coord> mesh_from{ i * cfg::MESH_SIZE + cfg::MESH_OFFSET };
+                    edited->mesh->patch(m_edit_padded.data(), range.min - mesh_from, range.max - mesh_from);
+                }
+                edited->mesh->takeChangedQuads(patch.quads);
+                patch.mesh = &edited->mesh->vertices();
+                // the scene has no entry for an empty mesh, a patch gives it one and a mesh task of another
+                // position removes it (it isn't empty anymore), empty meshes without one stay out of the scene
+                if (m_mesh_empties[mesh_index] && patch.mesh->empty())
+                    continue;
+                m_mesh_empties[mesh_index] = false;
+                patches.push_back(std::move(patch));
+            }
+    return true;
+}
+
+bool VoxelContainer::patchable(const glm::tvec3<cfg::Coord> & mesh_position, cfg::Coord mesh_index) {
+    bool mesh_valid;
+    const auto loaded_mesh_position = Math::toVec3<cfg::Coord>(m_mesh_positions[mesh_index].load(), mesh_valid);
+    if (!mesh_valid || !glm::all(glm::equal(loaded_mesh_position, mesh_position)))
+        return false;
+    glm::tvec3<cfg::Coord> i;
+    for (i.z = mesh_position.z + cfg::MESH_CHUNK_START.z; i.z < mesh_position.z + cfg::MESH_CHUNK_END.z; ++i.z)
+        for (i.y = mesh_position.y + cfg::MESH_CHUNK_START.y; i.y < mesh_position.y + cfg::MESH_CHUNK_END.y; ++i.y)
+            for (i.x = mesh_position.x + cfg::MESH_CHUNK_START.x; i.x < mesh_position.x + cfg::MESH_CHUNK_END.x; ++i.x)
+                if (getChunkNonConst(i) == nullptr)
+                    return false;
+    return true;
+}
+
 void VoxelContainer::worker(size_t thread_id) {
-    WorkerData & worker_data = *(m_workers_data.data() + thread_id);
-    const auto indices_size = m_voxel_indices.size();
-    while (true) {
-        // don't rely on variable center_dirty later, because you don't know which threads registered it as true
-        const auto center_dirty = m_center_dirty.load(); // well whatever, more hacks
-        if (center_dirty) {
-            // move iterator to end
-            const auto iterator_index_swap = m_iterator.exchange(indices_size);
-            if (iterator_index_swap > indices_size)
-                m_iterator.fetch_add(iterator_index_swap - indices_size);
+    ChunkIO::Request completed;
+    while (m_workers_running.load()) {
+        while (m_chunk_io.poll(thread_id, completed))
+            finishChunkLoad(thread_id, completed);
+
+        Task task;
+        if (m_tasks.pop(thread_id, task)) {
+            runTask(thread_id, task);
+            continue;
         }
 
-        const auto iterator_index = m_iterator.fetch_add(1);
-        if (iterator_index >= indices_size) {
-            if (iterator_index == indices_size + cfg::WORKER_THREAD_COUNT - 1) {
-                // you are last
-                clearMeshReadines();
-                m_iterator.store(0);
-                
-                std::unique_lock<std::mutex> lock{ m_center_lock };
-                m_loader_center_chunk = m_actual_center_chunk;
-                while (m_center_dirty.exchange(false) == false)
-                    m_condition.wait(lock);
-
-                // TODO: consider potential issue: if this if block takes longer than next call
-                //       to invalidateMeshWithBlockRange() or moveCenterChunk()
-                //       the iterator will reset again and again causing no chunks to be loaded
-                //       simulate with: std::this_thread::sleep_for(std::chrono::milliseconds{ 1000 });
-            }
+        const std::shared_ptr<Pass> pass{ std::atomic_load(&m_pass) };
+        const size_t job = pass->next.fetch_add(1);
+        if (job < pass->indices->size()) {
+            m_task_counts[static_cast<size_t>(TaskType::LOAD)].fetch_add(1);
+            if (!runJob(thread_id, *pass, (*pass->indices)[job] + pass->center_chunk))
+                finishJob();
+            continue;
+        }
 
-            m_barrier.wait();
-
-            if (m_workers_running) {
-                continue;
-            } else {
-                // trap workers to prevent some getting stuck in other barriers
-                m_workers_finished.fetch_add(1);
-                do {
-                    m_barrier.wait();
-                } while (m_workers_finished.load() < cfg::WORKER_THREAD_COUNT);
-                break;
-            }
+        // nothing left to take, the pass can't end before the loads of this worker are done
+        if (m_chunk_io.wait(thread_id, completed)) {
+            finishChunkLoad(thread_id, completed);
+            continue;
         }
+        std::unique_lock<std::mutex> lock{ m_center_lock };
+        const auto pass_ended = [this, &pass] {
+            return std::atomic_load(&m_pass) == pass && pass->pending.load() == 0 && pass->epoch != m_epoch.load();
+        };
+        m_sleeping_workers.fetch_add(1);
+        m_condition.wait(lock, [this, &pass, &pass_ended] {
+            return !m_workers_running.load() || std::atomic_load(&m_pass) != pass || pass_ended() || m_tasks.size() > 0;
+        });
+        m_sleeping_workers.fetch_sub(1);
+        // the pass ended with nothing newer to start one for, now there is
+        if (m_workers_running.load() && pass_ended())
+            startPass();
+    }
+    // buffers of loads still in flight come back
+    while (m_chunk_io.wait(thread_id, completed))
+        finishChunkLoad(thread_id, completed);
+}
 
-        const auto chunk_position = m_voxel_indices[iterator_index] + m_loader_center_chunk;
-        const auto chunk_index = Math::position_to_index(chunk_position, cfg::CHUNK_ARRAY_SIZE);
-        bool chunk_valid;
-        const auto old_chunk_position = Math::toVec3<cfg::Coord>(m_chunk_positions[chunk_index].load(), chunk_valid);
-        if (!glm::all(glm::equal(chunk_position, old_chunk_position))) {
-            if (m_chunk_dirty[chunk_index]) {
-                const auto old_region_position = Math::floor_div(old_chunk_position, cfg::REGION_SIZE);
-                auto old_region = fetchRegionUseWorkerCache(old_region_position, worker_data);
-                saveChunk(m_blocks.data() + chunk_index * cfg::CHUNK_VOLUME, old_chunk_position, old_region);
-                m_chunk_dirty[chunk_index] = false;
-            }
-            const auto region_position = Math::floor_div(chunk_position, cfg::REGION_SIZE);
-            auto region = fetchRegionUseWorkerCache(region_position, worker_data);
-            m_chunk_positions[chunk_index].store(Math::toDumb3(chunk_position, false));
-            if (false == tryLoadChunk(m_blocks.data() + chunk_index * cfg::CHUNK_VOLUME, chunk_position, region)) {
-                generateChunk(m_blocks.data() + chunk_index * cfg::CHUNK_VOLUME, chunk_position);
-                m_chunk_dirty[chunk_index] = cfg::SAVE_NEWLY_GENERATED_CHUNKS;
-            } else {
-                m_chunk_dirty[chunk_index] = false;
-            }
+bool VoxelContainer::runJob(size_t thread_id, const Pass & pass, const glm::tvec3<cfg::Coord> & chunk_position) {
+    if (pass.epoch != m_epoch.load()) {
+        // cancelled, the center moved on and the chunk isn't needed anymore
+        bool target_valid;
+        const auto target_center_chunk = Math::toVec3<cfg::Coord>(m_target_center_chunk.load(), target_valid);
+        if (!VoxelIterator::contains(chunk_position - target_center_chunk))
+            return false;
+    }
+    const auto chunk_index = Math::position_to_index(chunk_position, cfg::CHUNK_ARRAY_SIZE);
+    bool chunk_valid;
+    const auto old_chunk_position = Math::toVec3<cfg::Coord>(m_chunk_positions[chunk_index].load(), chunk_valid);
+    if (!glm::all(glm::equal(chunk_position, old_chunk_position))) {
+        WorkerBuffers & buffers = m_worker_buffers[thread_id];
+        cfg::Block * const chunk = buffers.chunk.data();
+        if (m_chunk_dirty[chunk_index]) {
+            // copied, chunk can be replaced right away
+            m_chunks[chunk_index].unpack(chunk);
+            m_chunk_writer.save(old_chunk_position, chunk);
+            m_chunk_dirty[chunk_index] = false;
+            spawn(thread_id, Task{ TaskType::SAVE, old_chunk_position, nullptr });
+        }
+        m_chunk_positions[chunk_index].store(Math::toDumb3(chunk_position, false));
+        if (m_chunk_writer.load(chunk_position, chunk)) {
+            // was evicted and not written yet
+            m_chunks[chunk_index].pack(chunk);
             m_chunk_positions[chunk_index].store(Math::toDumb3(chunk_position, true));
+        } else {
+            if (buffers.loads.empty())
+                buffers.loads.push_back(std::make_unique<cfg::Block[]>(cfg::CHUNK_VOLUME));
+            ChunkIO::Request request;
+            request.region = &m_region_container.get(Math::floor_div(chunk_position, cfg::REGION_SIZE));
+            request.chunk_position = chunk_position;
+            // packed and given back in finishChunkLoad()
+            request.chunk = buffers.loads.back().release();
+            buffers.loads.pop_back();
+            m_chunk_io.submit(thread_id, request);
+            // meshes are taken care of in finishChunkLoad(), meanwhile do something else
+            return true;
         }
+    }
 
-        std::array<glm::tvec3<cfg::Coord>, cfg::CHUNK_MESH_VOLUME> meshes_to_load;
-        const auto meshes_to_load_count = markMeshes(chunk_position, meshes_to_load);
-        for (std::size_t i = 0; i < meshes_to_load_count; ++i) {
-            Mesh mesh;
-            mesh.position = meshes_to_load[i];
-            const auto mesh_index = Math::position_to_index(meshes_to_load[i], cfg::MESH_ARRAY_SIZE);
-            generateMesh(meshes_to_load[i], mesh.mesh);
-            // must be set after generating mesh
-            bool old_mesh_valid;
-            const auto old_mesh_position = Math::toVec3<cfg::Coord>(m_mesh_positions[mesh_index].load(), old_mesh_valid);
-            // if same position, just replace (already implemented in VoxelScene), don't erase + insert
-            if (m_mesh_empties[mesh_index] == false) {
-                // empty vector indicates remove that mesh
-                Mesh mm;
-                mm.position = old_mesh_position;
-                m_mesh_queue.push(std::move(mm));
-            }
-            m_mesh_positions[mesh_index].store(Math::toDumb3(meshes_to_load[i], true));
-            if (mesh.mesh.size() > 0) {
-                m_mesh_empties[mesh_index] = false;
-                m_mesh_queue.push(std::move(mesh));
-            } else {
-                m_mesh_empties[mesh_index] = true;
-            }
-        }
+    // don't let submitted loads wait for the other jobs
+    m_chunk_io.flush(thread_id);
+    chunkReady(thread_id, chunk_position);
+    return false;
+}
+
+void VoxelContainer::finishJob() {
+    // loads of a pass are finished before the next one starts, the job is one of the current pass
+    const std::shared_ptr<Pass> pass{ std::atomic_load(&m_pass) };
+    if (pass->pending.fetch_sub(1) == 1)
+        endPass(*pass);
+}
+
+void VoxelContainer::endPass(const Pass & pass) {
+    std::lock_guard<std::mutex> lock{ m_center_lock };
+    // a waiting worker may have started the next one already
+    if (std::atomic_load(&m_pass).get() != &pass)
+        return;
+    if (pass.epoch == m_epoch.load()) {
+        // nothing moved or got invalidated, everything around the center is there, workers wait for a new epoch
+        m_loaded_center_chunk.store(Math::toDumb3(pass.center_chunk, true));
+    } else {
+        startPass();
     }
 }
 
-void VoxelContainer::generateMesh(const glm::tvec3<cfg::Coord> & mesh_position, std::vector<cfg::Vertex> & mesh) {
-    // check if mesh really not generated from before
-    const auto mesh_index = Math::position_to_index(mesh_position, cfg::MESH_ARRAY_SIZE);
+void VoxelContainer::spawn(size_t thread_id, Task && task) {
+    m_tasks.push(thread_id, std::move(task));
+    if (m_sleeping_workers.load() > 0) {
+        // a worker between checking m_tasks and waiting would miss the notification
+        std::lock_guard<std::mutex> lock{ m_center_lock };
+    }
+    m_condition.notify_one();
+}
 
-    // collect needed chunks (not really necessary, original array could be directly adressed)
-    std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> chunks;
-    glm::tvec3<cfg::Coord> i;
-    std::size_t j{ 0 };
-    for (i.z = mesh_position.z + cfg::MESH_CHUNK_START.z; i.z < mesh_position.z + cfg::MESH_CHUNK_END.z; ++i.z)
-        for (i.y = mesh_position.y + cfg::MESH_CHUNK_START.y; i.y < mesh_position.y + cfg::MESH_CHUNK_END.y; ++i.y)
-            for (i.x = mesh_position.x + cfg::MESH_CHUNK_START.x; i.x < mesh_position.x + cfg::MESH_CHUNK_END.x; ++i.x) {
-                // assuming chunks are loaded now
-                const auto chunk_index = Math::position_to_index(i, cfg::CHUNK_ARRAY_SIZE);
-                chunks[j++] = m_blocks.data() + cfg::CHUNK_VOLUME * chunk_index;
-            }
-    // generate mesh
-//    mesher::mesh<mesher::MesherType::STANDARD>(mesh, chunks);
-//    mesher::mesh<mesher::MesherType::MULTI_PASS>(mesh, chunks);
-//    mesher::mesh<mesher::MesherType::COPY_THEN_MESH>(mesh, chunks);
-    mesher::generic(mesh, chunks);
+void VoxelContainer::runTask(size_t thread_id, Task & task) {
+    m_task_counts[static_cast<size_t>(task.type)].fetch_add(1);
+    switch (task.type) {
+    case TaskType::GENERATE:
+        generateChunk(task.chunk.get(), task.position);
+        finishChunk(thread_id, task.position, std::move(task.chunk), true);
+        break;
+    case TaskType::MESH:
+        meshTask(thread_id, task.position);
+        break;
+    case TaskType::SAVE:
+        m_chunk_writer.write(m_worker_buffers[thread_id].scratch);
+        break;
+    case TaskType::LOAD:
+        assert(false);
+        break;
+    }
 }
 
-void VoxelContainer::clearMeshReadines() {
-    std::for_each(std::begin(m_mesh_readines), std::end(m_mesh_readines), [this](std::atomic<MeshReadinesType> & value){
-        value.store(0);
+void VoxelContainer::startPass() {
+    // the last pass is done, nobody counts down meshes
+    std::for_each(std::begin(m_mesh_missing_chunks), std::end(m_mesh_missing_chunks), [](std::atomic<uint8_t> & value) {
+        value.store(cfg::MESH_CHUNK_VOLUME);
     });
+    m_loader_center_chunk = m_actual_center_chunk;
+    auto pass = std::make_shared<Pass>();
+    pass->epoch = m_epoch.load();
+    pass->center_chunk = m_loader_center_chunk;
+    // the chunks of meshes around the last loaded center are still there, only go through the rest
+    bool loaded_center_valid;
+    const auto loaded_center_chunk = Math::toVec3<cfg::Coord>(m_loaded_center_chunk.load(), loaded_center_valid);
+    if (loaded_center_valid && !VoxelIterator::keepsSlots(pass->center_chunk - loaded_center_chunk)) {
+        // too far, chunks around the loaded center get replaced once this pass loads
+        m_loaded_center_chunk.store(Math::toDumb3(loaded_center_chunk, false));
+        loaded_center_valid = false;
+    }
+    if (loaded_center_valid && incremental_passes.load())
+        pass->indices = m_voxel_indices.delta(pass->center_chunk - loaded_center_chunk);
+    else
+        pass->indices = m_voxel_indices.all();
+    pass->pending.store(pass->indices->size());
+    if (pass->indices->empty())
+        m_loaded_center_chunk.store(Math::toDumb3(pass->center_chunk, true));
+    std::atomic_store(&m_pass, pass);
+    m_condition.notify_all();
 }
 
-std::size_t VoxelContainer::markMeshes(const glm::tvec3<cfg::Coord> & chunk_position, std::array<glm::tvec3<cfg::Coord>, cfg::CHUNK_MESH_VOLUME> & meshes_to_load) {
+void VoxelContainer::chunkReady(size_t thread_id, const glm::tvec3<cfg::Coord> & chunk_position) {
+    std::shared_ptr<Pass> pass;
     glm::tvec3<cfg::Coord> i;
-    MeshReadinesType mask{ 1 };
-    std::size_t meshes_to_load_count{ 0 };
     for (i.z = chunk_position.z + cfg::CHUNK_MESH_START.z; i.z < chunk_position.z + cfg::CHUNK_MESH_END.z; ++i.z)
         for (i.y = chunk_position.y + cfg::CHUNK_MESH_START.y; i.y < chunk_position.y + cfg::CHUNK_MESH_END.y; ++i.y)
             for (i.x = chunk_position.x + cfg::CHUNK_MESH_START.x; i.x < chunk_position.x + cfg::CHUNK_MESH_END.x; ++i.x) {
                 const auto mesh_index = Math::position_to_index(i, cfg::MESH_ARRAY_SIZE);
-                const MeshReadinesType state = m_mesh_readines[mesh_index].fetch_or(mask) | mask;
-                mask <<= 1;
+                if (m_mesh_missing_chunks[mesh_index].fetch_sub(1) != 1)
+                    continue;
                 bool mesh_valid;
-                if (
-                    state == ALL_CHUNKS_READY &&
-                    !glm::all(glm::equal(i, Math::toVec3<cfg::Coord>(m_mesh_positions[mesh_index].load(), mesh_valid)))
-                    )
-                    meshes_to_load[meshes_to_load_count++] = i;
-                else if (state == ALL_CHUNKS_READY && !mesh_valid)
-                    meshes_to_load[meshes_to_load_count++] = i;
+                const auto mesh_position = Math::toVec3<cfg::Coord>(m_mesh_positions[mesh_index].load(), mesh_valid);
+                if (mesh_valid && glm::all(glm::equal(i, mesh_position)))
+                    continue;
+                // the chunk is a pending job of the current pass, so the pass can't end before this
+                if (pass == nullptr)
+                    pass = std::atomic_load(&m_pass);
+                pass->pending.fetch_add(1);
+                spawn(thread_id, Task{ TaskType::MESH, i, nullptr });
+            }
+}
+
+void VoxelContainer::meshTask(size_t thread_id, const glm::tvec3<cfg::Coord> & mesh_position) {
+    // no meshes while shutting down, nobody takes them from the queue anymore
+    if (m_workers_running.load()) {
+        Mesh mesh;
+        mesh.position = mesh_position;
+        const auto mesh_index = Math::position_to_index(mesh_position, cfg::MESH_ARRAY_SIZE);
+        generateMesh(thread_id, mesh_position, mesh.mesh);
+        // must be set after generating mesh
+        bool old_mesh_valid;
+        const auto old_mesh_position = Math::toVec3<cfg::Coord>(m_mesh_positions[mesh_index].load(), old_mesh_valid);
+        // if same position, just replace (already implemented in VoxelScene), don't erase + insert
+        if (m_mesh_empties[mesh_index] == false) {
+            // empty vector indicates remove that mesh
+            Mesh mm;
+            mm.position = old_mesh_position;
+            m_mesh_queue.push(std::move(mm));
+        }
+        if (mesh.mesh.size() > 0) {
+            m_mesh_empties[mesh_index] = false;
+            m_mesh_queue.push(std::move(mesh));
+        } else {
+            m_mesh_empties[mesh_index] = true;
+        }
+        // after the push: once the mesh is valid (and can be patched) it is in the queue, ahead of any patch
+        m_mesh_generations[mesh_index].fetch_add(1);
+        m_mesh_positions[mesh_index].store(Math::toDumb3(mesh_position, true));
+    }
+    finishJob();
+}
+
+void VoxelContainer::finishChunkLoad(size_t thread_id, const ChunkIO::Request & request) {
+    m_region_container.release(Math::floor_div(request.chunk_position, cfg::REGION_SIZE));
+    std::unique_ptr<cfg::Block[]> chunk{ request.chunk };
+    if (request.loaded) {
+        finishChunk(thread_id, request.chunk_position, std::move(chunk), false);
+    } else if (m_workers_running.load()) {
+        // still pending, until the generate task is done
+        spawn(thread_id, Task{ TaskType::GENERATE, request.chunk_position, std::move(chunk) });
+    } else {
+        // loads in flight while shutting down, nobody runs tasks anymore
+        generateChunk(chunk.get(), request.chunk_position);
+        finishChunk(thread_id, request.chunk_position, std::move(chunk), true);
+    }
+}
+
+void VoxelContainer::finishChunk(size_t thread_id, const glm::tvec3<cfg::Coord> & chunk_position, std::unique_ptr<cfg::Block[]> chunk, bool generated) {
+    const auto chunk_index = Math::position_to_index(chunk_position, cfg::CHUNK_ARRAY_SIZE);
+    m_chunk_dirty[chunk_index] = generated && cfg::SAVE_NEWLY_GENERATED_CHUNKS;
+    m_chunks[chunk_index].pack(chunk.get());
+    m_worker_buffers[thread_id].loads.push_back(std::move(chunk));
+    m_chunk_positions[chunk_index].store(Math::toDumb3(chunk_position, true));
+    // no mesh tasks while shutting down
+    if (m_workers_running.load())
+        chunkReady(thread_id, chunk_position);
+    finishJob();
+}
+
+void VoxelContainer::generateMesh(size_t thread_id, const glm::tvec3<cfg::Coord> & mesh_position, std::vector<cfg::Vertex> & mesh) {
+    if (mesh_skipping.load() && faceless(mesh_position)) {
+        mesh.clear();
+        m_skipped_meshes.fetch_add(1);
+        return;
+    }
+    cfg::Block * const padded = m_worker_buffers[thread_id].padded.data();
+    copyMeshBlocks(mesh_position, padded);
+    // generate mesh
+//    mesher::mesh<mesher::MesherType::STANDARD>(mesh, chunks);
+//    mesher::mesh<mesher::MesherType::MULTI_PASS>(mesh, chunks);
+//    mesher::mesh<mesher::MesherType::COPY_THEN_MESH>(mesh, chunks);
+    switch (padded_mesher.load()) {
+    case mesher::MesherType::BITMASK:
+        mesher::meshPaddedBitmask(mesh, padded);
+        break;
+    case mesher::MesherType::GREEDY:
+        mesher::meshPaddedGreedy(mesh, padded);
+        break;
+    default:
+        mesher::meshPadded(mesh, padded);
+        break;
+    }
+}
+
+bool VoxelContainer::faceless(const glm::tvec3<cfg::Coord> & mesh_position) const {
+    // the chunks of a mesh (cfg::MESH_CHUNK_START to cfg::MESH_CHUNK_END) hold the blocks around it too
+    bool all_air{ true }, all_solid{ true };
+    glm::tvec3<cfg::Coord> i;
+    for (i.z = mesh_position.z + cfg::MESH_CHUNK_START.z; i.z < mesh_position.z + cfg::MESH_CHUNK_END.z; ++i.z)
+        for (i.y = mesh_position.y + cfg::MESH_CHUNK_START.y; i.y < mesh_position.y + cfg::MESH_CHUNK_END.y; ++i.y)
+            for (i.x = mesh_position.x + cfg::MESH_CHUNK_START.x; i.x < mesh_position.x + cfg::MESH_CHUNK_END.x; ++i.x) {
+                const PackedChunk & chunk = m_chunks[Math::position_to_index(i, cfg::CHUNK_ARRAY_SIZE)];
+                all_air = all_air && chunk.allAir();
+                all_solid = all_solid && chunk.allSolid();
+                if (!all_air && !all_solid)
+                    return false;
+            }
+    return true;
+}
+
+void VoxelContainer::copyMeshBlocks(const glm::tvec3<cfg::Coord> & mesh_position, cfg::Block * padded) {
+    // blocks of the mesh and one around it (in world coordinates), decoded straight from the chunks they are in
+    const glm::tvec3<cfg::Coord> from{ mesh_position * cfg::MESH_SIZE + Math::add(cfg::MESH_OFFSET, -1) };
+    const glm::tvec3<cfg::Coord> to{ from + mesher::PADDED_SIZE };
+    glm::tvec3<cfg::Coord> i;
+    for (i.z = mesh_position.z + cfg::MESH_CHUNK_START.z; i.z < mesh_position.z + cfg::MESH_CHUNK_END.z; ++i.z)
+        for (i.y = mesh_position.y + cfg::MESH_CHUNK_START.y; i.y < mesh_position.y + cfg::MESH_CHUNK_END.y; ++i.y)
+            for (i.x = mesh_position.x + cfg::MESH_CHUNK_START.x; i.x < mesh_position.x + cfg::MESH_CHUNK_END.x; ++i.x) {
+                // assuming chunks are loaded now
+                const auto chunk_index = Math::position_to_index(i, cfg::CHUNK_ARRAY_SIZE);
+                const glm::tvec3<cfg::Coord> chunk_from{ i * cfg::CHUNK_SIZE };
+                const auto box_from = glm::max(from, chunk_from);
+                const auto box_to = glm::min(to, chunk_from + cfg::CHUNK_SIZE);
+                m_chunks[chunk_index].copyBox(box_from - chunk_from, box_to - box_from, padded, mesher::PADDED_SIZE, box_from - from);
             }
-    return meshes_to_load_count;
 }
 
 bool VoxelContainer::checkMeshes(const glm::tvec3<cfg::Coord> & chunk_position) {
@@ -296,30 +590,3 @@ void VoxelContainer::generateChunk(cfg::Block * chunk, const glm::tvec3<cfg::Coo
     // TODO: IDEA: second pass: if this is the last neighbour of any chunk that neighbour chunk can do a second loading pass (for more advanced and "non deterministic" world generators)
     worldgen::generate<worldgen::WorldGenType::SINE>(chunk, chunk_position);
 }
-
-void VoxelContainer::saveChunk(const cfg::Block * chunk, const glm::tvec3<cfg::Coord> & chunk_position, Region * region) {
-    assert(chunk != nullptr && region != nullptr);
-//    Print("Save ", glm::to_string(chunk_position));
-    region->saveChunk(Math::position_to_index(chunk_position, cfg::REGION_SIZE), chunk);
-}
-
-bool VoxelContainer::tryLoadChunk(cfg::Block * chunk, const glm::tvec3<cfg::Coord> & chunk_position, Region * region) {
-    assert(chunk != nullptr && region != nullptr);
-    return region->loadChunk(Math::position_to_index(chunk_position, cfg::REGION_SIZE), chunk);
-}
-
-Region * VoxelContainer::fetchRegionUseWorkerCache(const glm::tvec3<cfg::Coord> & region_position, WorkerData & worker_data) {
-    const auto region_index = Math::position_to_index(region_position, cfg::WORKER_REGION_CACHE_SIZE);
-    Region * * region = worker_data.regions.data() + region_index;
-    glm::tvec3<cfg::Coord> * position = worker_data.positions.data() + region_index;
-    if (*region != nullptr) {
-        if (glm::all(glm::equal(*position, region_position)))
-            return *region;
-        else
-            m_region_container.release(*position);
-    }
-    *position = region_position;
-    // don't worry about a pointer being overwritten, its all being taken care of :)
-    *region = &m_region_container.get(region_position);
-    return *region;
-}
@@ -1,75 +1,194 @@
 #pragma once
 
 #include <array>
+#include <vector>
+#include <memory>
 #include <thread>
 #include <atomic>
 #include "cfg.hpp"
 #include "VoxelIterator.hpp"
 #include "LockedQueue.hpp"
+#include "WorkStealingQueue.hpp"
 #include "Mesh.hpp"
-#include "ThreadBarrier.hpp"
 #include "RegionContainer.hpp"
+#include "ChunkIO.hpp"
+#include "ChunkWriter.hpp"
+#include "RegionPrefetcher.hpp"
+#include "PackedChunk.hpp"
+#include "mesher.hpp"
 
 class VoxelContainer {
 public:
     // public functions are not thread safe
-    VoxelContainer();
+    // thread_count 0: one worker per hardware thread (see cfg::MIN_WORKER_THREAD_COUNT)
+    VoxelContainer(size_t thread_count = 0);
     ~VoxelContainer();
     LockedQueue<Mesh, cfg::MESH_QUEUE_SIZE_LIMIT> & getQueue() { return m_mesh_queue; }
     // returns read only chunk data, returns nullptr if chunk not available at the moment
     // pointer is invalidated after next call to moveCenterChunk()
-    const cfg::Block * getChunk(const glm::tvec3<cfg::Coord> & chunk_position);
+    const PackedChunk * getChunk(const glm::tvec3<cfg::Coord> & chunk_position);
     // TODO: set chunks dirty
-    cfg::Block * getWritableChunk(const glm::tvec3<cfg::Coord> & chunk_position);
-    // these two functions may reset the iterator
+    PackedChunk * getWritableChunk(const glm::tvec3<cfg::Coord> & chunk_position);
+    // these two functions start a new epoch, the next pass loads around the new center (or remeshes)
     // IMPORTANT: invalidating meshes outside of chunks received from calls to getWritableChunk() since last call to moveCenterChunk() is undefined behaviour
     void invalidateMeshWithBlockRange(Math::AABB3<cfg::Coord> range);
+    // instead of invalidateMeshWithBlockRange() after blocks of range changed (same rules): the meshes around range
+    // are patched right away on this thread, only the quads of blocks whose faces or shading could have changed are
+    // made again (mesher::IndexedMesh, the first edit of a mesh makes all of it), no pass is started
+    // meshes of the patched positions still in getQueue() are older than the patches, they have to be taken before
+    // the patches are applied, there are no patches for empty meshes the scene has no entry for
+    // false if a mesh can't be patched (its chunks aren't all there), range is invalidated instead
+    bool patchMeshesWithBlockRange(const Math::AABB3<cfg::Coord> & range, std::vector<MeshPatch> & patches);
     void moveCenterChunk(const glm::tvec3<cfg::Coord> & new_center_chunk);
+    // includes whether prefetching regions ahead of the center chunk works out
+    const RegionContainer::Statistics & getRegionStatistics() const { return m_region_container.statistics(); }
+    // true once every chunk and mesh in the loading box around center_chunk is loaded (and no mesh is invalidated)
+    bool isLoaded(const glm::tvec3<cfg::Coord> & center_chunk) const;
+    // on by default: after the center moved, a pass goes through the chunks of meshes that entered the loading box
+    // only, instead of all of them (meshes being invalidated still make the next pass go through everything)
+    static void setIncrementalPasses(bool incremental);
+    // mesher for meshes generated after the call: MesherType::BITMASK (default, a quad per face),
+    // MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_BETTER_COPY (the same quads, a block at a time) or
+    // MesherType::GREEDY (fewer vertices where neighbouring faces are alike)
+    static void setMesher(mesher::MesherType type);
+    // on by default: meshes whose chunks are all air or all solid (see PackedChunk::allAir()) are empty without
+    // copying their blocks or running the mesher
+    static void setMeshSkipping(bool skip);
+
+    struct TaskStatistics {
+        size_t threads;
+        size_t loads;
+        size_t generates;
+        size_t meshes;
+        // mesh tasks that skipped the mesher, their chunks are all air or all solid
+        size_t skipped_meshes;
+        size_t saves;
+        // tasks run by another worker than the one that spawned them
+        size_t steals;
+    };
+    TaskStatistics getTaskStatistics() const;
 
 private:
     LockedQueue<Mesh, cfg::MESH_QUEUE_SIZE_LIMIT> m_mesh_queue;
-    std::array<cfg::Block, cfg::CHUNK_VOLUME * cfg::CHUNK_ARRAY_VOLUME> m_blocks;
+    // packed, memory grows with the variety of blocks in a chunk instead of CHUNK_VOLUME each
+    std::array<PackedChunk, cfg::CHUNK_ARRAY_VOLUME> m_chunks;
+    const size_t m_thread_count;
+    // flat chunks for loading, saving and meshing
+    struct WorkerBuffers {
+        // unpacked for ChunkWriter
+        std::vector<cfg::Block> chunk;
+        // blocks of the mesh being generated, see mesher::meshPadded()
+        std::vector<cfg::Block> padded;
+        // destinations of loads, one per load in flight (more are allocated when needed,
+        // buffers of generated chunks go to the worker that generated them)
+        std::vector<std::unique_ptr<cfg::Block[]>> loads;
+        // for compressing in save tasks
+        Region::Scratch scratch;
+    };
+    std::vector<WorkerBuffers> m_worker_buffers;
     // this atomic vec array makes me cry
     // without atomic -> undefined behaviour, but should work correctly on any common platforms anyway
     std::array<std::atomic<Math::DumbVec3>, cfg::CHUNK_ARRAY_VOLUME> m_chunk_positions;
     std::array<bool, cfg::CHUNK_ARRAY_VOLUME> m_chunk_dirty;
     VoxelIterator m_voxel_indices;
-    std::array<std::thread, cfg::WORKER_THREAD_COUNT> m_workers;
-    struct WorkerData {
-        // non owning pointers (reference counting is managed by RegionContainer)
-        std::array<Region *, cfg::WORKER_REGION_CACHE_VOLUME> regions;
-        std::array<glm::tvec3<cfg::Coord>, cfg::WORKER_REGION_CACHE_VOLUME> positions;
+    // jobs (chunk positions) of one go through m_voxel_indices.all() or a delta of it around a center chunk
+    // passes follow each other, the next one starts once every job of the last one is done (and every task
+    // spawned by them, save tasks aside), so chunks of different passes never fight over an array slot
+    struct Pass {
+        // m_epoch the pass was started for, jobs of older epochs outside the current loading box are skipped
+        size_t epoch;
+        glm::tvec3<cfg::Coord> center_chunk;
+        VoxelIterator::Indices indices;
+        // next job to take
+        std::atomic_size_t next{ 0 };
+        // jobs and tasks not done yet, who brings it to 0 ends the pass
+        std::atomic_size_t pending{ 0 };
     };
-    std::array<WorkerData, cfg::WORKER_THREAD_COUNT> m_workers_data;
+    // replaced with std::atomic_store() under m_center_lock, jobs keep their pass alive with std::atomic_load()
+    std::shared_ptr<Pass> m_pass;
+    // bumped by moveCenterChunk() and invalidateMeshWithBlockRange() under m_center_lock
+    std::atomic_size_t m_epoch;
+    // m_actual_center_chunk for workers
+    std::atomic<Math::DumbVec3> m_target_center_chunk;
+    // center of the last pass that went through without the center moving or meshes being invalidated,
+    // invalid if there is none since the last invalidation
+    std::atomic<Math::DumbVec3> m_loaded_center_chunk;
+    std::vector<std::thread> m_workers;
     std::atomic_bool m_workers_running;
-    std::atomic_size_t m_iterator;
+    // center of the current pass, only read by the main thread under m_center_lock
     glm::tvec3<cfg::Coord> m_loader_center_chunk;
     glm::tvec3<cfg::Coord> m_actual_center_chunk;
     Math::AABB3<cfg::Coord> m_center_chunk_overlap;
     std::mutex m_center_lock;
-    using MeshReadinesType = uint8_t;
-    std::array<std::atomic<MeshReadinesType>, cfg::MESH_ARRAY_VOLUME> m_mesh_readines;
+    // chunks of the current pass each mesh still waits for, its mesh task is spawned by the one bringing it to 0
+    std::array<std::atomic<uint8_t>, cfg::MESH_ARRAY_VOLUME> m_mesh_missing_chunks;
     std::array<std::atomic<Math::DumbVec3>, cfg::MESH_ARRAY_VOLUME> m_mesh_positions;
     std::array<bool, cfg::MESH_ARRAY_VOLUME> m_mesh_empties;
-    ThreadBarrier m_barrier;
-    // used for more than what the name suggests
-    std::atomic_bool m_center_dirty;
-    std::atomic_size_t m_workers_finished;
+    // bumped by every mesh task, patches of an older mesh are dropped
+    std::array<std::atomic<uint32_t>, cfg::MESH_ARRAY_VOLUME> m_mesh_generations;
+    // meshes patched by patchMeshesWithBlockRange(), only used by the main thread
+    struct EditedMesh {
+        glm::tvec3<cfg::Coord> position;
+        uint32_t generation;
+        // m_edit_count of the last patch
+        size_t last_edit;
+        std::unique_ptr<mesher::IndexedMesh> mesh;
+    };
+    std::vector<EditedMesh> m_edited_meshes;
+    size_t m_edit_count;
+    std::vector<cfg::Block> m_edit_padded;
+    // work besides the jobs of the pass, workers run their own tasks first, then steal, then take jobs
+    // LOAD: a job of the pass, taken from m_pass in order (never queued)
+    // GENERATE: chunk the region doesn't have, holds the buffer of its load
+    // MESH: mesh whose chunks are all ready
+    // SAVE: compress and save chunks evicted into m_chunk_writer
+    enum class TaskType { LOAD, GENERATE, MESH, SAVE };
+    struct Task {
+        TaskType type;
+        // chunk (GENERATE) or mesh (MESH)
+        glm::tvec3<cfg::Coord> position;
+        std::unique_ptr<cfg::Block[]> chunk;
+    };
+    WorkStealingQueue<Task> m_tasks;
+    std::array<std::atomic_size_t, 4> m_task_counts;
+    std::atomic_size_t m_skipped_meshes;
+    // workers waiting on m_condition, who pushes a task wakes one of them
+    std::atomic_size_t m_sleeping_workers;
+    // workers without jobs or tasks wait for the next pass (or the next epoch to start one for, or tasks)
     std::condition_variable m_condition;
     RegionContainer m_region_container;
-
-    static_assert(cfg::MESH_CHUNK_VOLUME == 8);
-    static constexpr MeshReadinesType ALL_CHUNKS_READY{ 0b11111111 };
+    // one queue per worker, loads hold a reference to their region until completed
+    ChunkIO m_chunk_io;
+    // evicted dirty chunks, loads look here first, written by save tasks
+    ChunkWriter m_chunk_writer{ m_region_container, false };
+    // opens regions ahead of the center chunk
+    RegionPrefetcher m_region_prefetcher{ m_region_container };
 
     void worker(size_t thread_id);
-    void clearMeshReadines();
-    std::size_t markMeshes(const glm::tvec3<cfg::Coord> & chunk_position, std::array<glm::tvec3<cfg::Coord>, cfg::CHUNK_MESH_VOLUME> & meshes_to_load);
+    // loads (or submits the load of) the chunk of a job, false if the job is done when finishChunkLoad() is
+    bool runJob(size_t thread_id, const Pass & pass, const glm::tvec3<cfg::Coord> & chunk_position);
+    // called by the worker finishing the last job of pass
+    void endPass(const Pass & pass);
+    // with m_center_lock held, around m_actual_center_chunk for the current epoch
+    void startPass();
+    // pending job or task of the current pass done, ends the pass if it was the last one
+    void finishJob();
+    // wakes a waiting worker for it, GENERATE and MESH tasks must be counted as pending by the pass before
+    void spawn(size_t thread_id, Task && task);
+    void runTask(size_t thread_id, Task & task);
+    void finishChunkLoad(size_t thread_id, const ChunkIO::Request & request);
+    // packs chunk and spawns the mesh tasks of meshes that don't wait for other chunks anymore
+    void finishChunk(size_t thread_id, const glm::tvec3<cfg::Coord> & chunk_position, std::unique_ptr<cfg::Block[]> chunk, bool generated);
+    void chunkReady(size_t thread_id, const glm::tvec3<cfg::Coord> & chunk_position);
+    void meshTask(size_t thread_id, const glm::tvec3<cfg::Coord> & mesh_position);
     bool checkMeshes(const glm::tvec3<cfg::Coord> & chunk_position);
     void generateChunk(cfg::Block * chunk, const glm::tvec3<cfg::Coord> & chunk_position);
-    void generateMesh(const glm::tvec3<cfg::Coord> & mesh_position, std::vector<cfg::Vertex> & mesh);
-    cfg::Block * getChunkNonConst(const glm::tvec3<cfg::Coord> & chunk_position);
-    void saveChunk(const cfg::Block * chunk, const glm::tvec3<cfg::Coord> & chunk_position, Region * region);
-    // return true if loading successful (aka. chunk found in storage)
-    bool tryLoadChunk(cfg::Block * chunk, const glm::tvec3<cfg::Coord> & chunk_position, Region * region);
-    Region * fetchRegionUseWorkerCache(const glm::tvec3<cfg::Coord> & region_position, WorkerData & worker_data);
+    void generateMesh(size_t thread_id, const glm::tvec3<cfg::Coord> & mesh_position, std::vector<cfg::Vertex> & mesh);
+    // the blocks of the mesh and one around it (all in its chunks) are all air or all solid, no face is visible
+    bool faceless(const glm::tvec3<cfg::Coord> & mesh_position) const;
+    // blocks of the mesh and one around it (see mesher::PADDED_SIZE), its chunks have to be there
+    void copyMeshBlocks(const glm::tvec3<cfg::Coord> & mesh_position, cfg::Block * padded);
+    // mesh and its chunks are there (mesh_index is the slot of mesh_position)
+    bool patchable(const glm::tvec3<cfg::Coord> & mesh_position, cfg::Coord mesh_index);
+    PackedChunk * getChunkNonConst(const glm::tvec3<cfg::Coord> & chunk_position);
 };
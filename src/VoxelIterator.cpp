@@ -4,37 +4,72 @@
 #include <algorithm>
 #include <unordered_set>
 #include <glm/glm.hpp>
-#include <glm/gtx/hash.hpp>
 #include "Math.hpp"
 
 VoxelIterator::VoxelIterator() {
     glm::tvec3<cfg::Coord> i;
-    std::vector<glm::tvec3<cfg::Coord>> mesh_indices;
-    mesh_indices.reserve(cfg::MESH_LOADING_VOLUME);
+    m_mesh_indices.reserve(cfg::MESH_LOADING_VOLUME);
     for (i.z = -cfg::MESH_LOADING_RADIUS.z; i.z <= cfg::MESH_LOADING_RADIUS.z; ++i.z)
         for (i.y = -cfg::MESH_LOADING_RADIUS.y; i.y <= cfg::MESH_LOADING_RADIUS.y; ++i.y)
             for (i.x = -cfg::MESH_LOADING_RADIUS.x; i.x <= cfg::MESH_LOADING_RADIUS.x; ++i.x)
-                mesh_indices.push_back(i);
+                m_mesh_indices.push_back(i);
 
     std::sort(
-        std::begin(mesh_indices), std::end(mesh_indices),
+        std::begin(m_mesh_indices), std::end(m_mesh_indices),
         [](const glm::tvec3<cfg::Coord> & a, const glm::tvec3<cfg::Coord> & b) {
             // sort by distance from (0,0,0)
             return Math::dot(a, a) < Math::dot(b, b);
         }
     );
 
-    std::unordered_set<glm::tvec3<cfg::Coord>> chunk_indices_map;
+    m_indices = chunksOf(m_mesh_indices);
+}
+
+const glm::tvec3<cfg::Coord> & VoxelIterator::operator [] (size_t i) const {
+    assert(i < m_indices->size());
+    return (*m_indices)[i];
+}
 
-    for (const auto & mi : mesh_indices)
+const VoxelIterator::Indices & VoxelIterator::delta(const glm::tvec3<cfg::Coord> & move) {
+    const auto found = m_deltas.find(move);
+    if (found != m_deltas.end())
+        return found->second;
+    if (m_deltas.size() == cfg::DELTA_CACHE_SIZE)
+        m_deltas.clear();
+    // mesh i around the new center is i + move around the old one
+    std::vector<glm::tvec3<cfg::Coord>> meshes;
+    for (const auto & mi : m_mesh_indices)
+        if (glm::any(glm::greaterThan(glm::abs(mi + move), cfg::MESH_LOADING_RADIUS)))
+            meshes.push_back(mi);
+    return m_deltas.emplace(move, chunksOf(meshes)).first->second;
+}
+
+bool VoxelIterator::keepsSlots(const glm::tvec3<cfg::Coord> & move) {
+    // chunks of the meshes in the loading box, meshes keep their slots too (same array size, smaller box)
+    static constexpr glm::tvec3<cfg::Coord> CHUNK_LOADING_SIZE{ Math::add(Math::add(cfg::MESH_LOADING_SIZE, cfg::MESH_CHUNK_SIZE), -1) };
+    static_assert(
+        cfg::MESH_ARRAY_SIZE.x == cfg::CHUNK_ARRAY_SIZE.x &&
+        cfg::MESH_ARRAY_SIZE.y == cfg::CHUNK_ARRAY_SIZE.y &&
+        cfg::MESH_ARRAY_SIZE.z == cfg::CHUNK_ARRAY_SIZE.z
+    );
+    return glm::all(glm::lessThanEqual(glm::abs(move), Math::sub(cfg::CHUNK_ARRAY_SIZE, CHUNK_LOADING_SIZE)));
+}
+
+bool VoxelIterator::contains(const glm::tvec3<cfg::Coord> & offset) {
+    return
+        glm::all(glm::greaterThanEqual(offset, Math::sub(cfg::MESH_CHUNK_START, cfg::MESH_LOADING_RADIUS))) &&
+        glm::all(glm::lessThan(offset, Math::add(cfg::MESH_CHUNK_END, cfg::MESH_LOADING_RADIUS)));
+}
+
+VoxelIterator::Indices VoxelIterator::chunksOf(const std::vector<glm::tvec3<cfg::Coord>> & meshes) {
+    auto chunks = std::make_shared<std::vector<glm::tvec3<cfg::Coord>>>();
+    std::unordered_set<glm::tvec3<cfg::Coord>> chunk_indices_map;
+    glm::tvec3<cfg::Coord> i;
+    for (const auto & mi : meshes)
         for (i.z = mi.z + cfg::MESH_CHUNK_START.z; i.z < mi.z + cfg::MESH_CHUNK_END.z; ++i.z)
             for (i.y = mi.y + cfg::MESH_CHUNK_START.y; i.y < mi.y + cfg::MESH_CHUNK_END.y; ++i.y)
                 for (i.x = mi.x + cfg::MESH_CHUNK_START.x; i.x < mi.x + cfg::MESH_CHUNK_END.x; ++i.x)
                     if (chunk_indices_map.insert(i).second)
-                        m_indices.push_back(i);
-}
-
-const glm::tvec3<cfg::Coord> & VoxelIterator::operator [] (size_t i) const {
-    assert(i < m_indices.size());
-    return m_indices[i];
+                        chunks->push_back(i);
+    return chunks;
 }
@@ -2,14 +2,39 @@
 
 #include "cfg.hpp"
 #include <vector>
+#include <memory>
+#include <unordered_map>
+#include <glm/gtx/hash.hpp>
 
+// chunk positions (relative to the center chunk) in the order they are loaded: by distance of the meshes they
+// belong to, so meshes near the center are ready first
 class VoxelIterator {
 public:
+    // lists stay valid as long as someone holds them (a new delta doesn't change the previous one)
+    using Indices = std::shared_ptr<const std::vector<glm::tvec3<cfg::Coord>>>;
+
     VoxelIterator();
     const glm::tvec3<cfg::Coord> & operator [] (size_t i) const;
-    std::size_t size() const { return m_indices.size(); }
+    std::size_t size() const { return m_indices->size(); }
+    const Indices & all() const { return m_indices; }
+    // chunks of the meshes that are in the loading box after the center moved by move but weren't before,
+    // in the same order (all chunks if nothing is left of the old box), relative to the new center
+    // results are kept, moving on in the same direction (or back and forth) costs nothing, not thread safe
+    const Indices & delta(const glm::tvec3<cfg::Coord> & move);
+    // false if a chunk around a center moved by move can take the array slot (cfg::CHUNK_ARRAY_SIZE) of one around
+    // the old center, loading around the new center may then have replaced chunks the delta assumes are there
+    static bool keepsSlots(const glm::tvec3<cfg::Coord> & move);
+    // whether a chunk at offset from the center is one of all()
+    static bool contains(const glm::tvec3<cfg::Coord> & offset);
 
 private:
-    std::vector<glm::tvec3<cfg::Coord>> m_indices;
+    Indices m_indices;
+    // meshes by distance from the center
+    std::vector<glm::tvec3<cfg::Coord>> m_mesh_indices;
+    // by move, cleared once it holds cfg::DELTA_CACHE_SIZE of them
+    std::unordered_map<glm::tvec3<cfg::Coord>, Indices> m_deltas;
+
+    // chunks of meshes in order, each once
+    static Indices chunksOf(const std::vector<glm::tvec3<cfg::Coord>> & meshes);
 
 };
@@ -1,5 +1,7 @@
 #include "VoxelScene.hpp"
 
+#include <cstddef>
+#include <algorithm>
 #include "Ray.hpp"
 #include "Print.hpp"
 
@@ -17,11 +19,11 @@ void VoxelScene::update(const glm::ivec3 & center, LockedQueue<Mesh, cfg::MESH_Q
     Ray<float, cfg::Coord>::State ray_state = ray.next();
     m_before_selected_block = ray_state.block_position + player_offset_i;
     glm::tvec3<cfg::Coord> chunk_position = Math::floor_div(ray_state.block_position + player_offset_i, cfg::CHUNK_SIZE);
-    const cfg::Block * chunk = vc.getChunk(chunk_position);
+    const PackedChunk * chunk = vc.getChunk(chunk_position);
     m_block_hit = false;
     while (ray_state.distance <= cfg::MAX_RAY_LENGTH && chunk != nullptr) {
         const auto block_index = Math::position_to_index(ray_state.block_position + player_offset_i, cfg::CHUNK_SIZE);
-        const cfg::Block & block = chunk[block_index];
+        const cfg::Block block = chunk->get(block_index);
         if (block != cfg::Block{ 0 }) {
             m_block_hit = true;
             break;
@@ -64,10 +66,23 @@ void VoxelScene::update(const glm::ivec3 & center, LockedQueue<Mesh, cfg::MESH_Q
     for (size_t i = 0; i < queue_elements; ++i) {
         const Placement placement = m_block_update_queue.front();
         m_block_update_queue.pop();
-        cfg::Block * const chunk = vc.getWritableChunk(Math::floor_div(placement.position, cfg::CHUNK_SIZE));
+        PackedChunk * const chunk = vc.getWritableChunk(Math::floor_div(placement.position, cfg::CHUNK_SIZE));
         if (chunk != nullptr) {
-            chunk[Math::position_to_index(placement.position, cfg::CHUNK_SIZE)] = placement.block;
-            vc.invalidateMeshWithBlockRange({ placement.position, placement.position });
+            chunk->set(Math::position_to_index(placement.position, cfg::CHUNK_SIZE), placement.block);
+            if (vc.patchMeshesWithBlockRange({ placement.position, placement.position }, m_mesh_patches)) {
+                // meshes of the patched positions in the queue were made before the edit, the others
+                // wait for the per frame limit
+                m_patched_queued_meshes.clear();
+                queue.popIf(m_patched_queued_meshes, [this](const Mesh & m) {
+                    return std::any_of(std::begin(m_mesh_patches), std::end(m_mesh_patches), [&m](const MeshPatch & patch) {
+                        return glm::all(glm::equal(patch.position, m.position));
+                    });
+                });
+                for (Mesh & m : m_patched_queued_meshes)
+                    uploadMesh(std::move(m));
+                for (const MeshPatch & patch : m_mesh_patches)
+                    applyPatch(patch);
+            }
         } else {
             m_block_update_queue.push(placement);
         }
@@ -90,47 +105,84 @@ void VoxelScene::update(const glm::ivec3 & center, LockedQueue<Mesh, cfg::MESH_Q
     // upload meshes
     Mesh m;
     size_t work_left = cfg::MAX_MESH_UPDATES_PER_FRAME;
-    while (work_left-- > 0 && queue.pop(std::move(m))) {
-        ChunkMesh chunk_mesh;
-        const size_t vetrex_count = m.mesh.size();
-        if (vetrex_count == 0) {
-            const auto mesh_entry = m_meshes.find(m.position);
-            assert(mesh_entry != m_meshes.end());
-            glDeleteBuffers(1, &mesh_entry->second.VBO);
-            glDeleteVertexArrays(1, &mesh_entry->second.VAO);
-            m_meshes.erase(m.position);
-            continue;
-        }
-        // size should always be divisible by 2
-        chunk_mesh.element_count = vetrex_count + (vetrex_count / 2);
-
-        glGenVertexArrays(1, &chunk_mesh.VAO);
-        glGenBuffers(1, &chunk_mesh.VBO);
-        glBindVertexArray(chunk_mesh.VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, chunk_mesh.VBO);
-        m_quad_ebo.bind();
-        m_quad_ebo.resize(chunk_mesh.element_count);
-        // TODO: glVertexAttribPointer + GL_UNSIGNED_BYTE
-        glVertexAttribIPointer(0, 3, GL_UNSIGNED_BYTE, sizeof(cfg::Vertex), (GLvoid *)(0));
-        glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, sizeof(cfg::Vertex), (GLvoid *)(3));
-        glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, sizeof(cfg::Vertex), (GLvoid *)(4));
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
-        glBindVertexArray(0);
+    while (work_left-- > 0 && queue.pop(std::move(m)))
+        uploadMesh(std::move(m));
+}
 
-        glBindBuffer(GL_ARRAY_BUFFER, chunk_mesh.VBO);
-        glBufferData(GL_ARRAY_BUFFER, m.mesh.size() * sizeof(m.mesh[0]), m.mesh.data(), GL_STATIC_DRAW);
-        
+VoxelScene::ChunkMesh VoxelScene::createChunkMesh(const std::vector<cfg::Vertex> & mesh, GLsizei capacity) {
+    ChunkMesh chunk_mesh;
+    chunk_mesh.capacity = capacity;
+    // size should always be divisible by 2
+    chunk_mesh.element_count = mesh.size() + (mesh.size() / 2);
+
+    glGenVertexArrays(1, &chunk_mesh.VAO);
+    glGenBuffers(1, &chunk_mesh.VBO);
+    glBindVertexArray(chunk_mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk_mesh.VBO);
+    m_quad_ebo.bind();
+    m_quad_ebo.resize(capacity + (capacity / 2));
+    // TODO: glVertexAttribPointer + GL_UNSIGNED_BYTE
+    glVertexAttribIPointer(0, 3, GL_UNSIGNED_BYTE, sizeof(cfg::Vertex), (GLvoid *)(0));
+    glVertexAttribIPointer(1, 1, sizeof(cfg::Block) == 1 ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT, sizeof(cfg::Vertex), (GLvoid *)(offsetof(cfg::Vertex, block)));
+    glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, sizeof(cfg::Vertex), (GLvoid *)(3));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, chunk_mesh.VBO);
+    if (static_cast<size_t>(capacity) == mesh.size()) {
+        glBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(mesh[0]), mesh.data(), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(mesh[0]), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, mesh.size() * sizeof(mesh[0]), mesh.data());
+    }
+    return chunk_mesh;
+}
+
+void VoxelScene::replaceChunkMesh(const glm::tvec3<cfg::Coord> & position, const ChunkMesh & chunk_mesh) {
+    const auto mesh_entry = m_meshes.find(position);
+    if (mesh_entry != m_meshes.end()) {
+        glDeleteBuffers(1, &mesh_entry->second.VBO);
+        glDeleteVertexArrays(1, &mesh_entry->second.VAO);
+        mesh_entry->second = chunk_mesh;
+    } else {
+        m_meshes.insert({ position, chunk_mesh });
+    }
+}
+
+void VoxelScene::uploadMesh(Mesh && m) {
+    if (m.mesh.size() == 0) {
         const auto mesh_entry = m_meshes.find(m.position);
-        if (mesh_entry != m_meshes.end()) {
-            glDeleteBuffers(1, &mesh_entry->second.VBO);
-            glDeleteVertexArrays(1, &mesh_entry->second.VAO);
-            mesh_entry->second = chunk_mesh;
-        } else {
-            m_meshes.insert({ m.position, chunk_mesh });
-        }
+        assert(mesh_entry != m_meshes.end());
+        glDeleteBuffers(1, &mesh_entry->second.VBO);
+        glDeleteVertexArrays(1, &mesh_entry->second.VAO);
+        m_meshes.erase(m.position);
+        return;
+    }
+    replaceChunkMesh(m.position, createChunkMesh(m.mesh, static_cast<GLsizei>(m.mesh.size())));
+}
+
+void VoxelScene::applyPatch(const MeshPatch & patch) {
+    const std::vector<cfg::Vertex> & mesh = *patch.mesh;
+    const auto mesh_entry = m_meshes.find(patch.position);
+    if (patch.full || mesh_entry == m_meshes.end() || mesh.size() > static_cast<size_t>(mesh_entry->second.capacity)) {
+        // room for the quads the next edits add
+        const size_t capacity{ mesh.size() + mesh.size() / 4 + 4 * 64 };
+        replaceChunkMesh(patch.position, createChunkMesh(mesh, static_cast<GLsizei>(capacity)));
+        return;
+    }
+    // only the quads that changed, a run of them at a time
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_entry->second.VBO);
+    static constexpr size_t QUAD_SIZE{ 4 * sizeof(cfg::Vertex) };
+    for (size_t i = 0; i < patch.quads.size();) {
+        size_t run = 1;
+        while (i + run < patch.quads.size() && patch.quads[i + run] == patch.quads[i] + run)
+            ++run;
+        glBufferSubData(GL_ARRAY_BUFFER, patch.quads[i] * QUAD_SIZE, run * QUAD_SIZE, &mesh[patch.quads[i] * 4]);
+        i += run;
     }
+    mesh_entry->second.element_count = mesh.size() + (mesh.size() / 2);
 }
 
 void VoxelScene::draw(GLint offset_uniform, const std::array<glm::vec4, 6> & planes, glm::tvec3<cfg::Coord> offset_offset) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <queue>
 #include <unordered_map>
 #include <glm/vec3.hpp>
 #include "QuadEBO.hpp"
@@ -33,6 +34,8 @@ private:
     struct ChunkMesh {
         GLuint VAO, VBO;
         GLsizei element_count;
+        // vertices the VBO has room for
+        GLsizei capacity;
     };
     struct KeyHash {
     std::size_t operator () (const glm::ivec3 & k) const {
@@ -45,5 +48,15 @@ private:
     // TODO: use Coord (cfg.hpp)
     // TODO: based on SparseMap try to also use std::vector for potentially faster iteration
     std::unordered_map<glm::ivec3, ChunkMesh, KeyHash, KeyEqual> m_meshes;
+    std::vector<MeshPatch> m_mesh_patches;
+    std::vector<Mesh> m_patched_queued_meshes;
+
+    ChunkMesh createChunkMesh(const std::vector<cfg::Vertex> & mesh, GLsizei capacity);
+    void replaceChunkMesh(const glm::tvec3<cfg::Coord> & position, const ChunkMesh & chunk_mesh);
+    // an empty mesh removes the mesh at its position
+    void uploadMesh(Mesh && m);
+    // patched meshes keep room for more quads, grown (uploaded in full) if it isn't enough, the
+    // patches of a mesh without an entry aren't empty (VoxelContainer::patchMeshesWithBlockRange())
+    void applyPatch(const MeshPatch & patch);
 
 };
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+// tasks of a pool of threads, one deque per thread
+// the owner pushes and pops at the back (newest first, what it works on is still in cache),
+// threads without tasks steal from the front of the others (oldest first)
+// a deque is only contended while being stolen from
+template <typename T>
+class WorkStealingQueue {
+public:
+    struct Statistics {
+        std::atomic<size_t> pushed{ 0 };
+        // tasks popped from the deque of another thread
+        std::atomic<size_t> steals{ 0 };
+    };
+
+    WorkStealingQueue(size_t thread_count) : m_deques(thread_count), m_size{ 0 } {}
+
+    void push(size_t thread, T && task) {
+        {
+            std::lock_guard<std::mutex> lock{ m_deques[thread].mutex };
+            m_deques[thread].tasks.push_back(std::move(task));
+        }
+        m_size.fetch_add(1);
+        m_stats.pushed.fetch_add(1);
+    }
+
+    // own tasks first, returns false if every deque is empty
+    bool pop(size_t thread, T & task) {
+        if (m_size.load() == 0)
+            return false;
+        if (take(thread, task, false))
+            return true;
+        for (size_t i = 1; i < m_deques.size(); ++i) {
+            if (take((thread + i) % m_deques.size(), task, true)) {
+                m_stats.steals.fetch_add(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // tasks in all deques, might be outdated right away
+    size_t size() const { return m_size.load(); }
+    const Statistics & statistics() const { return m_stats; }
+
+private:
+    struct alignas(64) Deque {
+        std::mutex mutex;
+        std::deque<T> tasks;
+    };
+
+    std::vector<Deque> m_deques;
+    std::atomic<size_t> m_size;
+    Statistics m_stats;
+
+    bool take(size_t thread, T & task, bool front) {
+        Deque & deque = m_deques[thread];
+        std::lock_guard<std::mutex> lock{ deque.mutex };
+        if (deque.tasks.empty())
+            return false;
+        if (front) {
+            task = std::move(deque.tasks.front());
+            deque.tasks.pop_front();
+        } else {
+            task = std::move(deque.tasks.back());
+            deque.tasks.pop_back();
+        }
+        m_size.fetch_sub(1);
+        return true;
+    }
+
+};
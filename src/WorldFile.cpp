@@ -0,0 +1,262 @@
+#include "WorldFile.hpp"
+
+#include <array>
+#include <memory>
+#include <cstdio>
+#include <cstddef>
+#include <stdexcept>
+#include <cassert>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Codec.hpp"
+
+namespace {
+    // decides which file a region is stored in, never change
+    size_t shardOf(const glm::tvec3<cfg::Coord> & region_position) {
+        uint32_t hash{
+            (static_cast<uint32_t>(region_position.x) * 73856093u) ^
+            (static_cast<uint32_t>(region_position.y) * 19349663u) ^
+            (static_cast<uint32_t>(region_position.z) * 83492791u)
+        };
+        // the low bits alone repeat along diagonals, mix in the high ones (murmur3 finalizer)
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return hash % cfg::WORLD_FILE_COUNT;
+    }
+
+    constexpr size_t REGION_ENTRY_SIZE{ 6 };
+    constexpr size_t FREE_ENTRY_SIZE{ 2 };
+}
+
+WorldFile & WorldFile::get(const glm::tvec3<cfg::Coord> & region_position) {
+    static std::mutex mutex;
+    static std::array<std::unique_ptr<WorldFile>, cfg::WORLD_FILE_COUNT> files;
+    const size_t shard{ shardOf(region_position) };
+    std::lock_guard<std::mutex> lock{ mutex };
+    if (!files[shard]) {
+        std::array<char, 32> file_name;
+        std::snprintf(std::begin(file_name), file_name.size(), "%s/world.%zu", "world", shard);
+        files[shard] = std::make_unique<WorldFile>(file_name.data());
+    }
+    return *files[shard];
+}
+
+WorldFile::WorldFile(const char * file_name) {
+    m_fd = open(file_name, O_RDWR | O_CREAT, 0666);
+    if (m_fd < 0)
+        throw std::runtime_error("Failed to open world file.");
+    struct stat file_info;
+    fstat(m_fd, &file_info);
+
+    m_sequence = 0;
+    m_end = HEADER_SIZE;
+    m_index_extent = { 0, 0 };
+    if (file_info.st_size == 0) {
+        // an empty index
+        Header header{ MAGIC, VERSION, m_sequence, m_end, 0, 0, 0, 0, 0 };
+        header.checksum = codec::checksum(&header, offsetof(Header, checksum));
+        ftruncate(m_fd, HEADER_SIZE);
+        pwrite(m_fd, &header, sizeof(header), 0);
+        return;
+    }
+
+    // a crash while committing can only break the copy that was being written
+    Header header, other_header;
+    const bool valid{ readHeader(0, header) };
+    if (readHeader(1, other_header) && (!valid || other_header.sequence > header.sequence))
+        header = other_header;
+    else if (!valid)
+        throw std::runtime_error("World file has no valid header.");
+    m_sequence = header.sequence;
+    m_end = header.end;
+    m_index_extent = { header.index_position, header.index_capacity };
+    readIndex(header);
+}
+
+WorldFile::~WorldFile() {
+    // regions commit themselves, the index is always committed
+    close(m_fd);
+}
+
+bool WorldFile::readHeader(cfg::RegUint copy, Header & header) {
+    header = Header{};
+    pread(m_fd, &header, sizeof(header), copy * HEADER_COPY_SIZE);
+    return header.magic == MAGIC && (header.version == VERSION || header.version == 3 || header.version == 2 || header.version == 1) &&
+        header.checksum == codec::checksum(&header, offsetof(Header, checksum));
+}
+
+void WorldFile::readIndex(const Header & header) {
+    if (header.index_size == 0)
+        return;
+    std::vector<cfg::RegUint> index(header.index_size / sizeof(cfg::RegUint));
+    pread(m_fd, index.data(), header.index_size, header.index_position);
+    if (codec::checksum(index.data(), header.index_size) != header.index_checksum)
+        throw std::runtime_error("World file index is corrupt.");
+
+    size_t i{ 0 };
+    const size_t region_count{ index[i++] };
+    m_index.reserve(region_count);
+    for (size_t r = 0; r < region_count; ++r, i += REGION_ENTRY_SIZE) {
+        const glm::tvec3<cfg::Coord> region_position{
+            static_cast<cfg::Coord>(index[i]), static_cast<cfg::Coord>(index[i + 1]), static_cast<cfg::Coord>(index[i + 2])
+        };
+        m_index[region_position] = { { index[i + 3], index[i + 4] }, index[i + 5] };
+    }
+    const size_t free_count{ index[i++] };
+    for (size_t f = 0; f < free_count; ++f, i += FREE_ENTRY_SIZE)
+        free({ index[i], index[i + 1] });
+}
+
+bool WorldFile::readRegion(const glm::tvec3<cfg::Coord> & region_position, void * table, size_t table_size) {
+    m_stats.lookups.fetch_add(1);
+    Entry entry;
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        const auto found = m_index.find(region_position);
+        if (found == m_index.end())
+            return false;
+        entry = found->second;
+    }
+    // committed extents are not reused while they are in the index
+    pread(m_fd, table, table_size, entry.table.position);
+    if (codec::checksum(table, table_size) != entry.table_checksum)
+        throw std::runtime_error("Region slot table in world file is corrupt.");
+    return true;
+}
+
+cfg::RegUint WorldFile::allocate(cfg::RegUint capacity) {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return allocateLocked(capacity);
+}
+
+cfg::RegUint WorldFile::allocateLocked(cfg::RegUint capacity) {
+    m_stats.allocations.fetch_add(1);
+    const auto best = m_free_by_capacity.lower_bound({ capacity, 0 });
+    if (best != m_free_by_capacity.end()) {
+        const Extent extent{ best->second, best->first };
+        m_free_by_capacity.erase(best);
+        m_free.erase(extent.position);
+        if (extent.capacity > capacity) {
+            // rest stays free
+            m_free.emplace(extent.position + capacity, extent.capacity - capacity);
+            m_free_by_capacity.emplace(extent.capacity - capacity, extent.position + capacity);
+        }
+        m_stats.reused.fetch_add(1);
+        return extent.position;
+    }
+    if (size_t(m_end) + capacity > size_t{ cfg::RegUint(-1) })
+        throw std::runtime_error("World file full.");
+    const cfg::RegUint position{ m_end };
+    m_end += capacity;
+    return position;
+}
+
+void WorldFile::free(const Extent & extent) {
+    if (extent.capacity == 0)
+        return;
+    Extent merged{ extent };
+    // merge with neighbours
+    auto next = m_free.lower_bound(merged.position);
+    if (next != m_free.begin()) {
+        const auto previous = std::prev(next);
+        if (previous->first + previous->second == merged.position) {
+            merged = { previous->first, previous->second + merged.capacity };
+            m_free_by_capacity.erase({ previous->second, previous->first });
+            m_free.erase(previous);
+        }
+    }
+    if (next != m_free.end() && merged.position + merged.capacity == next->first) {
+        merged.capacity += next->second;
+        m_free_by_capacity.erase({ next->second, next->first });
+        m_free.erase(next);
+    }
+    if (merged.position + merged.capacity == m_end) {
+        // last extent, give back to the end of the file
+        m_end = merged.position;
+        return;
+    }
+    m_free.emplace(merged.position, merged.capacity);
+    m_free_by_capacity.emplace(merged.capacity, merged.position);
+}
+
+void WorldFile::commitRegion(const glm::tvec3<cfg::Coord> & region_position, const void * table, size_t table_size, std::vector<Extent> & freed) {
+    std::lock_guard<std::mutex> commit_lock{ m_commit_mutex };
+    const Extent table_extent{ allocate(table_size), static_cast<cfg::RegUint>(table_size) };
+    const Entry entry{ table_extent, codec::checksum(table, table_size) };
+    pwrite(m_fd, table, table_size, table_extent.position);
+
+    Extent old_table{ 0, 0 };
+    Extent index_extent;
+    Header header;
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        const auto old_entry = m_index.find(region_position);
+        if (old_entry != m_index.end())
+            old_table = old_entry->second.table;
+        // allocating can split a free extent, leave room for one more free extent
+        const size_t region_count{ m_index.size() + (old_entry == m_index.end() ? 1 : 0) };
+        const size_t free_count{ m_free.size() + freed.size() + 3 };
+        const cfg::RegUint index_capacity{ static_cast<cfg::RegUint>(
+            (2 + region_count * REGION_ENTRY_SIZE + free_count * FREE_ENTRY_SIZE) * sizeof(cfg::RegUint)
+        ) };
+        index_extent = { allocateLocked(index_capacity), index_capacity };
+
+        // the index as it is once this commit is done, extents the latest header still reaches are free by then
+        m_index_buffer.clear();
+        m_index_buffer.push_back(static_cast<cfg::RegUint>(region_count));
+        auto push_region = [this](const glm::tvec3<cfg::Coord> & position, const Entry & region_entry) {
+            m_index_buffer.insert(m_index_buffer.end(), {
+                static_cast<cfg::RegUint>(position.x), static_cast<cfg::RegUint>(position.y), static_cast<cfg::RegUint>(position.z),
+                region_entry.table.position, region_entry.table.capacity, region_entry.table_checksum
+            });
+        };
+        for (const auto & region : m_index)
+            if (!glm::all(glm::equal(region.first, region_position)))
+                push_region(region.first, region.second);
+        push_region(region_position, entry);
+        const size_t free_count_position{ m_index_buffer.size() };
+        m_index_buffer.push_back(0);
+        size_t written_free{ 0 };
+        auto push_free = [this, &written_free](const Extent & extent) {
+            if (extent.capacity == 0)
+                return;
+            m_index_buffer.insert(m_index_buffer.end(), { extent.position, extent.capacity });
+            ++written_free;
+        };
+        for (const auto & extent : m_free)
+            push_free({ extent.first, extent.second });
+        for (const Extent & extent : freed)
+            push_free(extent);
+        push_free(old_table);
+        push_free(m_index_extent);
+        m_index_buffer[free_count_position] = static_cast<cfg::RegUint>(written_free);
+        header = { MAGIC, VERSION, m_sequence + 1, m_end, index_extent.position, index_extent.capacity, 0, 0, 0 };
+    }
+    header.index_size = static_cast<cfg::RegUint>(m_index_buffer.size() * sizeof(cfg::RegUint));
+    assert(header.index_size <= header.index_capacity);
+    header.index_checksum = codec::checksum(m_index_buffer.data(), header.index_size);
+    header.checksum = codec::checksum(&header, offsetof(Header, checksum));
+    pwrite(m_fd, m_index_buffer.data(), header.index_size, index_extent.position);
+
+    // chunk data, slot table and index have to be on disk before a header pointing to them
+    fdatasync(m_fd);
+    pwrite(m_fd, &header, sizeof(header), header.sequence % 2 * HEADER_COPY_SIZE);
+    fdatasync(m_fd);
+
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_sequence = header.sequence;
+    m_index[region_position] = entry;
+    free(old_table);
+    free(m_index_extent);
+    m_index_extent = index_extent;
+    for (const Extent & extent : freed)
+        free(extent);
+    freed.clear();
+    m_stats.commits.fetch_add(1);
+}
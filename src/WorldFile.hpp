@@ -0,0 +1,106 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <atomic>
+#include <glm/vec3.hpp>
+#include "cfg.hpp"
+#include "Math.hpp"
+
+// one of cfg::WORLD_FILE_COUNT files holding the regions of Region::Storage::WORLD_FILES, regions are spread over
+// them by position, opening a region is a lookup in an index kept in memory instead of opening a file
+// file layout (version 4):
+// header copy at 0 and at HEADER_COPY_SIZE: magic, version, sequence, end, index position, index capacity,
+//                                           index size, index checksum, checksum
+// extents from HEADER_SIZE on: slot tables of regions, chunk data and the index
+// index: region count, region count * (x, y, z, slot table position, slot table capacity, slot table checksum),
+//        free extent count, free extent count * (position, capacity)
+// version 3: same, but chunk data always in the first half of its slot (Region version 7 slots), read as they are
+// version 2: same, but chunk data always with a byte per block (Region version 6 slots), read as they are
+// version 1: same, but slot tables without dictionaries (Region version 5 slots), read as they are
+// a commit writes the slot table of a region and the index into new extents and the header into the copy not
+// holding the latest one (like Region does), extents are only reused once the latest header doesn't reach them
+class WorldFile {
+public:
+    // the file holding the region, opened on first use and kept open until exit
+    static WorldFile & get(const glm::tvec3<cfg::Coord> & region_position);
+
+    WorldFile(const char * file_name);
+    WorldFile(const WorldFile &) = delete;
+    WorldFile & operator = (const WorldFile &) = delete;
+    ~WorldFile();
+
+    int fd() const { return m_fd; }
+
+    struct Extent {
+        cfg::RegUint position;
+        cfg::RegUint capacity;
+    };
+
+    // reads the slot table of a region, returns false if the region is not in the file yet
+    bool readRegion(const glm::tvec3<cfg::Coord> & region_position, void * table, size_t table_size);
+    // best fitting free extent (split if larger) or appended, returns its position
+    cfg::RegUint allocate(cfg::RegUint capacity);
+    // makes everything written so far durable with the region pointing to table
+    // freed holds the extents the region stopped using since its last commit, they can be reused afterwards (cleared)
+    void commitRegion(const glm::tvec3<cfg::Coord> & region_position, const void * table, size_t table_size, std::vector<Extent> & freed);
+
+    struct Statistics {
+        std::atomic<size_t> lookups{ 0 };
+        std::atomic<size_t> allocations{ 0 };
+        // allocations served from free extents
+        std::atomic<size_t> reused{ 0 };
+        std::atomic<size_t> commits{ 0 };
+    };
+    const Statistics & statistics() const { return m_stats; }
+
+    static constexpr cfg::RegUint MAGIC{ 0x44575856 }; // "VXWD"
+    static constexpr cfg::RegUint VERSION{ 4 };
+    // copies in separate pages, a torn write can only break the one being written
+    static constexpr cfg::RegUint HEADER_COPY_SIZE{ 4096 };
+    static constexpr cfg::RegUint HEADER_SIZE{ 2 * HEADER_COPY_SIZE };
+
+private:
+    struct Header {
+        cfg::RegUint magic;
+        cfg::RegUint version;
+        cfg::RegUint sequence;
+        cfg::RegUint end;
+        cfg::RegUint index_position;
+        cfg::RegUint index_capacity;
+        cfg::RegUint index_size;
+        cfg::RegUint index_checksum;
+        // codec::checksum() of everything before it
+        cfg::RegUint checksum;
+    };
+    struct Entry {
+        Extent table;
+        cfg::RegUint table_checksum;
+    };
+
+    int m_fd;
+    // m_mutex: index, free extents and end, commits hold m_commit_mutex throughout and m_mutex only briefly
+    std::mutex m_mutex;
+    std::mutex m_commit_mutex;
+    std::unordered_map<glm::tvec3<cfg::Coord>, Entry, Math::VecKeyHash<cfg::Coord>, Math::VecKeyEqual<cfg::Coord>> m_index;
+    // free extents by position (neighbours are merged) and by capacity (for best fit)
+    std::map<cfg::RegUint, cfg::RegUint> m_free;
+    std::set<std::pair<cfg::RegUint, cfg::RegUint>> m_free_by_capacity;
+    cfg::RegUint m_end;
+    cfg::RegUint m_sequence;
+    Extent m_index_extent;
+    // reused by every commit
+    std::vector<cfg::RegUint> m_index_buffer;
+    Statistics m_stats;
+
+    // call with m_mutex
+    void free(const Extent & extent);
+    cfg::RegUint allocateLocked(cfg::RegUint capacity);
+    // returns false if the copy is not valid
+    bool readHeader(cfg::RegUint copy, Header & header);
+    void readIndex(const Header & header);
+
+};
@@ -4,10 +4,21 @@
 #include <glm/vec3.hpp>
 #include "Math.hpp"
 
+// bits of a block id, 8 for the old single byte blocks (chunks with larger ids can't be loaded then)
+#ifndef VOXEL_BLOCK_BITS
+#define VOXEL_BLOCK_BITS 16
+#endif
+
 // TODO: configure at runtime by making this namespace a class and
 // members non static and pass the class to whoever needs it
 namespace cfg {
+#if VOXEL_BLOCK_BITS == 8
     using Block = uint8_t;
+#elif VOXEL_BLOCK_BITS == 16
+    using Block = uint16_t;
+#else
+#error "VOXEL_BLOCK_BITS must be 8 or 16"
+#endif
     using Coord = int32_t;
 
     static constexpr size_t MAX_MESH_UPDATES_PER_FRAME{ 32 };
@@ -15,10 +26,41 @@ namespace cfg {
     // when generating will always produce same chunk and generating is very cheap
     // like worldgen::WorldGenType::AIR, this can be set to false to save disk space
     static constexpr bool SAVE_NEWLY_GENERATED_CHUNKS{ true };
+    // regions are defragmented (rewritten into a new file) once their garbage reaches DEFRAGMENT_GARBAGE_THRESHOLD
+    // and DEFRAGMENT_GARBAGE_PERCENT of the chunk data area
     static constexpr size_t DEFRAGMENT_GARBAGE_THRESHOLD{ 1024 * 128 };
+    static constexpr size_t DEFRAGMENT_GARBAGE_PERCENT{ 50 };
+    // region slots are allocated with size + size / REGION_SLOT_SLACK_DIVISOR rounded up to
+    // REGION_SLOT_GRANULARITY, so chunks that grow a little can still be rewritten in place
+    static constexpr size_t REGION_SLOT_SLACK_DIVISOR{ 16 };
+    static constexpr size_t REGION_SLOT_GRANULARITY{ 64 };
+    // region slot tables are kept in memory and committed every this many saves (and on close)
+    static constexpr size_t REGION_CHECKPOINT_INTERVAL{ 256 };
+    // Region::Backend::MMAP grows files in steps of REGION_MMAP_EXTENT
+    // and reserves REGION_MMAP_RESERVE of address space per open region
+    static constexpr size_t REGION_MMAP_EXTENT{ 1024 * 1024 * 4 };
+    static constexpr size_t REGION_MMAP_RESERVE{ size_t{ 1 } << 30 };
+    // Region::Storage::WORLD_FILES spreads regions over this many files (each can hold 4 GiB)
+    static constexpr size_t WORLD_FILE_COUNT{ 4 };
+    // preset dictionaries for chunk data (see Dictionaries.hpp), zlib uses at most 32 KiB of one
+    static constexpr size_t CHUNK_DICTIONARY_SIZE{ 1024 * 32 };
+    static constexpr size_t CHUNK_DICTIONARY_SAMPLE_COUNT{ 128 };
+    // ChunkIO submits requests in batches of CHUNK_IO_BATCH_SIZE, has up to CHUNK_IO_QUEUE_DEPTH
+    // io_uring reads in flight per worker and CHUNK_IO_THREAD_COUNT threads for everything else
+    static constexpr size_t CHUNK_IO_BATCH_SIZE{ 8 };
+    static constexpr size_t CHUNK_IO_QUEUE_DEPTH{ 16 };
+    static constexpr size_t CHUNK_IO_THREAD_COUNT{ 2 };
+    // requests in flight per worker that fit into ChunkIO without allocating
+    static constexpr size_t CHUNK_IO_RESERVED_REQUESTS{ 1024 };
+    // evicted dirty chunks wait in this many buffers for ChunkWriter, eviction stalls when all are used
+    // (CHUNK_VOLUME blocks each, 16 MiB with 16 bit blocks), enough for what one step of the center chunk evicts
+    static constexpr size_t CHUNK_WRITER_BUFFER_COUNT{ 256 };
 
     static constexpr double MAX_RAY_LENGTH{ 10 };
     static constexpr size_t MESH_QUEUE_SIZE_LIMIT{ 128 };
+    // meshes patched by VoxelContainer::patchMeshesWithBlockRange() keep their quad index (mesher::IndexedMesh,
+    // about 1 MiB each) until more than this many are, the least recently edited one goes first
+    static constexpr size_t EDITED_MESH_LIMIT{ 16 };
     static constexpr size_t BLOCK_UPDATE_QUEUE_SIZE_LIMIT{ 8 };
 
     // TODO: static asserts to check for sane and valid values
@@ -59,10 +101,6 @@ namespace cfg {
     static constexpr Coord MESH_ARRAY_VOLUME{ Math::volume(MESH_ARRAY_SIZE) };
     static constexpr Coord REGION_VOLUME{ Math::volume(REGION_SIZE) };
 
-    // TODO: profile and see if caching makes sense (it is supposed to reduce ChunkContainer::m_mutex contention)
-    static constexpr glm::tvec3<Coord> WORKER_REGION_CACHE_SIZE{ 2, 2, 2 };
-    static constexpr Coord WORKER_REGION_CACHE_VOLUME{ Math::volume(WORKER_REGION_CACHE_SIZE) };
-
     static constexpr glm::tvec3<Coord> MESH_LOADING_SIZE{
          MESH_LOADING_RADIUS.x * 2 + 1,
          MESH_LOADING_RADIUS.y * 2 + 1,
@@ -71,11 +109,29 @@ namespace cfg {
 
     static constexpr Coord MESH_LOADING_VOLUME{ Math::volume(MESH_LOADING_SIZE) };
 
-    static constexpr size_t WORKER_THREAD_COUNT{ 4 };
-    static_assert(WORKER_THREAD_COUNT < MESH_QUEUE_SIZE_LIMIT, "Becasue ~VoxelContainer().");
-    // TODO: calcualte good value from REGION_SIZE, MESH_LOADING_SIZE, WORKER_THREAD_COUNT, WORKER_REGION_CACHE_VOLUME ...
+    // newly generated chunks are dirty too, so a step evicts a whole slab of them
+    static_assert(
+        CHUNK_WRITER_BUFFER_COUNT >= size_t(MESH_LOADING_SIZE.y * MESH_LOADING_SIZE.z) &&
+        CHUNK_WRITER_BUFFER_COUNT >= size_t(MESH_LOADING_SIZE.x * MESH_LOADING_SIZE.y),
+        "Evicting the chunks of one step would stall in ChunkWriter::save()."
+    );
+
+    // VoxelContainer runs one worker per hardware thread, but no more than MAX_WORKER_THREAD_COUNT
+    // and no fewer than MIN_WORKER_THREAD_COUNT (workers also wait for chunk reads)
+    static constexpr size_t MIN_WORKER_THREAD_COUNT{ 4 };
+    static constexpr size_t MAX_WORKER_THREAD_COUNT{ 32 };
+    // a mesh task pushes up to two meshes
+    static_assert(MAX_WORKER_THREAD_COUNT * 2 < MESH_QUEUE_SIZE_LIMIT, "Becasue ~VoxelContainer().");
+    // TODO: calcualte good value from REGION_SIZE, MESH_LOADING_SIZE, worker thread count ...
     static constexpr size_t REGION_CACHE_SIZE{ 128 };
-    static_assert((WORKER_REGION_CACHE_VOLUME + 2) * WORKER_THREAD_COUNT < REGION_CACHE_SIZE);
+    // RegionContainer locks, regions are spread over them by position
+    static constexpr size_t REGION_CONTAINER_SHARD_COUNT{ 16 };
+    // RegionPrefetcher opens the regions the loader needs once the center chunk moved REGION_PREFETCH_DISTANCE
+    // chunks further in its last direction, chunk data closer than REGION_PREFETCH_GAP bytes is read ahead together
+    static constexpr Coord REGION_PREFETCH_DISTANCE{ 8 };
+    static constexpr size_t REGION_PREFETCH_GAP{ 1024 * 64 };
+    // chunk lists VoxelIterator keeps for passes after the center moved, by how far it moved
+    static constexpr size_t DELTA_CACHE_SIZE{ 32 };
 
     static_assert(
         cfg::MESH_LOADING_RADIUS.x >= 0 &&
@@ -109,7 +165,7 @@ namespace cfg {
         MESH_LOADING_SIZE.x < CHUNK_ARRAY_SIZE.x &&
         MESH_LOADING_SIZE.y < CHUNK_ARRAY_SIZE.y &&
         MESH_LOADING_SIZE.z < CHUNK_ARRAY_SIZE.z,
-        "Must be true, because of VoxelContainer::m_mesh_readines"
+        "Must be true, because of VoxelContainer::m_mesh_missing_chunks"
     );
 
     static_assert(
@@ -124,7 +180,12 @@ namespace cfg {
 
     // deprecated
     struct Vertex {
-        uint8_t vals[8];
+        Vertex() = default;
+        constexpr Vertex(uint8_t x, uint8_t y, uint8_t z, Block block, uint8_t ao_0, uint8_t ao_1, uint8_t ao_2, uint8_t ao_3) :
+            vals{ x, y, z, ao_0, ao_1, ao_2, ao_3 }, block{ block } {}
+        // position, ambient occlusion of the 4 corners
+        uint8_t vals[7];
+        Block block;
     };
 
 }
@@ -21,9 +21,48 @@
 #include "Ray.hpp"
 #include "LineCube.hpp"
 #include "Texture.hpp"
+#include "Codec.hpp"
+#include "ChunkIO.hpp"
+#include "Dictionaries.hpp"
 
 int main() {
-    std::unique_ptr<VoxelContainer> vc = std::make_unique<VoxelContainer>();
+    // codec for saving chunks, e.g. VOXEL_CODEC=zstd:3 (saved chunks remember their codec)
+    const char * codec_name = std::getenv("VOXEL_CODEC");
+    if (codec_name != nullptr) {
+        codec::Codec codec;
+        if (codec::parse(codec_name, codec))
+            codec::setDefault(codec);
+        else
+            Print("Unknown or unavailable codec ", codec_name, ", using default.");
+    }
+    // VOXEL_REGION_BACKEND=mmap to map region files instead of pread()/pwrite()
+    const char * backend_name = std::getenv("VOXEL_REGION_BACKEND");
+    if (backend_name != nullptr && std::string{ backend_name } == "mmap")
+        Region::setDefaultBackend(Region::Backend::MMAP);
+    // VOXEL_REGION_STORAGE=world to keep regions in a few shared world files instead of a file per region
+    const char * storage_name = std::getenv("VOXEL_REGION_STORAGE");
+    if (storage_name != nullptr && std::string{ storage_name } == "world")
+        Region::setDefaultStorage(Region::Storage::WORLD_FILES);
+    // VOXEL_DICTIONARY=train to train a compression dictionary from the first chunks saved if the world has none
+    const char * dictionary_name = std::getenv("VOXEL_DICTIONARY");
+    if (dictionary_name != nullptr && std::string{ dictionary_name } == "train")
+        dictionaries::setTraining(true);
+    // VOXEL_CHUNK_IO=threads to not use io_uring for chunk reads
+    const char * chunk_io_name = std::getenv("VOXEL_CHUNK_IO");
+    if (chunk_io_name != nullptr && std::string{ chunk_io_name } == "threads")
+        ChunkIO::setDefaultBackend(ChunkIO::Backend::THREADS);
+
+    // VOXEL_MESHER=greedy to merge faces of the same block and shading into bigger quads,
+    // VOXEL_MESHER=faces for the mesher going a block at a time instead of a row of blocks
+    const char * mesher_name = std::getenv("VOXEL_MESHER");
+    if (mesher_name != nullptr && std::string{ mesher_name } == "greedy")
+        VoxelContainer::setMesher(mesher::MesherType::GREEDY);
+    else if (mesher_name != nullptr && std::string{ mesher_name } == "faces")
+        VoxelContainer::setMesher(mesher::MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_BETTER_COPY);
+    // VOXEL_WORKER_THREADS=n for n worker threads instead of one per hardware thread
+    const char * worker_threads_name = std::getenv("VOXEL_WORKER_THREADS");
+    const size_t worker_threads = worker_threads_name != nullptr ? std::strtoul(worker_threads_name, nullptr, 10) : 0;
+    std::unique_ptr<VoxelContainer> vc = std::make_unique<VoxelContainer>(worker_threads);
     LockedQueue<Mesh, cfg::MESH_QUEUE_SIZE_LIMIT> & q = vc->getQueue();
 
     //std::system("rm world/*");
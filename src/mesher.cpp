@@ -3,28 +3,92 @@
 #include <glm/glm.hpp>
 #include "Print.hpp"
 #include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
 #include <glm/gtx/hash.hpp>
 
+#if defined(__x86_64__) || defined(_M_X64)
+    #define VOXEL_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define VOXEL_TARGET_AVX2
+    #else
+        // only the functions using avx2 are compiled for it, they run after checking the cpu has it
+        #define VOXEL_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
 static constexpr std::uint8_t SHADOW_STRENGTH{ 63 };
 
+void mesher::copyPadded(cfg::Block * padded, const std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> & chunks) {
+    static constexpr glm::tvec3<cfg::Coord> DIM{ mesher::PADDED_SIZE };
+    static constexpr glm::tvec3<cfg::Coord> FR{ cfg::MESH_OFFSET };
+    static constexpr glm::tvec3<cfg::Coord> TO{ Math::add(FR, cfg::MESH_SIZE) };
+    // a padded row is the end of a row of one chunk and the start of the same row of the next one
+    static constexpr cfg::Coord RUN{ cfg::MESH_OFFSET.x + 1 };
+
+    static_assert(cfg::MESH_OFFSET.x * 2 == cfg::CHUNK_SIZE.x && cfg::CHUNK_SIZE.x == cfg::MESH_SIZE.x);
+    static_assert(cfg::MESH_OFFSET.y * 2 == cfg::CHUNK_SIZE.y && cfg::CHUNK_SIZE.y == cfg::MESH_SIZE.y);
+    static_assert(cfg::MESH_OFFSET.z * 2 == cfg::CHUNK_SIZE.z && cfg::CHUNK_SIZE.z == cfg::MESH_SIZE.z);
+    static_assert(RUN * 2 == DIM.x);
+    glm::tvec3<cfg::Coord> i;
+    for (i.z = FR.z - 1; i.z < TO.z + 1; ++i.z)
+        for (i.y = FR.y - 1; i.y < TO.y + 1; ++i.y)
+            for (i.x = FR.x - 1; i.x < TO.x + 1; i.x += RUN) {
+                const auto chunk_position = Math::floor_div_unsigned(i, cfg::CHUNK_SIZE);
+                const auto block_index = Math::position_to_index_unsigned(i, cfg::CHUNK_SIZE);
+                const auto chunk_index = Math::position_to_index_unsigned(chunk_position, cfg::MESH_CHUNK_SIZE);
+                // constant size, copied with a few wide loads and stores
+                std::memcpy(padded, chunks[chunk_index] + block_index, RUN * sizeof(cfg::Block));
+                padded += RUN;
+            }
+}
+
 // runs marginally better than INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA
 template <>
 void mesher::mesh<mesher::MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_BETTER_COPY>(
     std::vector<cfg::Vertex> & mesh,
     const std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> & chunks
 ) {
-    static constexpr glm::tvec3<cfg::Coord> DIM{ Math::add(cfg::MESH_SIZE, 2) };
-    static constexpr glm::tvec3<cfg::Coord> FR{ cfg::MESH_OFFSET };
-    static constexpr glm::tvec3<cfg::Coord> TO{ Math::add(FR, cfg::MESH_SIZE) };
-    static constexpr glm::tvec3<cfg::Coord> OFFSET{ 1, 1, 1 };
+    alignas(32) std::array<cfg::Block, Math::volume(PADDED_SIZE)> chunk;
+    copyPadded(chunk.data(), chunks);
+    meshPadded(mesh, chunk.data());
+}
 
-    static constexpr std::array<int32_t, 6> NEIGHBOUR_OFFSETS{ {
+template <>
+void mesher::mesh<mesher::MesherType::BITMASK>(
+    std::vector<cfg::Vertex> & mesh,
+    const std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> & chunks
+) {
+    alignas(32) std::array<cfg::Block, Math::volume(PADDED_SIZE)> chunk;
+    copyPadded(chunk.data(), chunks);
+    meshPaddedBitmask(mesh, chunk.data());
+}
+
+template <>
+void mesher::mesh<mesher::MesherType::GREEDY>(
+    std::vector<cfg::Vertex> & mesh,
+    const std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> & chunks
+) {
+    alignas(32) std::array<cfg::Block, Math::volume(PADDED_SIZE)> chunk;
+    copyPadded(chunk.data(), chunks);
+    meshPaddedGreedy(mesh, chunk.data());
+}
+
+// tables for meshing the padded blocks of a mesh (see mesher::meshPadded())
+namespace padded {
+    constexpr glm::tvec3<cfg::Coord> DIM{ mesher::PADDED_SIZE };
+    constexpr glm::tvec3<cfg::Coord> OFFSET{ 1, 1, 1 };
+
+    constexpr std::array<int32_t, 6> NEIGHBOUR_OFFSETS{ {
         Math::to_index({ -1,  0,  0 }, DIM), Math::to_index({  1,  0,  0 }, DIM),
         Math::to_index({  0, -1,  0 }, DIM), Math::to_index({  0,  1,  0 }, DIM),
         Math::to_index({  0,  0, -1 }, DIM), Math::to_index({  0,  0,  1 }, DIM),
     } };
 
-    static constexpr std::array<std::array<glm::tvec3<uint8_t>, 4>, 6> QUAD_VERTEX_OFFSETS{ {
+    constexpr std::array<std::array<glm::tvec3<uint8_t>, 4>, 6> QUAD_VERTEX_OFFSETS{ {
         { { { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 } } },
         { { { 1, 0, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 1, 0, 1 } } },
 
@@ -35,18 +99,28 @@ void mesher::mesh<mesher::MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_B
         { { { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } } },
     } };
 
-    static constexpr std::array<std::array<int32_t, 8>, 6> AOS_OFFSETS{ {
-        { { Math::to_index({ -1, -1, -1 }, DIM), Math::to_index({ -1,  0, -1 }, DIM), Math::to_index({ -1,  1, -1 }, DIM), Math::to_index({ -1, -1,  0 }, DIM), Math::to_index({ -1,  1,  0 }, DIM), Math::to_index({ -1, -1,  1 }, DIM), Math::to_index({ -1,  0,  1 }, DIM), Math::to_index({ -1,  1,  1 }, DIM) } },
-        { { Math::to_index({  1, -1, -1 }, DIM), Math::to_index({  1,  0, -1 }, DIM), Math::to_index({  1,  1, -1 }, DIM), Math::to_index({  1, -1,  0 }, DIM), Math::to_index({  1,  1,  0 }, DIM), Math::to_index({  1, -1,  1 }, DIM), Math::to_index({  1,  0,  1 }, DIM), Math::to_index({  1,  1,  1 }, DIM) } },
+    // blocks around the neighbour of a side, their solidity makes up the ambient occlusion of the quad corners
+    constexpr std::array<std::array<glm::tvec3<cfg::Coord>, 8>, 6> AO_NEIGHBOURS{ {
+        { { { -1, -1, -1 }, { -1,  0, -1 }, { -1,  1, -1 }, { -1, -1,  0 }, { -1,  1,  0 }, { -1, -1,  1 }, { -1,  0,  1 }, { -1,  1,  1 } } },
+        { { {  1, -1, -1 }, {  1,  0, -1 }, {  1,  1, -1 }, {  1, -1,  0 }, {  1,  1,  0 }, {  1, -1,  1 }, {  1,  0,  1 }, {  1,  1,  1 } } },
 
-        { { Math::to_index({ -1, -1, -1 }, DIM), Math::to_index({  0, -1, -1 }, DIM), Math::to_index({  1, -1, -1 }, DIM), Math::to_index({ -1, -1,  0 }, DIM), Math::to_index({  1, -1,  0 }, DIM), Math::to_index({ -1, -1,  1 }, DIM), Math::to_index({  0, -1,  1 }, DIM), Math::to_index({  1, -1,  1 }, DIM) } },
-        { { Math::to_index({ -1,  1, -1 }, DIM), Math::to_index({  0,  1, -1 }, DIM), Math::to_index({  1,  1, -1 }, DIM), Math::to_index({ -1,  1,  0 }, DIM), Math::to_index({  1,  1,  0 }, DIM), Math::to_index({ -1,  1,  1 }, DIM), Math::to_index({  0,  1,  1 }, DIM), Math::to_index({  1,  1,  1 }, DIM) } },
+        { { { -1, -1, -1 }, {  0, -1, -1 }, {  1, -1, -1 }, { -1, -1,  0 }, {  1, -1,  0 }, { -1, -1,  1 }, {  0, -1,  1 }, {  1, -1,  1 } } },
+        { { { -1,  1, -1 }, {  0,  1, -1 }, {  1,  1, -1 }, { -1,  1,  0 }, {  1,  1,  0 }, { -1,  1,  1 }, {  0,  1,  1 }, {  1,  1,  1 } } },
 
-        { { Math::to_index({ -1, -1, -1 }, DIM), Math::to_index({  0, -1, -1 }, DIM), Math::to_index({  1, -1, -1 }, DIM), Math::to_index({ -1,  0, -1 }, DIM), Math::to_index({  1,  0, -1 }, DIM), Math::to_index({ -1,  1, -1 }, DIM), Math::to_index({  0,  1, -1 }, DIM), Math::to_index({  1,  1, -1 }, DIM) } },
-        { { Math::to_index({ -1, -1,  1 }, DIM), Math::to_index({  0, -1,  1 }, DIM), Math::to_index({  1, -1,  1 }, DIM), Math::to_index({ -1,  0,  1 }, DIM), Math::to_index({  1,  0,  1 }, DIM), Math::to_index({ -1,  1,  1 }, DIM), Math::to_index({  0,  1,  1 }, DIM), Math::to_index({  1,  1,  1 }, DIM) } },
+        { { { -1, -1, -1 }, {  0, -1, -1 }, {  1, -1, -1 }, { -1,  0, -1 }, {  1,  0, -1 }, { -1,  1, -1 }, {  0,  1, -1 }, {  1,  1, -1 } } },
+        { { { -1, -1,  1 }, {  0, -1,  1 }, {  1, -1,  1 }, { -1,  0,  1 }, {  1,  0,  1 }, { -1,  1,  1 }, {  0,  1,  1 }, {  1,  1,  1 } } },
     } };
 
-    static constexpr std::array<std::array<glm::tvec3<uint8_t>, 4>, 6> AO_OFFSETS{ {
+    constexpr std::array<std::array<int32_t, 8>, 6> aoIndexOffsets() {
+        std::array<std::array<int32_t, 8>, 6> offsets{};
+        for (size_t side = 0; side < 6; ++side)
+            for (size_t k = 0; k < 8; ++k)
+                offsets[side][k] = Math::to_index(AO_NEIGHBOURS[side][k], DIM);
+        return offsets;
+    }
+    constexpr std::array<std::array<int32_t, 8>, 6> AOS_OFFSETS{ aoIndexOffsets() };
+
+    constexpr std::array<std::array<glm::tvec3<uint8_t>, 4>, 6> AO_OFFSETS{ {
         { { { 1, 3, 0 }, { 1, 4, 2 }, { 3, 6, 5 }, { 4, 6, 7 } } },
         { { { 1, 3, 0 }, { 3, 6, 5 }, { 1, 4, 2 }, { 4, 6, 7 } } },
 
@@ -56,34 +130,15 @@ void mesher::mesh<mesher::MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_B
         { { { 1, 3, 0 }, { 1, 4, 2 }, { 3, 6, 5 }, { 4, 6, 7 } } },
         { { { 1, 3, 0 }, { 3, 6, 5 }, { 1, 4, 2 }, { 4, 6, 7 } } },
     } };
+}
+
+void mesher::meshPadded(std::vector<cfg::Vertex> & mesh, const cfg::Block * chunk) {
+    using namespace padded;
 
     mesh.clear();
     mesh.reserve(1024 * 1024); // whatever
-    
-    std::vector<cfg::Block> chunk;
-    chunk.reserve(Math::volume(DIM));
-
 
-    static_assert(cfg::MESH_OFFSET.x * 2 == cfg::CHUNK_SIZE.x && cfg::CHUNK_SIZE.x == cfg::MESH_SIZE.x);
-    static_assert(cfg::MESH_OFFSET.y * 2 == cfg::CHUNK_SIZE.y && cfg::CHUNK_SIZE.y == cfg::MESH_SIZE.y);
-    static_assert(cfg::MESH_OFFSET.z * 2 == cfg::CHUNK_SIZE.z && cfg::CHUNK_SIZE.z == cfg::MESH_SIZE.z);
     glm::tvec3<cfg::Coord> i;
-    // TODO: further optimize
-    for (i.z = FR.z - 1; i.z < TO.z + 1; ++i.z)
-        for (i.y = FR.y - 1; i.y < TO.y + 1; ++i.y) {
-            for (i.x = FR.x - 1; i.x < TO.x + 1; ++i.x) {
-                const auto chunk_position = Math::floor_div_unsigned(i, cfg::CHUNK_SIZE);
-                const auto block_index = Math::position_to_index_unsigned(i, cfg::CHUNK_SIZE);
-                const auto chunk_index = Math::position_to_index_unsigned(chunk_position, cfg::MESH_CHUNK_SIZE);
-//                chunk.push_back(chunks[chunk_index][block_index]);
-
-                for (size_t j = 0; j < cfg::MESH_OFFSET.x + 1; ++j) {
-                    chunk.push_back(chunks[chunk_index][block_index + j]);
-                }
-                i.x += cfg::MESH_OFFSET.x;
-            }
-        }
-
     int32_t block_index = DIM.y * DIM.x + DIM.x + 1;
     for (i.z = 1; i.z < cfg::MESH_SIZE.z + 1; ++i.z)
         for (i.y = 1; i.y < cfg::MESH_SIZE.y + 1; ++i.y)
@@ -126,6 +181,389 @@ void mesher::mesh<mesher::MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_B
             }
 }
 
+void mesher::meshPaddedGreedy(std::vector<cfg::Vertex> & mesh, const cfg::Block * chunk) {
+    using namespace padded;
+    static_assert(cfg::MESH_SIZE.x == cfg::MESH_SIZE.y && cfg::MESH_SIZE.y == cfg::MESH_SIZE.z, "Slices are squares.");
+    static_assert(cfg::MESH_SIZE.x <= 32, "A row of a slice is a bit mask.");
+    static_assert(cfg::MESH_SIZE.x < 1 << GREEDY_SIDE_SHIFT, "Side bits above the position.");
+    static constexpr cfg::Coord N{ cfg::MESH_SIZE.x };
+    static constexpr std::array<int32_t, 3> PADDED_STRIDES{ { 1, DIM.x, DIM.x * DIM.y } };
+    static constexpr int32_t PADDED_START{ Math::to_index(OFFSET, DIM) };
+
+    mesh.clear();
+    mesh.reserve(1024 * 64);
+
+    // per side, slice along the side and row (t) a bit for every visible face (at s), found in one go through the
+    // blocks in memory order, the rest only touches visible faces
+    thread_local std::array<std::array<std::array<uint32_t, N>, N>, 6> rows;
+    std::array<uint32_t, 6> slices{};
+    for (auto & side_rows : rows)
+        for (auto & slice_rows : side_rows)
+            slice_rows.fill(0);
+    glm::tvec3<cfg::Coord> i;
+    for (i.z = 0; i.z < N; ++i.z)
+        for (i.y = 0; i.y < N; ++i.y) {
+            const cfg::Block * const row{ chunk + PADDED_START + i.y * PADDED_STRIDES[1] + i.z * PADDED_STRIDES[2] };
+            for (i.x = 0; i.x < N; ++i.x) {
+                const cfg::Block * const block{ row + i.x };
+                if (*block == cfg::Block{ 0 })
+                    continue;
+                unsigned sides{ 0 };
+                for (size_t side = 0; side < 6; ++side)
+                    sides |= unsigned(block[NEIGHBOUR_OFFSETS[side]] == cfg::Block{ 0 }) << side;
+                for (; sides != 0; sides &= sides - 1) {
+                    const size_t side = Math::countTrailingZeros(sides);
+                    const cfg::Coord d{ i[side / 2] };
+                    rows[side][d][i[GREEDY_SIDE_AXES[side][1]]] |= uint32_t{ 1 } << i[GREEDY_SIDE_AXES[side][0]];
+                    slices[side] |= uint32_t{ 1 } << d;
+                }
+            }
+        }
+
+    // per face of a slice: block << 8 | ambient occlusion of the 4 corners (2 bits each), only read where rows has a bit
+    std::array<uint32_t, N * N> faces;
+    for (size_t side = 0; side < 6; ++side) {
+        const size_t normal_axis{ side / 2 };
+        const size_t s_axis{ GREEDY_SIDE_AXES[side][0] };
+        const size_t t_axis{ GREEDY_SIDE_AXES[side][1] };
+        const auto & quad = QUAD_VERTEX_OFFSETS[side];
+        const auto & aos_offsets = AOS_OFFSETS[side];
+        const auto & ao_offsets = AO_OFFSETS[side];
+        const uint8_t side_bits{ static_cast<uint8_t>(side + 1) };
+
+        for (uint32_t side_slices = slices[side]; side_slices != 0; side_slices &= side_slices - 1) {
+            const cfg::Coord d{ static_cast<cfg::Coord>(Math::countTrailingZeros(side_slices)) };
+            auto & slice_rows = rows[side][d];
+            for (cfg::Coord t = 0; t < N; ++t)
+                for (uint32_t bits = slice_rows[t]; bits != 0; bits &= bits - 1) {
+                    const cfg::Coord s{ static_cast<cfg::Coord>(Math::countTrailingZeros(bits)) };
+                    const int32_t block_index{
+                        PADDED_START + d * PADDED_STRIDES[normal_axis] + s * PADDED_STRIDES[s_axis] + t * PADDED_STRIDES[t_axis]
+                    };
+                    std::array<bool, 8> aos;
+                    for (size_t k = 0; k < 8; ++k)
+                        aos[k] = chunk[block_index + aos_offsets[k]] != cfg::Block{ 0 };
+                    uint32_t face{ uint32_t{ chunk[block_index] } << 8 };
+                    for (size_t k = 0; k < 4; ++k)
+                        face |= uint32_t(Math::vertexAOInv(aos[ao_offsets[k][0]], aos[ao_offsets[k][1]], aos[ao_offsets[k][2]]) - 1) << (k * 2);
+                    faces[t * N + s] = face;
+                }
+
+            // widest run along s first, then as many rows of it along t as match, faces taken are cleared from rows
+            for (cfg::Coord t = 0; t < N; ++t)
+                while (slice_rows[t] != 0) {
+                    const cfg::Coord s{ static_cast<cfg::Coord>(Math::countTrailingZeros(slice_rows[t])) };
+                    const uint32_t face{ faces[t * N + s] };
+                    cfg::Coord w{ 1 };
+                    while (s + w < N && (slice_rows[t] >> (s + w) & 1) != 0 && faces[t * N + s + w] == face)
+                        ++w;
+                    const uint32_t run{ (w == 32 ? ~uint32_t{ 0 } : (uint32_t{ 1 } << w) - 1) << s };
+                    cfg::Coord h{ 1 };
+                    for (; t + h < N && (slice_rows[t + h] & run) == run; ++h) {
+                        const uint32_t * const row{ &faces[(t + h) * N + s] };
+                        if (!std::all_of(row, row + w, [face](uint32_t other) { return other == face; }))
+                            break;
+                    }
+                    for (cfg::Coord y = t; y < t + h; ++y)
+                        slice_rows[y] &= ~run;
+
+                    const cfg::Block block{ static_cast<cfg::Block>(face >> 8) };
+                    std::array<uint8_t, 4> ao;
+                    for (size_t k = 0; k < 4; ++k)
+                        ao[k] = SHADOW_STRENGTH * ((face >> (k * 2) & 3) + 1);
+                    std::array<uint8_t, 3> position;
+                    position[normal_axis] = static_cast<uint8_t>(d);
+                    position[s_axis] = static_cast<uint8_t>(s);
+                    position[t_axis] = static_cast<uint8_t>(t);
+                    for (size_t k = 0; k < 4; ++k) {
+                        // quad corners at 1 along s or t are at the end of the run
+                        std::array<uint8_t, 3> vertex{ {
+                            uint8_t(position[0] + quad[k].x), uint8_t(position[1] + quad[k].y), uint8_t(position[2] + quad[k].z)
+                        } };
+                        vertex[s_axis] = static_cast<uint8_t>(vertex[s_axis] + quad[k][s_axis] * (w - 1));
+                        vertex[t_axis] = static_cast<uint8_t>(vertex[t_axis] + quad[k][t_axis] * (h - 1));
+                        mesh.push_back({
+                            uint8_t(vertex[0] | (side_bits & 3) << GREEDY_SIDE_SHIFT), uint8_t(vertex[1] | (side_bits >> 2) << GREEDY_SIDE_SHIFT), vertex[2],
+                            block, ao[0], ao[1], ao[2], ao[3]
+                        });
+                    }
+                }
+        }
+    }
+}
+
+namespace kernels {
+    static constexpr glm::tvec3<cfg::Coord> DIM{ mesher::PADDED_SIZE };
+    static constexpr cfg::Coord ROWS{ DIM.y * DIM.z };
+    static_assert(DIM.x <= 64, "A row of blocks is a bit mask.");
+
+    // blocks from x on of a row
+    uint64_t solidTail(const cfg::Block * row, cfg::Coord x) {
+        uint64_t bits{ 0 };
+        for (; x < DIM.x; ++x)
+            bits |= uint64_t{ row[x] != cfg::Block{ 0 } } << x;
+        return bits;
+    }
+
+    void solidRowsScalar(const cfg::Block * padded, uint64_t * rows) {
+        for (cfg::Coord row = 0; row < ROWS; ++row)
+            rows[row] = solidTail(padded + row * DIM.x, 0);
+    }
+
+#ifdef VOXEL_X86
+    // a bit per block of 16 blocks, set where they are air
+    inline uint32_t airSse2(const cfg::Block * blocks) {
+        const __m128i zero{ _mm_setzero_si128() };
+        if constexpr (sizeof(cfg::Block) == 1)
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks)), zero));
+        const __m128i lo{ _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks)), zero) };
+        const __m128i hi{ _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + 8)), zero) };
+        return _mm_movemask_epi8(_mm_packs_epi16(lo, hi));
+    }
+
+    void solidRowsSse2(const cfg::Block * padded, uint64_t * rows) {
+        static constexpr cfg::Coord WIDE{ DIM.x / 16 * 16 };
+        for (cfg::Coord row = 0; row < ROWS; ++row) {
+            const cfg::Block * const blocks{ padded + row * DIM.x };
+            uint64_t bits{ solidTail(blocks, WIDE) };
+            for (cfg::Coord x = 0; x < WIDE; x += 16)
+                bits |= uint64_t{ ~airSse2(blocks + x) & 0xffffu } << x;
+            rows[row] = bits;
+        }
+    }
+
+    // a bit per block of 32 blocks, set where they are air
+    VOXEL_TARGET_AVX2 inline uint32_t airAvx2(const cfg::Block * blocks) {
+        const __m256i zero{ _mm256_setzero_si256() };
+        if constexpr (sizeof(cfg::Block) == 1)
+            return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(blocks)), zero));
+        const __m256i lo{ _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(blocks)), zero) };
+        const __m256i hi{ _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(blocks + 16)), zero) };
+        // packs works within 128 bit lanes: lo 0-7, hi 0-7, lo 8-15, hi 8-15, back in order
+        return _mm256_movemask_epi8(_mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xd8));
+    }
+
+    VOXEL_TARGET_AVX2 void solidRowsAvx2(const cfg::Block * padded, uint64_t * rows) {
+        static constexpr cfg::Coord WIDE{ DIM.x / 32 * 32 };
+        for (cfg::Coord row = 0; row < ROWS; ++row) {
+            const cfg::Block * const blocks{ padded + row * DIM.x };
+            uint64_t bits{ solidTail(blocks, WIDE) };
+            for (cfg::Coord x = 0; x < WIDE; x += 32)
+                bits |= uint64_t{ ~airAvx2(blocks + x) } << x;
+            rows[row] = bits;
+        }
+    }
+
+    bool cpuHasAvx2() {
+    #ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        // the os has to save the ymm registers too
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    #else
+        return __builtin_cpu_supports("avx2");
+    #endif
+    }
+#endif
+}
+
+bool mesher::kernelSupported(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::SCALAR:
+        return true;
+#ifdef VOXEL_X86
+    case Kernel::SSE2:
+        return true;
+    case Kernel::AVX2: {
+        static const bool avx2{ kernels::cpuHasAvx2() };
+        return avx2;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+mesher::Kernel mesher::bestKernel() {
+    static const Kernel best{
+        kernelSupported(Kernel::AVX2) ? Kernel::AVX2 : kernelSupported(Kernel::SSE2) ? Kernel::SSE2 : Kernel::SCALAR
+    };
+    return best;
+}
+
+void mesher::solidRows(const cfg::Block * padded, uint64_t * rows, Kernel kernel) {
+    assert(kernelSupported(kernel));
+    switch (kernel) {
+#ifdef VOXEL_X86
+    case Kernel::AVX2:
+        kernels::solidRowsAvx2(padded, rows);
+        break;
+    case Kernel::SSE2:
+        kernels::solidRowsSse2(padded, rows);
+        break;
+#endif
+    default:
+        kernels::solidRowsScalar(padded, rows);
+        break;
+    }
+}
+
+// meshPaddedBitmask(), faces gets the face (see IndexedMesh) of every quad if not nullptr
+static void meshBitmask(std::vector<cfg::Vertex> & mesh, const cfg::Block * chunk, std::vector<uint32_t> * faces_of_quads) {
+    using namespace padded;
+    static constexpr std::array<glm::tvec3<cfg::Coord>, 6> NORMALS{ {
+        { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }
+    } };
+    static constexpr uint64_t INSIDE{ ((uint64_t{ 1 } << cfg::MESH_SIZE.x) - 1) << 1 };
+    // occupancy of the row at x + dx in bit x
+    auto shifted = [](uint64_t row, cfg::Coord dx) {
+        return dx < 0 ? row << 1 : dx > 0 ? row >> 1 : row;
+    };
+
+    mesh.clear();
+    mesh.reserve(1024 * 64);
+
+    if (faces_of_quads != nullptr)
+        faces_of_quads->clear();
+
+    // a bit per solid block, rows along x
+    thread_local std::array<uint64_t, DIM.y * DIM.z> solid;
+    mesher::solidRows(chunk, solid.data(), mesher::bestKernel());
+    auto solidRow = [](cfg::Coord y, cfg::Coord z) { return solid[y + z * DIM.y]; };
+
+    for (cfg::Coord z = 1; z < cfg::MESH_SIZE.z + 1; ++z)
+        for (cfg::Coord y = 1; y < cfg::MESH_SIZE.y + 1; ++y) {
+            const uint64_t row{ solidRow(y, z) & INSIDE };
+            if (row == 0)
+                continue;
+            const cfg::Block * const blocks{ chunk + Math::to_index(glm::tvec3<cfg::Coord>{ 0, y, z }, DIM) };
+            for (size_t side = 0; side < 6; ++side) {
+                const auto & normal = NORMALS[side];
+                uint64_t faces{ row & ~shifted(solidRow(y + normal.y, z + normal.z), normal.x) };
+                if (faces == 0)
+                    continue;
+                // per corner, ambient occlusion level - 1 as two bit planes: the number of the two sides and the
+                // corner that are open (0 if both sides are solid)
+                std::array<uint64_t, 8> around;
+                for (size_t k = 0; k < 8; ++k) {
+                    const auto & neighbour = AO_NEIGHBOURS[side][k];
+                    around[k] = shifted(solidRow(y + neighbour.y, z + neighbour.z), neighbour.x);
+                }
+                std::array<uint64_t, 4> low, high;
+                for (size_t k = 0; k < 4; ++k) {
+                    const uint64_t a{ around[AO_OFFSETS[side][k][0]] };
+                    const uint64_t b{ around[AO_OFFSETS[side][k][1]] };
+                    const uint64_t c{ around[AO_OFFSETS[side][k][2]] };
+                    const uint64_t occluded{ a & b };
+                    low[k] = (~a ^ ~b ^ ~c) & ~occluded;
+                    high[k] = ((~a & ~b) | (~c & (~a ^ ~b))) & ~occluded;
+                }
+                for (; faces != 0; faces &= faces - 1) {
+                    const unsigned x{ Math::countTrailingZeros64(faces) };
+                    std::array<uint8_t, 4> ao;
+                    for (size_t k = 0; k < 4; ++k)
+                        ao[k] = SHADOW_STRENGTH * ((high[k] >> x & 1) * 2 + (low[k] >> x & 1) + 1);
+                    const cfg::Block block{ blocks[x] };
+                    const glm::tvec3<uint8_t> position{ uint8_t(x - 1), uint8_t(y - 1), uint8_t(z - 1) };
+                    for (size_t k = 0; k < 4; ++k) {
+                        const glm::tvec3<uint8_t> vertex{ position + QUAD_VERTEX_OFFSETS[side][k] };
+                        mesh.push_back({ vertex.x, vertex.y, vertex.z, block, ao[0], ao[1], ao[2], ao[3] });
+                    }
+                    if (faces_of_quads != nullptr)
+                        faces_of_quads->push_back(static_cast<uint32_t>(Math::to_index(glm::tvec3<cfg::Coord>{ position }, cfg::MESH_SIZE) * 6 + side));
+                }
+            }
+        }
+}
+
+void mesher::meshPaddedBitmask(std::vector<cfg::Vertex> & mesh, const cfg::Block * padded) {
+    meshBitmask(mesh, padded, nullptr);
+}
+
+mesher::IndexedMesh::IndexedMesh() : m_quads(cfg::MESH_VOLUME * 6, NO_QUAD) {}
+
+void mesher::IndexedMesh::build(const cfg::Block * padded) {
+    meshBitmask(m_vertices, padded, &m_faces);
+    std::fill(std::begin(m_quads), std::end(m_quads), NO_QUAD);
+    for (uint32_t quad = 0; quad < m_faces.size(); ++quad)
+        m_quads[m_faces[quad]] = quad;
+    m_changed.clear();
+}
+
+void mesher::IndexedMesh::patch(const cfg::Block * chunk, const glm::tvec3<cfg::Coord> & from, const glm::tvec3<cfg::Coord> & to) {
+    using namespace padded;
+    auto sameVertex = [](const cfg::Vertex & a, const cfg::Vertex & b) {
+        return std::equal(std::begin(a.vals), std::end(a.vals), std::begin(b.vals)) && a.block == b.block;
+    };
+    const glm::tvec3<cfg::Coord> patch_from{ glm::max(from - 1, glm::tvec3<cfg::Coord>{ 0 }) };
+    const glm::tvec3<cfg::Coord> patch_to{ glm::min(to + 1, cfg::MESH_SIZE - 1) };
+    glm::tvec3<cfg::Coord> i;
+    for (i.z = patch_from.z; i.z <= patch_to.z; ++i.z)
+        for (i.y = patch_from.y; i.y <= patch_to.y; ++i.y)
+            for (i.x = patch_from.x; i.x <= patch_to.x; ++i.x) {
+                const int32_t block_index = Math::to_index(i + OFFSET, DIM);
+                const cfg::Block block{ chunk[block_index] };
+                for (size_t side = 0; side < 6; ++side) {
+                    const uint32_t face{ static_cast<uint32_t>(Math::to_index(i, cfg::MESH_SIZE) * 6 + side) };
+                    const uint32_t quad{ m_quads[face] };
+                    if (block == cfg::Block{ 0 } || chunk[block_index + NEIGHBOUR_OFFSETS[side]] != cfg::Block{ 0 }) {
+                        if (quad != NO_QUAD)
+                            removeQuad(quad);
+                        continue;
+                    }
+                    // as meshPadded() makes it
+                    std::array<bool, 8> aos;
+                    for (size_t k = 0; k < 8; ++k)
+                        aos[k] = chunk[block_index + AOS_OFFSETS[side][k]] != cfg::Block{ 0 };
+                    std::array<uint8_t, 4> ao;
+                    for (size_t k = 0; k < 4; ++k)
+                        ao[k] = SHADOW_STRENGTH * Math::vertexAOInv(aos[AO_OFFSETS[side][k][0]], aos[AO_OFFSETS[side][k][1]], aos[AO_OFFSETS[side][k][2]]);
+                    std::array<cfg::Vertex, 4> vertices;
+                    for (size_t k = 0; k < 4; ++k) {
+                        const glm::tvec3<uint8_t> vertex{ glm::tvec3<uint8_t>{ i } + QUAD_VERTEX_OFFSETS[side][k] };
+                        vertices[k] = { vertex.x, vertex.y, vertex.z, block, ao[0], ao[1], ao[2], ao[3] };
+                    }
+                    if (quad == NO_QUAD) {
+                        m_quads[face] = static_cast<uint32_t>(m_faces.size());
+                        m_changed.push_back(m_quads[face]);
+                        m_faces.push_back(face);
+                        m_vertices.insert(std::end(m_vertices), std::begin(vertices), std::end(vertices));
+                    } else if (!std::equal(std::begin(vertices), std::end(vertices), std::begin(m_vertices) + quad * 4, sameVertex)) {
+                        std::copy(std::begin(vertices), std::end(vertices), std::begin(m_vertices) + quad * 4);
+                        m_changed.push_back(quad);
+                    }
+                }
+            }
+}
+
+void mesher::IndexedMesh::removeQuad(uint32_t quad) {
+    const uint32_t last{ static_cast<uint32_t>(m_faces.size() - 1) };
+    m_quads[m_faces[quad]] = NO_QUAD;
+    if (quad != last) {
+        std::copy_n(std::begin(m_vertices) + last * 4, 4, std::begin(m_vertices) + quad * 4);
+        m_faces[quad] = m_faces[last];
+        m_quads[m_faces[quad]] = quad;
+        m_changed.push_back(quad);
+    }
+    m_faces.pop_back();
+    m_vertices.resize(m_vertices.size() - 4);
+}
+
+void mesher::IndexedMesh::takeChangedQuads(std::vector<uint32_t> & quads) {
+    std::sort(std::begin(m_changed), std::end(m_changed));
+    m_changed.erase(std::unique(std::begin(m_changed), std::end(m_changed)), std::end(m_changed));
+    // quads removed after changing
+    m_changed.erase(std::lower_bound(std::begin(m_changed), std::end(m_changed), m_faces.size()), std::end(m_changed));
+    quads.swap(m_changed);
+    m_changed.clear();
+}
+
 template <>
 void mesher::mesh<mesher::MesherType::ADVANCED_AO>(
     std::vector<cfg::Vertex> & mesh,
@@ -24,8 +24,10 @@ namespace mesher {
         INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA,
         INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_BETTER_COPY,
         ADVANCED_AO,
+        GREEDY, // coplanar faces of the same block and ambient occlusion merged into bigger quads
+        BITMASK, // rows of blocks as bit masks, visibility and ambient occlusion of a whole row at once
         ITERATE_1D_ARRAY, // TODO: implement
-        INDEX_QUADS, // TODO: implement (each block stores index to quad in mesh, this is adjusted when mesh modified (remove->allbigger--, add->allbigger++))
+        INDEX_QUADS, // see IndexedMesh
         SPARSE_MAP // WILL USE A LOT OF EXTRA MEMORY but it is O(1) for all needed operations
     };
 
@@ -35,6 +37,59 @@ namespace mesher {
         const std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> & chunks
     );
     
+    // blocks of a mesh with one block of the neighbouring meshes around it, x fastest (see PackedChunk::copyBox())
+    static constexpr glm::tvec3<cfg::Coord> PADDED_SIZE{ Math::add(cfg::MESH_SIZE, 2) };
+    // same as mesh<MesherType::INDEX_LOOKUP_TABLE_UNROLL_SEMI_NO_LAMBDA_BETTER_COPY>() without the copy
+    void meshPadded(std::vector<cfg::Vertex> & mesh, const cfg::Block * padded);
+    // blocks of the mesh and one around it out of the chunks around it into padded (Math::volume(PADDED_SIZE)
+    // blocks), what mesh<>() copies before meshing
+    void copyPadded(cfg::Block * padded, const std::array<cfg::Block *, cfg::MESH_CHUNK_VOLUME> & chunks);
+    // same as mesh<MesherType::BITMASK>() without the copy, the quads of meshPadded() (in another order)
+    void meshPaddedBitmask(std::vector<cfg::Vertex> & mesh, const cfg::Block * padded);
+
+    // MesherType::INDEX_QUADS: the quads of meshPaddedBitmask() and for every face of every block where its quad is,
+    // so a few changed blocks patch the quads around them instead of the whole mesh being made again
+    // quads move when others are removed (the last quad takes the place of a removed one)
+    class IndexedMesh {
+    public:
+        IndexedMesh();
+        void build(const cfg::Block * padded);
+        // blocks from from to to (mesh coordinates, inclusive) changed in padded: the faces of them and of the blocks
+        // around them (whose visibility or ambient occlusion depends on them) are made again
+        void patch(const cfg::Block * padded, const glm::tvec3<cfg::Coord> & from, const glm::tvec3<cfg::Coord> & to);
+        const std::vector<cfg::Vertex> & vertices() const { return m_vertices; }
+        // quads changed by patch() since the last call (sorted, all of them still in the mesh)
+        void takeChangedQuads(std::vector<uint32_t> & quads);
+
+    private:
+        static constexpr uint32_t NO_QUAD{ ~uint32_t{ 0 } };
+        std::vector<cfg::Vertex> m_vertices;
+        // per face (block index in the mesh * 6 + side) its quad, NO_QUAD if the face isn't visible
+        std::vector<uint32_t> m_quads;
+        // per quad its face
+        std::vector<uint32_t> m_faces;
+        std::vector<uint32_t> m_changed;
+
+        void removeQuad(uint32_t quad);
+    };
+
+    // instruction sets solidRows() has a version for, SCALAR everywhere, the others on x86-64 cpus having them
+    enum class Kernel { SCALAR, SSE2, AVX2 };
+    bool kernelSupported(Kernel kernel);
+    // widest kernel the cpu runs, checked once
+    Kernel bestKernel();
+    // bit x of rows[y + z * PADDED_SIZE.y] set where the padded block (x, y, z) isn't air, the same bits for every
+    // kernel (meshPaddedBitmask() uses bestKernel())
+    void solidRows(const cfg::Block * padded, uint64_t * rows, Kernel kernel);
+    // same as mesh<MesherType::GREEDY>() without the copy
+    // a quad covers a rectangle of faces whose blocks and corner ambient occlusion are all equal, so shading and
+    // textures repeat per block over it: its side + 1 is in the bits of the position from GREEDY_SIDE_SHIFT on
+    // (x: bits 0 and 1 of it, y: bit 2), block.vert takes texture coordinates along GREEDY_SIDE_AXES from the position
+    void meshPaddedGreedy(std::vector<cfg::Vertex> & mesh, const cfg::Block * padded);
+    static constexpr unsigned GREEDY_SIDE_SHIFT{ 6 };
+    // per side the axes from the first quad corner to the second and to the fourth (texture s and t)
+    static constexpr std::array<std::array<size_t, 2>, 6> GREEDY_SIDE_AXES{ { { { 2, 1 } }, { { 1, 2 } }, { { 0, 2 } }, { { 2, 0 } }, { { 1, 0 } }, { { 0, 1 } } } };
+
     // benchmark
     void generic(
         std::vector<cfg::Vertex> & out_mesh,
@@ -14,7 +14,7 @@ void worldgen::generate<worldgen::WorldGenType::STANDARD>(
             for (i.x = fr.x; i.x < to.x; ++i.x) {
                 const auto index = Math::position_to_index(i, cfg::CHUNK_SIZE);
                 if (i.y < 0)
-                    chunk[index] = std::rand() % 100 == 0 ? std::rand() : 0;
+                    chunk[index] = std::rand() % 100 == 0 ? static_cast<uint8_t>(std::rand()) : 0;
                 else
                     chunk[index] = 0;
 
@@ -71,6 +71,7 @@ void worldgen::generate<worldgen::WorldGenType::SINE>(
             for (i.x = fr.x; i.x < to.x; ++i.x) {
                 const auto index = Math::position_to_index(i, cfg::CHUNK_SIZE);
                 const auto set = std::sin(i.x * 0.1) * std::sin(i.z * 0.1) * 10.0 > static_cast<double>(i.y);
-                chunk[index] = set ? ((std::rand() % (std::numeric_limits<cfg::Block>::max() - 5)) + 1) : 0;
+                // same blocks as with 8 bit ids
+                chunk[index] = set ? ((std::rand() % (std::numeric_limits<uint8_t>::max() - 5)) + 1) : 0;
             }
 }
\ No newline at end of file